@@ -156,6 +156,22 @@ static void runFile(DictuVM *vm, char *filename) {
     if (result == INTERPRET_RUNTIME_ERROR) exit(70);
 }
 
+// Writes the C translation of the script at filename to output.
+static void compileFile(DictuVM *vm, char *filename, char *output) {
+    char *source = readFile(filename);
+
+    if (source == NULL) {
+        fprintf(stderr, "Could not open file \"%s\".\n", filename);
+        exit(74);
+    }
+
+    DictuInterpretResult result = dictuCompileToC(vm, filename, source, output);
+    free(source);
+
+    if (result == INTERPRET_COMPILE_ERROR) exit(65);
+    if (result == INTERPRET_RUNTIME_ERROR) exit(74);
+}
+
 static const char *const usage[] = {
         "dictu [options] [[--] args]",
         "dictu [options]",
@@ -163,8 +179,38 @@ static const char *const usage[] = {
 };
 
 int main(int argc, char *argv[]) {
+    char *cmd = NULL;
+    char *aotOutput = NULL;
+    char *gcValues[5] = {NULL};
+    const char *gcNames[5] = {"min-heap", "max-heap", "target", "threads", "compact"};
+
+    struct argparse_option options[] = {
+        OPT_HELP(),
+        OPT_STRING(0, "aot", &aotOutput, "Write the script as C source to the given file instead of running it", NULL, 0, 0),
+        OPT_GROUP("Garbage collector"),
+        OPT_STRING(0, "gc-min-heap", &gcValues[0], "Heap size before the first collection, e.g. 16M", NULL, 0, 0),
+        OPT_STRING(0, "gc-max-heap", &gcValues[1], "Heap size at which allocation fails, 0 for no limit", NULL, 0, 0),
+        OPT_STRING(0, "gc-target", &gcValues[2], "Share of running time to spend collecting, 0 to grow the heap by a fixed factor", NULL, 0, 0),
+        OPT_STRING(0, "gc-threads", &gcValues[3], "Threads marking large heaps, 0 for one per processor", NULL, 0, 0),
+        OPT_STRING(0, "gc-compact", &gcValues[4], "1 to compact sparse heaps, 0 not to", NULL, 0, 0),
+        OPT_END(),
+    };
+
+    struct argparse argparse;
+    argparse_init(&argparse, options, usage, ARGPARSE_STOP_AT_NON_OPTION);
+    argc = argparse_parse(&argparse, argc, (const char **)argv);
+
+    DictuGCOptions gcOptions;
+    dictuDefaultGCOptions(&gcOptions);
+
+    for (int i = 0; i < 5; i++) {
+        if (gcValues[i] != NULL && !dictuSetGCOption(&gcOptions, gcNames[i], gcValues[i])) {
+            fprintf(stderr, "Invalid value for --gc-%s: %s\n", gcNames[i], gcValues[i]);
+            exit(64);
+        }
+    }
 
-    DictuVM *vm = dictuInitVM(argc == 0, argc, argv);
+    DictuVM *vm = dictuInitVMWithOptions(argc == 0, argc, argv, &gcOptions);
 
     if (cmd != NULL) {
         DictuInterpretResult result = dictuInterpret(vm, "repl", cmd);
@@ -174,13 +220,24 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
-    if (argc == 1) {
+    if (aotOutput != NULL) {
+        if (argc == 0) {
+            fprintf(stderr, "--aot needs a script to compile.\n");
+            exit(64);
+        }
+
+        compileFile(vm, argv[0], aotOutput);
+        dictuFreeVM(vm);
+        return 0;
+    }
+
+    if (argc == 0) {
         repl(vm);
         dictuFreeVM(vm);
         return 0;
     }
 
-    runFile(vm, argv[1]);
+    runFile(vm, argv[0]);
     dictuFreeVM(vm);
     return 0;
 }
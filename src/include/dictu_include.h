@@ -2,6 +2,7 @@
 #define oolong_include_h
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct _vm DictuVM;
 
@@ -11,10 +12,108 @@ typedef enum {
     INTERPRET_RUNTIME_ERROR
 } DictuInterpretResult;
 
+/*
+ * Garbage collector tuning. Start from dictuDefaultGCOptions, which
+ * applies the OOLONG_GC_* environment variables, and pass the result to
+ * dictuInitVMWithOptions:
+ *
+ *   OOLONG_GC_MIN_HEAP  min-heap  Heap size collections start from, 4M.
+ *   OOLONG_GC_MAX_HEAP  max-heap  Heap size allocation may not pass, even
+ *                                 after a full collection. The script
+ *                                 fails with a runtime error and the VM
+ *                                 stays usable. 0, the default, for no
+ *                                 limit.
+ *   OOLONG_GC_TARGET    target    Share of the running time collections
+ *                                 should take, 0.05. The heap grows
+ *                                 further between collections when they
+ *                                 take more, less when they take less.
+ *                                 0 grows it by a fixed factor of two.
+ *   OOLONG_GC_THREADS   threads   Threads marking a large heap, 0, the
+ *                                 default, for one per processor.
+ *   OOLONG_GC_COMPACT   compact   1 to compact sparse pages, 0 not to.
+ *
+ * Sizes are in bytes with an optional K, M or G suffix.
+ */
+typedef struct {
+    size_t minHeap;
+    size_t maxHeap;
+    double target;
+    int markThreads;
+    bool compact;
+} DictuGCOptions;
+
+void dictuDefaultGCOptions(DictuGCOptions *options);
+
+// Sets the option of the given name from its text, returns false if
+// either is invalid.
+bool dictuSetGCOption(DictuGCOptions *options, const char *name, const char *value);
+
 DictuVM *dictuInitVM(bool repl, int argc, char *argv[]);
 
+DictuVM *dictuInitVMWithOptions(bool repl, int argc, char *argv[], const DictuGCOptions *options);
+
 void dictuFreeVM(DictuVM *vm);
 
 DictuInterpretResult dictuInterpret(DictuVM *vm, char *moduleName, char *source);
 
+// Compiles source to C for a standalone executable and writes it to the
+// file at output, see aot.h.
+DictuInterpretResult dictuCompileToC(DictuVM *vm, char *moduleName, char *source, const char *output);
+
+/*
+ * Embedding API
+ *
+ * A handle keeps a script value alive across garbage collections until
+ * it is released. A call is made by pushing the function handle, then
+ * its arguments, then calling dictuCall with the argument count:
+ *
+ *   DictuHandle *handler = dictuGetVariable(vm, "app", "handle");
+ *
+ *   dictuPushHandle(vm, handler);
+ *   dictuPushNumber(vm, 42);
+ *   if (dictuCall(vm, 1) == INTERPRET_OK) {
+ *       double answer = dictuResultNumber(vm);
+ *   }
+ *
+ * The result of the last successful call stays readable until the next
+ * call is made. A push returns false, leaving the stack as it was, once
+ * the VM stack is full.
+ */
+
+typedef struct sDictuHandle DictuHandle;
+
+typedef enum {
+    DICTU_TYPE_NIL,
+    DICTU_TYPE_BOOL,
+    DICTU_TYPE_NUMBER,
+    DICTU_TYPE_STRING,
+    DICTU_TYPE_OBJECT
+} DictuType;
+
+DictuHandle *dictuGetVariable(DictuVM *vm, const char *moduleName, const char *name);
+
+void dictuReleaseHandle(DictuVM *vm, DictuHandle *handle);
+
+bool dictuPushHandle(DictuVM *vm, DictuHandle *handle);
+
+bool dictuPushNil(DictuVM *vm);
+
+bool dictuPushBool(DictuVM *vm, bool value);
+
+bool dictuPushNumber(DictuVM *vm, double value);
+
+bool dictuPushString(DictuVM *vm, const char *chars, int length);
+
+DictuInterpretResult dictuCall(DictuVM *vm, int argCount);
+
+DictuType dictuResultType(DictuVM *vm);
+
+bool dictuResultBool(DictuVM *vm);
+
+double dictuResultNumber(DictuVM *vm);
+
+const char *dictuResultString(DictuVM *vm, int *length);
+
+DictuHandle *dictuResultHandle(DictuVM *vm);
+
 #endif
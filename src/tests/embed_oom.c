@@ -0,0 +1,72 @@
+/*
+ * Embedding regression test: a script that runs out of memory must leave
+ * the VM usable for the next call from the host.
+ *
+ * Build the VM objects from src/vm in their own directory, then link
+ * them with this file compiled against src/include:
+ *
+ *   cc -I src/include src/tests/embed_oom.c $VM_OBJECTS -lm -lpthread
+ *
+ * Exits with a non-zero status on failure.
+ */
+
+#include <stdio.h>
+
+#include "dictu_include.h"
+
+static const char *source =
+    "var list = [];\n"
+    "def fill() {\n"
+    "    while (true) { list.push(list.len()); }\n"
+    "}\n"
+    "def grow() {\n"
+    "    for (var i = 0; i < 64; i += 1) { list.push(i); }\n"
+    "    return list.len();\n"
+    "}\n";
+
+static int failures = 0;
+
+static void check(bool condition, const char *message) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", message);
+        failures++;
+    }
+}
+
+int main(void) {
+    DictuGCOptions options;
+    dictuDefaultGCOptions(&options);
+    check(dictuSetGCOption(&options, "max-heap", "16M"), "max-heap accepted");
+
+    DictuVM *vm = dictuInitVMWithOptions(false, 0, NULL, &options);
+    check(dictuInterpret(vm, "app", (char *) source) == INTERPRET_OK, "script loads");
+
+    DictuHandle *fill = dictuGetVariable(vm, "app", "fill");
+    DictuHandle *grow = dictuGetVariable(vm, "app", "grow");
+    check(fill != NULL && grow != NULL, "functions found");
+
+    if (fill != NULL && grow != NULL) {
+        check(dictuPushHandle(vm, fill), "push fill");
+        check(dictuCall(vm, 0) == INTERPRET_RUNTIME_ERROR, "fill runs out of memory");
+
+        // The list was left at whatever size the failed allocation grew it
+        // from, pushing to it again must not write past its buffer.
+        for (int i = 0; i < 4; i++) {
+            check(dictuPushHandle(vm, grow), "push grow");
+
+            DictuInterpretResult result = dictuCall(vm, 0);
+            check(result == INTERPRET_OK || result == INTERPRET_RUNTIME_ERROR, "grow returns");
+        }
+
+        dictuReleaseHandle(vm, fill);
+        dictuReleaseHandle(vm, grow);
+    }
+
+    dictuFreeVM(vm);
+
+    if (failures == 0) {
+        printf("embed_oom: ok\n");
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "abstracts.h"
+#include "memory.h"
+#include "util.h"
+#include "vm.h"
+
+static char *typedAbstractToString(ObjAbstract *abstract) {
+    const char *name = abstract->abstractType->descriptor->name;
+    int length = strlen(name) + 3;
+
+    char *string = malloc(sizeof(char) * length);
+    snprintf(string, length, "<%s>", name);
+    return string;
+}
+
+AbstractType *defineAbstractType(DictuVM *vm, const AbstractTypeDescriptor *descriptor) {
+    AbstractType *type = ALLOCATE(vm, AbstractType, 1);
+    type->descriptor = descriptor;
+    type->fieldNames = NULL;
+    initTable(&type->methods);
+
+    // Linked in before allocating the names so the collector sees them.
+    type->next = vm->abstractTypes;
+    vm->abstractTypes = type;
+
+    type->fieldNames = ALLOCATE(vm, ObjString *, descriptor->fieldCount);
+    for (int i = 0; i < descriptor->fieldCount; ++i) {
+        type->fieldNames[i] = NULL;
+    }
+
+    for (int i = 0; i < descriptor->fieldCount; ++i) {
+        const char *name = descriptor->fields[i].name;
+        type->fieldNames[i] = copyString(vm, name, strlen(name));
+    }
+
+    for (int i = 0; i < descriptor->methodCount; ++i) {
+        const AbstractMethod *method = &descriptor->methods[i];
+
+        if (method->signature != NULL) {
+            defineTypedNative(vm, &type->methods, method->name, method->function, method->signature);
+        } else {
+            defineNative(vm, &type->methods, method->name, method->function);
+        }
+    }
+
+    return type;
+}
+
+ObjAbstract *newTypedAbstract(DictuVM *vm, AbstractType *type, void *data, AbstractFreeFn freeFn) {
+    ObjAbstract *abstract = newAbstract(vm, freeFn, typedAbstractToString);
+    abstract->data = data;
+    abstract->abstractType = type;
+
+    return abstract;
+}
+
+// A cache byte holds one more than the index of the field its property
+// access last matched, whatever the type. Checking the name at that
+// index is enough to reuse it.
+static const AbstractField *findField(AbstractType *type, ObjString *name, uint8_t *cache) {
+    int fieldCount = type->descriptor->fieldCount;
+
+    if (cache != NULL && *cache != 0 && *cache <= fieldCount &&
+        type->fieldNames[*cache - 1] == name) {
+        return &type->descriptor->fields[*cache - 1];
+    }
+
+    for (int i = 0; i < fieldCount; ++i) {
+        if (type->fieldNames[i] == name) {
+            if (cache != NULL && i < UINT8_MAX) {
+                *cache = i + 1;
+            }
+
+            return &type->descriptor->fields[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool getAbstractField(DictuVM *vm, ObjAbstract *abstract, ObjString *name, uint8_t *cache, Value *value) {
+    if (abstract->abstractType == NULL) {
+        return false;
+    }
+
+    const AbstractField *field = findField(abstract->abstractType, name, cache);
+    if (field == NULL) {
+        return false;
+    }
+
+    char *address = (char *) abstract->data + field->offset;
+
+    switch (field->type) {
+        case ABSTRACT_FIELD_BOOL:
+            *value = BOOL_VAL(*(bool *) address);
+            break;
+
+        case ABSTRACT_FIELD_INT:
+            *value = INT_VAL(*(int *) address);
+            break;
+
+        case ABSTRACT_FIELD_INT64:
+            *value = integerToValue(*(int64_t *) address);
+            break;
+
+        case ABSTRACT_FIELD_FLOAT:
+            *value = NUMBER_VAL(*(float *) address);
+            break;
+
+        case ABSTRACT_FIELD_DOUBLE:
+            *value = NUMBER_VAL(*(double *) address);
+            break;
+
+        case ABSTRACT_FIELD_STRING: {
+            char *string = *(char **) address;
+
+            if (string == NULL) {
+                *value = NIL_VAL;
+            } else {
+                *value = OBJ_VAL(copyString(vm, string, strlen(string)));
+            }
+            break;
+        }
+    }
+
+    return true;
+}
+
+AbstractSetResult setAbstractField(ObjAbstract *abstract, ObjString *name, uint8_t *cache, Value value) {
+    if (abstract->abstractType == NULL) {
+        return ABSTRACT_SET_NO_FIELD;
+    }
+
+    const AbstractField *field = findField(abstract->abstractType, name, cache);
+    if (field == NULL) {
+        return ABSTRACT_SET_NO_FIELD;
+    }
+
+    if (field->readOnly || field->type == ABSTRACT_FIELD_STRING) {
+        return ABSTRACT_SET_READ_ONLY;
+    }
+
+    char *address = (char *) abstract->data + field->offset;
+
+    if (field->type == ABSTRACT_FIELD_BOOL) {
+        if (!IS_BOOL(value)) {
+            return ABSTRACT_SET_WRONG_TYPE;
+        }
+
+        *(bool *) address = AS_BOOL(value);
+        return ABSTRACT_SET_OK;
+    }
+
+    if (!IS_NUMBER(value)) {
+        return ABSTRACT_SET_WRONG_TYPE;
+    }
+
+    double number = AS_NUMBER(value);
+
+    // Converting a double the field can't represent is undefined, NaN
+    // fails every comparison so it is rejected too.
+    switch (field->type) {
+        case ABSTRACT_FIELD_INT:
+            if (!(number >= INT_MIN && number <= INT_MAX)) {
+                return ABSTRACT_SET_OUT_OF_RANGE;
+            }
+
+            *(int *) address = (int) number;
+            break;
+
+        case ABSTRACT_FIELD_INT64:
+            if (IS_INT(value)) {
+                *(int64_t *) address = AS_INT(value);
+                break;
+            }
+
+            // 2^63 is exact as a double, INT64_MAX is not.
+            if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0)) {
+                return ABSTRACT_SET_OUT_OF_RANGE;
+            }
+
+            *(int64_t *) address = (int64_t) number;
+            break;
+
+        case ABSTRACT_FIELD_FLOAT:
+            if (isfinite(number) && fabs(number) > FLT_MAX) {
+                return ABSTRACT_SET_OUT_OF_RANGE;
+            }
+
+            *(float *) address = (float) number;
+            break;
+
+        default:
+            *(double *) address = number;
+            break;
+    }
+
+    return ABSTRACT_SET_OK;
+}
+
+bool getAbstractMethod(ObjAbstract *abstract, ObjString *name, Value *method) {
+    if (abstract->abstractType == NULL) {
+        return false;
+    }
+
+    return tableGet(&abstract->abstractType->methods, name, method);
+}
+
+void grayAbstractTypes(DictuVM *vm) {
+    for (AbstractType *type = vm->abstractTypes; type != NULL; type = type->next) {
+        grayTable(vm, &type->methods);
+
+        if (type->fieldNames == NULL) {
+            continue;
+        }
+
+        for (int i = 0; i < type->descriptor->fieldCount; ++i) {
+            grayObject(vm, (Obj *) type->fieldNames[i]);
+        }
+    }
+}
+
+void freeAbstractTypes(DictuVM *vm) {
+    AbstractType *type = vm->abstractTypes;
+
+    while (type != NULL) {
+        AbstractType *next = type->next;
+        freeTable(vm, &type->methods);
+        FREE_ARRAY(vm, ObjString *, type->fieldNames, type->descriptor->fieldCount);
+        FREE(vm, AbstractType, type);
+        type = next;
+    }
+
+    vm->abstractTypes = NULL;
+}
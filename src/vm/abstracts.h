@@ -0,0 +1,91 @@
+#ifndef oolong_abstracts_h
+#define oolong_abstracts_h
+
+#include <stddef.h>
+
+#include "object.h"
+
+/*
+ * Host types expose C structs to scripts without copying. A descriptor
+ * lists the struct fields by offset and the methods as natives, e.g.
+ *
+ *   static const AbstractField pointFields[] = {
+ *       {"x", ABSTRACT_FIELD_DOUBLE, offsetof(Point, x), false},
+ *       {"y", ABSTRACT_FIELD_DOUBLE, offsetof(Point, y), false},
+ *   };
+ *
+ * Property reads and writes on an abstract of that type go straight to
+ * the memory behind abstract->data.
+ */
+
+typedef enum {
+    ABSTRACT_FIELD_BOOL,
+    ABSTRACT_FIELD_INT,
+    ABSTRACT_FIELD_INT64,
+    ABSTRACT_FIELD_FLOAT,
+    ABSTRACT_FIELD_DOUBLE,
+    // A NUL terminated char *, always read only.
+    ABSTRACT_FIELD_STRING
+} AbstractFieldType;
+
+typedef struct {
+    const char *name;
+    AbstractFieldType type;
+    size_t offset;
+    bool readOnly;
+} AbstractField;
+
+// A method with a signature is registered with defineTypedNative, see
+// util.h, one without checks its own arguments.
+typedef struct {
+    const char *name;
+    NativeFn function;
+    const char *signature;
+} AbstractMethod;
+
+typedef struct {
+    const char *name;
+    const AbstractField *fields;
+    int fieldCount;
+    const AbstractMethod *methods;
+    int methodCount;
+} AbstractTypeDescriptor;
+
+struct sAbstractType {
+    const AbstractTypeDescriptor *descriptor;
+
+    // Interned field names, compared by pointer against property names.
+    ObjString **fieldNames;
+    Table methods;
+    AbstractType *next;
+};
+
+typedef enum {
+    ABSTRACT_SET_OK,
+    ABSTRACT_SET_NO_FIELD,
+    ABSTRACT_SET_READ_ONLY,
+    ABSTRACT_SET_WRONG_TYPE,
+    ABSTRACT_SET_OUT_OF_RANGE
+} AbstractSetResult;
+
+// Registers a host type, descriptor must outlive the VM.
+AbstractType *defineAbstractType(DictuVM *vm, const AbstractTypeDescriptor *descriptor);
+
+// Wraps host data in an abstract of a registered type. freeFn releases
+// data once the abstract is collected.
+ObjAbstract *newTypedAbstract(DictuVM *vm, AbstractType *type, void *data, AbstractFreeFn freeFn);
+
+// cache is the property access's byte in its chunk's fieldCache, or
+// NULL. A string field is looked up in the interned strings on each
+// read and only allocates when its contents changed.
+bool getAbstractField(DictuVM *vm, ObjAbstract *abstract, ObjString *name, uint8_t *cache, Value *value);
+
+AbstractSetResult setAbstractField(ObjAbstract *abstract, ObjString *name, uint8_t *cache, Value value);
+
+bool getAbstractMethod(ObjAbstract *abstract, ObjString *name, Value *method);
+
+void grayAbstractTypes(DictuVM *vm);
+
+void freeAbstractTypes(DictuVM *vm);
+
+#endif //dictu_abstracts_h
@@ -0,0 +1,864 @@
+#include <stdlib.h>
+
+#include "aot.h"
+#include "compiler.h"
+#include "util.h"
+
+typedef struct {
+    DictuVM *vm;
+    FILE *out;
+    ObjFunction **functions;
+    int count;
+    int capacity;
+} AotWriter;
+
+static bool sameCode(ObjFunction *function, const uint8_t *code, int count) {
+    return function->chunk.count == count &&
+           memcmp(function->chunk.code, code, count) == 0;
+}
+
+// Generated code depends on nothing but the bytecode, so functions that
+// compiled to the same bytes share one translation.
+static void collectFunctions(AotWriter *writer, ObjFunction *function) {
+    for (int i = 0; i < writer->count; ++i) {
+        if (sameCode(writer->functions[i], function->chunk.code, function->chunk.count)) {
+            goto nested;
+        }
+    }
+
+    if (writer->capacity < writer->count + 1) {
+        int oldCapacity = writer->capacity;
+        int capacity = GROW_CAPACITY(oldCapacity);
+        writer->functions = GROW_ARRAY(writer->vm, writer->functions, ObjFunction *,
+                                       oldCapacity, capacity);
+        writer->capacity = capacity;
+    }
+
+    writer->functions[writer->count++] = function;
+
+nested:
+    for (int i = 0; i < function->chunk.constants.count; ++i) {
+        Value constant = function->chunk.constants.values[i];
+
+        if (IS_FUNCTION(constant)) {
+            collectFunctions(writer, AS_FUNCTION(constant));
+        }
+    }
+}
+
+static int readShort(uint8_t *code, int offset) {
+    return (code[offset] << 8) | code[offset + 1];
+}
+
+// Marks the instructions jumped to, each of them gets a label.
+static void markTargets(Chunk *chunk, bool *targets) {
+    uint8_t *code = chunk->code;
+
+    for (int offset = 0; offset < chunk->count;) {
+        int next = offset + 1 + getArgCount(code, chunk->constants, offset);
+
+        switch (code[offset]) {
+            case OP_JUMP:
+            case OP_JUMP_IF_FALSE:
+            case OP_JUMP_IF_NIL:
+                targets[next + readShort(code, offset + 1)] = true;
+                break;
+
+            case OP_LOOP:
+                targets[next - readShort(code, offset + 1)] = true;
+                break;
+
+            case OP_FOR_PREP:
+                targets[next + readShort(code, offset + 5)] = true;
+                break;
+
+            case OP_FOR_LOOP:
+                targets[next - readShort(code, offset + 5)] = true;
+                break;
+
+            case OP_ITER_NEXT:
+                targets[next + readShort(code, offset + 2)] = true;
+                break;
+
+            case OP_TAIL_CALL:
+                // A call to the function itself restarts it.
+                if (!code[offset + 2]) {
+                    targets[0] = true;
+                }
+                break;
+        }
+
+        offset = next;
+    }
+}
+
+// Binary operators on the two values on top of the stack, a and b. Two
+// ints take intResult, two numbers passing guard take numberResult and
+// anything else is left to the interpreter.
+static void writeBinary(FILE *out, int offset, const char *intResult,
+                        const char *guard, const char *numberResult, bool strings) {
+    fprintf(out, "    {\n"
+                 "        Value b = AOT_PEEK(0), a = AOT_PEEK(1);\n"
+                 "        if (");
+
+    if (intResult != NULL) {
+        fprintf(out, "IS_INT(a) && IS_INT(b)) {\n"
+                     "            sp--;\n"
+                     "            AOT_TOP = %s;\n"
+                     "        } else if (", intResult);
+    }
+
+    fprintf(out, "IS_NUMBER(a) && IS_NUMBER(b)%s%s) {\n"
+                 "            sp--;\n"
+                 "            AOT_TOP = %s;\n",
+            guard != NULL ? " && " : "", guard != NULL ? guard : "", numberResult);
+
+    if (strings) {
+        fprintf(out, "        } else if (IS_STRING(a) && IS_STRING(b)) {\n"
+                     "            vm->stackTop = sp;\n"
+                     "            aotConcatenate(vm);\n"
+                     "            AOT_RELOAD();\n");
+    }
+
+    fprintf(out, "        } else {\n"
+                 "            AOT_RESUME(%d);\n"
+                 "        }\n"
+                 "    }\n", offset);
+}
+
+// The loop condition of OP_FOR_PREP and OP_FOR_LOOP for a known mode.
+static void writeForCondition(FILE *out, ForLoopMode mode, const char *counter,
+                              const char *limit, const char *step) {
+    switch (mode) {
+        case FOR_RANGE:
+            fprintf(out, "(%s > 0 ? %s < %s : %s > %s)", step, counter, limit, counter, limit);
+            break;
+
+        case FOR_LESS:
+            fprintf(out, "%s < %s", counter, limit);
+            break;
+
+        case FOR_LESS_EQUAL:
+            fprintf(out, "%s <= %s", counter, limit);
+            break;
+
+        case FOR_GREATER:
+            fprintf(out, "%s > %s", counter, limit);
+            break;
+
+        case FOR_GREATER_EQUAL:
+            fprintf(out, "%s >= %s", counter, limit);
+            break;
+    }
+}
+
+static void writeCall(FILE *out, int next, const char *call) {
+    fprintf(out, "    AOT_SYNC(%d);\n"
+                 "    if (!%s) return false;\n"
+                 "    AOT_RELOAD();\n", next, call);
+}
+
+static void writeInstruction(FILE *out, ObjFunction *function, int offset, int next) {
+    uint8_t *code = function->chunk.code;
+    char call[128];
+
+    switch (code[offset]) {
+        case OP_CONSTANT:
+            fprintf(out, "    AOT_PUSH(constants[%d]);\n", code[offset + 1]);
+            break;
+
+        case OP_NIL:
+            fprintf(out, "    AOT_PUSH(NIL_VAL);\n");
+            break;
+
+        case OP_EMPTY:
+            fprintf(out, "    AOT_PUSH(EMPTY_VAL);\n");
+            break;
+
+        case OP_TRUE:
+            fprintf(out, "    AOT_PUSH(TRUE_VAL);\n");
+            break;
+
+        case OP_FALSE:
+            fprintf(out, "    AOT_PUSH(FALSE_VAL);\n");
+            break;
+
+        case OP_POP:
+            fprintf(out, "    sp--;\n");
+            break;
+
+        case OP_GET_LOCAL:
+            fprintf(out, "    AOT_PUSH(slots[%d]);\n", code[offset + 1]);
+            break;
+
+        case OP_SET_LOCAL:
+            fprintf(out, "    slots[%d] = AOT_TOP;\n", code[offset + 1]);
+            break;
+
+        case OP_GET_UPVALUE:
+            fprintf(out, "    AOT_PUSH(*closure->upvalues[%d]->value);\n", code[offset + 1]);
+            break;
+
+        case OP_SET_UPVALUE:
+            fprintf(out, "    *closure->upvalues[%d]->value = AOT_TOP;\n", code[offset + 1]);
+            break;
+
+        case OP_GET_GLOBAL:
+        case OP_GET_MODULE:
+            fprintf(out, "    {\n"
+                         "        Value value;\n"
+                         "        if (!tableGet(%s, AOT_STRING(%d), &value)) AOT_RESUME(%d);\n"
+                         "        AOT_PUSH(value);\n"
+                         "    }\n",
+                    code[offset] == OP_GET_GLOBAL ? "&vm->globals" : "module", code[offset + 1], offset);
+            break;
+
+        case OP_SET_MODULE:
+            fprintf(out, "    {\n"
+                         "        Value value;\n"
+                         "        if (!tableGet(module, AOT_STRING(%d), &value)) AOT_RESUME(%d);\n"
+                         "        vm->stackTop = sp;\n"
+                         "        tableSet(vm, module, AOT_STRING(%d), AOT_TOP);\n"
+                         "    }\n", code[offset + 1], offset, code[offset + 1]);
+            break;
+
+        case OP_DEFINE_MODULE:
+            fprintf(out, "    vm->stackTop = sp;\n"
+                         "    tableSet(vm, module, AOT_STRING(%d), AOT_TOP);\n"
+                         "    sp--;\n", code[offset + 1]);
+            break;
+
+        case OP_DEFINE_OPTIONAL:
+            fprintf(out, "    AOT_DEFINE_OPTIONAL(%d, %d);\n", code[offset + 1], code[offset + 2]);
+            break;
+
+        case OP_GET_PROPERTY:
+            fprintf(out, "    {\n"
+                         "        Value value;\n"
+                         "        if (IS_INSTANCE(AOT_TOP) && tableGet(&AS_INSTANCE(AOT_TOP)->publicFields, AOT_STRING(%d), &value)) {\n"
+                         "            AOT_TOP = value;\n"
+                         "        } else if (IS_MODULE(AOT_TOP) && tableGet(&AS_MODULE(AOT_TOP)->values, AOT_STRING(%d), &value)) {\n"
+                         "            AOT_TOP = value;\n"
+                         "        } else {\n"
+                         "            AOT_RESUME(%d);\n"
+                         "        }\n"
+                         "    }\n", code[offset + 1], code[offset + 1], offset);
+            break;
+
+        case OP_GET_PROPERTY_NO_POP:
+            fprintf(out, "    {\n"
+                         "        Value value;\n"
+                         "        if (!IS_INSTANCE(AOT_TOP) || !tableGet(&AS_INSTANCE(AOT_TOP)->publicFields, AOT_STRING(%d), &value)) AOT_RESUME(%d);\n"
+                         "        AOT_PUSH(value);\n"
+                         "    }\n", code[offset + 1], offset);
+            break;
+
+        case OP_SET_PROPERTY:
+            fprintf(out, "    if (!IS_INSTANCE(AOT_PEEK(1))) AOT_RESUME(%d);\n"
+                         "    vm->stackTop = sp;\n"
+                         "    tableSet(vm, &AS_INSTANCE(AOT_PEEK(1))->publicFields, AOT_STRING(%d), AOT_TOP);\n"
+                         "    sp -= 2;\n"
+                         "    AOT_PUSH(NIL_VAL);\n", offset, code[offset + 1]);
+            break;
+
+        case OP_EQUAL:
+            fprintf(out, "    {\n"
+                         "        Value b = AOT_POP();\n"
+                         "        AOT_TOP = BOOL_VAL(valuesEqual(AOT_TOP, b));\n"
+                         "    }\n");
+            break;
+
+        case OP_ADD:
+        case OP_ADD_NN:
+            writeBinary(out, offset, "integerToValue(AS_INT(a) + AS_INT(b))",
+                        NULL, "NUMBER_VAL(AS_NUMBER(a) + AS_NUMBER(b))", code[offset] == OP_ADD);
+            break;
+
+        case OP_SUBTRACT:
+        case OP_SUBTRACT_NN:
+            writeBinary(out, offset, "integerToValue(AS_INT(a) - AS_INT(b))",
+                        NULL, "NUMBER_VAL(AS_NUMBER(a) - AS_NUMBER(b))", false);
+            break;
+
+        case OP_MULTIPLY:
+        case OP_MULTIPLY_NN:
+            writeBinary(out, offset, "multiplyIntegers(AS_INT(a), AS_INT(b))",
+                        NULL, "NUMBER_VAL(AS_NUMBER(a) * AS_NUMBER(b))", false);
+            break;
+
+        case OP_DIVIDE:
+        case OP_DIVIDE_NN:
+            writeBinary(out, offset, "divideIntegers(AS_INT(a), AS_INT(b))",
+                        NULL, "NUMBER_VAL(AS_NUMBER(a) / AS_NUMBER(b))", false);
+            break;
+
+        case OP_LESS:
+        case OP_LESS_NN:
+            writeBinary(out, offset, "BOOL_VAL(AS_INT(a) < AS_INT(b))",
+                        NULL, "BOOL_VAL(AS_NUMBER(a) < AS_NUMBER(b))", false);
+            break;
+
+        case OP_GREATER:
+        case OP_GREATER_NN:
+            writeBinary(out, offset, "BOOL_VAL(AS_INT(a) > AS_INT(b))",
+                        NULL, "BOOL_VAL(AS_NUMBER(a) > AS_NUMBER(b))", false);
+            break;
+
+        case OP_MOD:
+            writeBinary(out, offset, NULL, NULL, "modNumbers(a, b)", false);
+            break;
+
+        case OP_POW:
+            writeBinary(out, offset, NULL, NULL, "powNumbers(a, b)", false);
+            break;
+
+        case OP_BITWISE_AND:
+            writeBinary(out, offset, "integerToValue(AS_INT(a) & AS_INT(b))",
+                        NULL, "integerToValue(valueToInteger(a) & valueToInteger(b))", false);
+            break;
+
+        case OP_BITWISE_XOR:
+            writeBinary(out, offset, "integerToValue(AS_INT(a) ^ AS_INT(b))",
+                        NULL, "integerToValue(valueToInteger(a) ^ valueToInteger(b))", false);
+            break;
+
+        case OP_BITWISE_OR:
+            writeBinary(out, offset, "integerToValue(AS_INT(a) | AS_INT(b))",
+                        NULL, "integerToValue(valueToInteger(a) | valueToInteger(b))", false);
+            break;
+
+        case OP_SHIFT_LEFT:
+            writeBinary(out, offset, NULL, "valueToInteger(b) >= 0",
+                        "integerToValue(valueToInteger(b) > 63 ? 0 : "
+                        "(int64_t) ((uint64_t) valueToInteger(a) << valueToInteger(b)))", false);
+            break;
+
+        case OP_SHIFT_RIGHT:
+            writeBinary(out, offset, NULL, "valueToInteger(b) >= 0",
+                        "integerToValue(valueToInteger(a) >> "
+                        "(valueToInteger(b) > 63 ? 63 : valueToInteger(b)))", false);
+            break;
+
+        case OP_NOT:
+            fprintf(out, "    AOT_TOP = BOOL_VAL(AOT_FALSEY(AOT_TOP));\n");
+            break;
+
+        case OP_NEGATE:
+            fprintf(out, "    if (IS_INT(AOT_TOP)) {\n"
+                         "        AOT_TOP = integerToValue(-AS_INT(AOT_TOP));\n"
+                         "    } else if (IS_NUMBER(AOT_TOP)) {\n"
+                         "        AOT_TOP = NUMBER_VAL(-AS_NUMBER(AOT_TOP));\n"
+                         "    } else {\n"
+                         "        AOT_RESUME(%d);\n"
+                         "    }\n", offset);
+            break;
+
+        case OP_JUMP:
+            fprintf(out, "    goto L%d;\n", next + readShort(code, offset + 1));
+            break;
+
+        case OP_JUMP_IF_FALSE:
+            fprintf(out, "    if (AOT_FALSEY(AOT_TOP)) goto L%d;\n", next + readShort(code, offset + 1));
+            break;
+
+        case OP_JUMP_IF_NIL:
+            fprintf(out, "    if (IS_NIL(AOT_TOP)) goto L%d;\n", next + readShort(code, offset + 1));
+            break;
+
+        case OP_LOOP:
+            fprintf(out, "    goto L%d;\n", next - readShort(code, offset + 1));
+            break;
+
+        case OP_FOR_PREP: {
+            int counter = code[offset + 1], limit = code[offset + 2], step = code[offset + 3];
+            ForLoopMode mode = code[offset + 4];
+
+            fprintf(out, "    if (!IS_NUMBER(slots[%d]) || !IS_NUMBER(slots[%d]) || !IS_NUMBER(slots[%d])",
+                    counter, limit, step);
+            if (mode == FOR_RANGE) {
+                fprintf(out, " ||\n        AS_NUMBER(slots[%d]) == 0", step);
+            }
+            fprintf(out, ") AOT_RESUME(%d);\n"
+                         "    {\n"
+                         "        double counter = AS_NUMBER(slots[%d]), limit = AS_NUMBER(slots[%d]), step = AS_NUMBER(slots[%d]);\n"
+                         "        (void) step;\n"
+                         "        if (!(", offset, counter, limit, step);
+            writeForCondition(out, mode, "counter", "limit", "step");
+            fprintf(out, ")) goto L%d;\n"
+                         "    }\n", next + readShort(code, offset + 5));
+            break;
+        }
+
+        case OP_FOR_LOOP: {
+            int counter = code[offset + 1], limit = code[offset + 2], step = code[offset + 3];
+            ForLoopMode mode = code[offset + 4];
+            int body = next - readShort(code, offset + 5);
+
+            fprintf(out, "    if (IS_INT(slots[%d]) && IS_INT(slots[%d]) && IS_INT(slots[%d])) {\n"
+                         "        int64_t counter = AS_INT(slots[%d]) + AS_INT(slots[%d]), limit = AS_INT(slots[%d]), step = AS_INT(slots[%d]);\n"
+                         "        (void) step;\n"
+                         "        slots[%d] = integerToValue(counter);\n"
+                         "        if (",
+                    counter, limit, step, counter, step, limit, step, counter);
+            writeForCondition(out, mode, "counter", "limit", "step");
+            fprintf(out, ") goto L%d;\n"
+                         "    } else {\n"
+                         "        if (!IS_NUMBER(slots[%d]) || !IS_NUMBER(slots[%d])) AOT_RESUME(%d);\n"
+                         "        double counter = AS_NUMBER(slots[%d]) + AS_NUMBER(slots[%d]), limit = AS_NUMBER(slots[%d]), step = AS_NUMBER(slots[%d]);\n"
+                         "        (void) step;\n"
+                         "        slots[%d] = NUMBER_VAL(counter);\n"
+                         "        if (",
+                    body, counter, limit, offset, counter, step, limit, step, counter);
+            writeForCondition(out, mode, "counter", "limit", "step");
+            fprintf(out, ") goto L%d;\n"
+                         "    }\n", body);
+            break;
+        }
+
+        case OP_ITER_INIT:
+            fprintf(out, "    {\n"
+                         "        int size = 0;\n"
+                         "        if (IS_INSTANCE(AOT_TOP) || !iteratorStart(AOT_TOP, &size)) AOT_RESUME(%d);\n"
+                         "        AOT_PUSH(NUMBER_VAL(0));\n"
+                         "        AOT_PUSH(NUMBER_VAL(size));\n"
+                         "    }\n", offset);
+            break;
+
+        case OP_ITER_NEXT: {
+            int slot = code[offset + 1];
+
+            // User iterables call back into the VM between steps, the
+            // interpreter keeps track of those.
+            fprintf(out, "    {\n"
+                         "        Value iterable = slots[%d];\n"
+                         "        if (IS_INSTANCE(iterable)) AOT_RESUME(%d);\n"
+                         "        int cursor = AS_NUMBER(slots[%d]);\n"
+                         "        AOT_SYNC(%d);\n"
+                         "        IteratorResult result = iteratorNext(vm, iterable, &cursor, AS_NUMBER(slots[%d]), &slots[%d]);\n"
+                         "        if (result == ITERATOR_ERROR) return false;\n"
+                         "        AOT_RELOAD();\n"
+                         "        if (result == ITERATOR_DONE) goto L%d;\n"
+                         "        slots[%d] = NUMBER_VAL(cursor);\n"
+                         "    }\n",
+                    slot, offset, slot + 1, next, slot + 2, slot + 3,
+                    next + readShort(code, offset + 2), slot + 1);
+            break;
+        }
+
+        case OP_NEW_LIST:
+            fprintf(out, "    {\n"
+                         "        vm->stackTop = sp;\n"
+                         "        ObjList *list = newList(vm);\n"
+                         "        AOT_PUSH(OBJ_VAL(list));\n"
+                         "        vm->stackTop = sp;\n"
+                         "        for (int i = %d; i > 0; i--) {\n"
+                         "            writeValueArray(vm, &list->values, AOT_PEEK(i));\n"
+                         "        }\n"
+                         "        sp -= %d;\n"
+                         "        AOT_PUSH(OBJ_VAL(list));\n"
+                         "    }\n", code[offset + 1], code[offset + 1] + 1);
+            break;
+
+        case OP_UNPACK_LIST:
+            fprintf(out, "    if (!IS_LIST(AOT_TOP) || AS_LIST(AOT_TOP)->values.count != %d) AOT_RESUME(%d);\n"
+                         "    {\n"
+                         "        ObjList *list = AS_LIST(AOT_POP());\n"
+                         "        for (int i = 0; i < %d; ++i) {\n"
+                         "            AOT_PUSH(list->values.values[i]);\n"
+                         "        }\n"
+                         "    }\n", code[offset + 1], offset, code[offset + 1]);
+            break;
+
+        case OP_SUBSCRIPT:
+            fprintf(out, "    {\n"
+                         "        Value indexValue = AOT_PEEK(0), subscriptValue = AOT_PEEK(1), value;\n"
+                         "        if (IS_LIST(subscriptValue) && IS_NUMBER(indexValue)) {\n"
+                         "            ObjList *list = AS_LIST(subscriptValue);\n"
+                         "            int index = AS_NUMBER(indexValue);\n"
+                         "            if (index < 0) index = list->values.count + index;\n"
+                         "            if (index < 0 || index >= list->values.count) AOT_RESUME(%d);\n"
+                         "            value = list->values.values[index];\n"
+                         "        } else if (!IS_DICT(subscriptValue) || !isValidKey(indexValue) ||\n"
+                         "                   !dictGet(AS_DICT(subscriptValue), indexValue, &value)) {\n"
+                         "            AOT_RESUME(%d);\n"
+                         "        }\n"
+                         "        sp--;\n"
+                         "        AOT_TOP = value;\n"
+                         "    }\n", offset, offset);
+            break;
+
+        case OP_SUBSCRIPT_ASSIGN:
+            fprintf(out, "    {\n"
+                         "        Value indexValue = AOT_PEEK(1), subscriptValue = AOT_PEEK(2);\n"
+                         "        if (!IS_LIST(subscriptValue) || !IS_NUMBER(indexValue)) AOT_RESUME(%d);\n"
+                         "        ObjList *list = AS_LIST(subscriptValue);\n"
+                         "        int index = AS_NUMBER(indexValue);\n"
+                         "        if (index < 0) index = list->values.count + index;\n"
+                         "        if (index < 0 || index >= list->values.count) AOT_RESUME(%d);\n"
+                         "        list->values.values[index] = AOT_TOP;\n"
+                         "        sp -= 3;\n"
+                         "        AOT_PUSH(NIL_VAL);\n"
+                         "    }\n", offset, offset);
+            break;
+
+        case OP_CALL:
+            snprintf(call, sizeof(call), "aotCall(vm, %d, %d)", code[offset + 1], code[offset + 2]);
+            writeCall(out, next, call);
+            break;
+
+        case OP_TAIL_CALL: {
+            int argCount = code[offset + 1];
+
+            // A call to the function itself becomes a jump back to the
+            // start with the arguments moved into place.
+            if (!code[offset + 2]) {
+                fprintf(out, "    if (IS_CLOSURE(AOT_PEEK(%d)) && AS_CLOSURE(AOT_PEEK(%d)) == closure &&\n"
+                             "        closure->function->arity == %d && closure->function->arityOptional == 0 &&\n"
+                             "        !closure->function->isVariadic) {\n"
+                             "        aotCloseUpvalues(vm, slots);\n"
+                             "        memmove(slots, sp - %d, sizeof(Value) * %d);\n"
+                             "        sp = slots + %d;\n"
+                             "        goto L0;\n"
+                             "    }\n", argCount, argCount, argCount, argCount + 1, argCount + 1, argCount + 1);
+            }
+
+            snprintf(call, sizeof(call), "aotCall(vm, %d, %d)", argCount, code[offset + 2]);
+            writeCall(out, next, call);
+            break;
+        }
+
+        case OP_INVOKE:
+        case OP_INVOKE_INTERNAL:
+            snprintf(call, sizeof(call), "%s(vm, AOT_STRING(%d), %d, %d)",
+                     code[offset] == OP_INVOKE ? "aotInvoke" : "aotInvokeInternal",
+                     code[offset + 2], code[offset + 1], code[offset + 3]);
+            writeCall(out, next, call);
+            break;
+
+        case OP_LEN:
+            fprintf(out, "    if (IS_LIST(AOT_TOP)) {\n"
+                         "        AOT_TOP = INT_VAL(AS_LIST(AOT_TOP)->values.count);\n"
+                         "    } else if (IS_STRING(AOT_TOP)) {\n"
+                         "        AOT_TOP = INT_VAL(AS_STRING(AOT_TOP)->length);\n"
+                         "    } else {\n"
+                         "        AOT_SYNC(%d);\n"
+                         "        if (!aotInvoke(vm, AOT_STRING(%d), 0, false)) return false;\n"
+                         "        AOT_RELOAD();\n"
+                         "    }\n", next, code[offset + 1]);
+            break;
+
+        case OP_MATH_UNARY:
+            fprintf(out, "    if (IS_OBJ(AOT_PEEK(1)) && AS_OBJ(AOT_PEEK(1)) == (Obj *) vm->mathModule && IS_NUMBER(AOT_TOP)) {\n"
+                         "        double value = AS_NUMBER(AOT_POP());\n"
+                         "        AOT_TOP = NUMBER_VAL(mathUnary(%d, value));\n"
+                         "    } else {\n"
+                         "        AOT_SYNC(%d);\n"
+                         "        if (!aotInvoke(vm, AOT_STRING(%d), 1, false)) return false;\n"
+                         "        AOT_RELOAD();\n"
+                         "    }\n", code[offset + 1], next, code[offset + 2]);
+            break;
+
+        case OP_SUPER:
+            snprintf(call, sizeof(call), "aotSuper(vm, AOT_STRING(%d), %d, %d)",
+                     code[offset + 2], code[offset + 1], code[offset + 3]);
+            writeCall(out, next, call);
+            break;
+
+        case OP_IMPORT_BUILTIN:
+            snprintf(call, sizeof(call), "aotImportBuiltin(vm, %d, AOT_STRING(%d))",
+                     code[offset + 1], code[offset + 2]);
+            writeCall(out, next, call);
+            break;
+
+        case OP_IMPORT_BUILTIN_VARIABLE:
+        case OP_IMPORT_FROM: {
+            bool builtin = code[offset] == OP_IMPORT_BUILTIN_VARIABLE;
+            int varCount = code[offset + (builtin ? 2 : 1)];
+            uint8_t *names = code + offset + (builtin ? 3 : 2);
+
+            // Every variable is looked up before any is pushed, a missing
+            // one is reported by the interpreter.
+            fprintf(out, "    {\n");
+            if (builtin) {
+                fprintf(out, "        Value moduleValue;\n"
+                             "        if (!tableGet(&vm->modules, AOT_STRING(%d), &moduleValue)) AOT_RESUME(%d);\n"
+                             "        ObjModule *importModule = AS_MODULE(moduleValue);\n",
+                        code[offset + 1], offset);
+            } else {
+                fprintf(out, "        ObjModule *importModule = vm->lastModule;\n");
+            }
+            fprintf(out, "        Value variables[%d];\n", varCount);
+            for (int i = 0; i < varCount; ++i) {
+                fprintf(out, "        if (!tableGet(&importModule->values, AOT_STRING(%d), &variables[%d])) AOT_RESUME(%d);\n",
+                        names[i], i, offset);
+            }
+            for (int i = 0; i < varCount; ++i) {
+                fprintf(out, "        AOT_PUSH(variables[%d]);\n", i);
+            }
+            fprintf(out, "    }\n");
+            break;
+        }
+
+        case OP_IMPORT_VARIABLE:
+            fprintf(out, "    AOT_PUSH(OBJ_VAL(vm->lastModule));\n");
+            break;
+
+        case OP_IMPORT_END:
+            fprintf(out, "    vm->lastModule = closure->function->module;\n");
+            break;
+
+        case OP_CLASS:
+            fprintf(out, "    vm->stackTop = sp;\n"
+                         "    aotClass(vm, AOT_STRING(%d), NULL, %d);\n"
+                         "    AOT_RELOAD();\n", code[offset + 2], code[offset + 1]);
+            break;
+
+        case OP_SUBCLASS:
+            fprintf(out, "    if (!IS_CLASS(AOT_TOP) || AS_CLASS(AOT_TOP)->type == CLASS_TRAIT) AOT_RESUME(%d);\n"
+                         "    vm->stackTop = sp;\n"
+                         "    aotClass(vm, AOT_STRING(%d), AS_CLASS(AOT_TOP), %d);\n"
+                         "    AOT_RELOAD();\n", offset, code[offset + 2], code[offset + 1]);
+            break;
+
+        case OP_METHOD:
+            fprintf(out, "    vm->stackTop = sp;\n"
+                         "    aotMethod(vm, AOT_STRING(%d));\n"
+                         "    AOT_RELOAD();\n", code[offset + 1]);
+            break;
+
+        case OP_SET_CLASS_VAR:
+            fprintf(out, "    vm->stackTop = sp;\n"
+                         "    tableSet(vm, &AS_CLASS(AOT_PEEK(1))->%s, AOT_STRING(%d), AOT_TOP);\n"
+                         "    sp--;\n",
+                    code[offset + 2] ? "publicConstantProperties" : "publicProperties", code[offset + 1]);
+            break;
+
+        case OP_END_CLASS:
+            fprintf(out, "    {\n"
+                         "        ObjClass *klass = AS_CLASS(AOT_TOP);\n"
+                         "        tableFinishResize(vm, &klass->abstractMethods);\n"
+                         "        for (int i = 0; i < klass->abstractMethods.capacityMask + 1; i++) {\n"
+                         "            Value method;\n"
+                         "            if (klass->abstractMethods.entries[i].key != NULL &&\n"
+                         "                !tableGet(&klass->publicMethods, klass->abstractMethods.entries[i].key, &method)) AOT_RESUME(%d);\n"
+                         "        }\n"
+                         "    }\n", offset);
+            break;
+
+        case OP_CLOSURE:
+            fprintf(out, "    vm->stackTop = sp;\n"
+                         "    aotClosure(vm, AS_FUNCTION(constants[%d]), code + %d);\n"
+                         "    AOT_RELOAD();\n", code[offset + 1], offset + 2);
+            break;
+
+        case OP_CLOSE_UPVALUE:
+            fprintf(out, "    aotCloseUpvalues(vm, sp - 1);\n"
+                         "    sp--;\n");
+            break;
+
+        case OP_RETURN:
+            fprintf(out, "    vm->stackTop = sp;\n"
+                         "    return aotReturn(vm);\n");
+            break;
+
+        default:
+            fprintf(out, "    AOT_RESUME(%d);\n", offset);
+            break;
+    }
+}
+
+static void writeFunction(AotWriter *writer, int index) {
+    FILE *out = writer->out;
+    ObjFunction *function = writer->functions[index];
+    Chunk *chunk = &function->chunk;
+
+    bool *targets = ALLOCATE(writer->vm, bool, chunk->count + 1);
+    memset(targets, 0, sizeof(bool) * (chunk->count + 1));
+    markTargets(chunk, targets);
+
+    fprintf(out, "// %s() in %s\n"
+                 "static bool aot%d(DictuVM *vm) {\n"
+                 "    AOT_ENTER();\n\n",
+            function->name != NULL ? function->name->chars : "<anonymous>",
+            function->module->name->chars, index);
+
+    for (int offset = 0; offset < chunk->count;) {
+        int next = offset + 1 + getArgCount(chunk->code, chunk->constants, offset);
+
+        if (targets[offset]) {
+            fprintf(out, "L%d:\n", offset);
+        }
+
+        writeInstruction(out, function, offset, next);
+        offset = next;
+    }
+
+    fprintf(out, "}\n\n");
+    FREE_ARRAY(writer->vm, bool, targets, chunk->count + 1);
+}
+
+static void writeString(FILE *out, const char *string) {
+    fputc('"', out);
+
+    for (const char *c = string; *c != '\0'; ++c) {
+        switch (*c) {
+            case '"':
+                fputs("\\\"", out);
+                break;
+
+            case '\\':
+                fputs("\\\\", out);
+                break;
+
+            case '\n':
+                fputs("\\n\"\n\"", out);
+                break;
+
+            case '\r':
+                fputs("\\r", out);
+                break;
+
+            case '\t':
+                fputs("\\t", out);
+                break;
+
+            default:
+                if ((unsigned char) *c < ' ' || *c == '?') {
+                    // Octal escapes, '?' so trigraphs are never formed.
+                    fprintf(out, "\\%03o", (unsigned char) *c);
+                } else {
+                    fputc(*c, out);
+                }
+                break;
+        }
+    }
+
+    fputc('"', out);
+}
+
+bool aotWriteSource(DictuVM *vm, char *path, char *source, FILE *out) {
+    ObjString *name = copyString(vm, path, strlen(path));
+    push(vm, OBJ_VAL(name));
+    ObjModule *module = newModule(vm, name);
+    pop(vm);
+
+    push(vm, OBJ_VAL(module));
+    module->path = getDirectory(vm, path);
+
+    ObjFunction *function = compile(vm, module, source);
+    if (function == NULL) {
+        pop(vm);
+        return false;
+    }
+
+    push(vm, OBJ_VAL(function));
+
+    AotWriter writer;
+    writer.vm = vm;
+    writer.out = out;
+    writer.functions = NULL;
+    writer.count = 0;
+    writer.capacity = 0;
+    collectFunctions(&writer, function);
+
+    fprintf(out, "// Generated by oolong --aot from %s, build it with the VM\n"
+                 "// sources, see aot.h.\n\n"
+                 "#include \"aot.h\"\n\n", path);
+
+    for (int i = 0; i < writer.count; ++i) {
+        writeFunction(&writer, i);
+    }
+
+    for (int i = 0; i < writer.count; ++i) {
+        Chunk *chunk = &writer.functions[i]->chunk;
+
+        fprintf(out, "static const uint8_t aotCode%d[] = {", i);
+        for (int offset = 0; offset < chunk->count; ++offset) {
+            fprintf(out, "%s%d,", offset % 16 == 0 ? "\n    " : " ", chunk->code[offset]);
+        }
+        fprintf(out, "\n};\n\n");
+    }
+
+    // A dummy entry keeps the array valid C when there is nothing to link.
+    fprintf(out, "static const AotEntry aotEntries[] = {\n");
+    for (int i = 0; i < writer.count; ++i) {
+        fprintf(out, "    {aotCode%d, %d, aot%d},\n", i, writer.functions[i]->chunk.count, i);
+    }
+    if (writer.count == 0) {
+        fprintf(out, "    {NULL, 0, NULL},\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const char aotSource[] =\n");
+    writeString(out, source);
+    fprintf(out, ";\n\n");
+
+    fprintf(out, "int main(int argc, char *argv[]) {\n"
+                 "    return aotMain(argc, argv, ");
+    writeString(out, path);
+    fprintf(out, ", aotSource, aotEntries, %d);\n"
+                 "}\n", writer.count);
+
+    FREE_ARRAY(vm, ObjFunction *, writer.functions, writer.capacity);
+    pop(vm);
+    pop(vm);
+
+    return true;
+}
+
+DictuInterpretResult dictuCompileToC(DictuVM *vm, char *moduleName, char *source, const char *output) {
+    FILE *out = fopen(output, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Could not open file \"%s\".\n", output);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+
+    bool compiled = aotWriteSource(vm, moduleName, source, out);
+    fclose(out);
+
+    if (!compiled) {
+        remove(output);
+        return INTERPRET_COMPILE_ERROR;
+    }
+
+    return INTERPRET_OK;
+}
+
+void aotLink(DictuVM *vm, ObjFunction *function) {
+    if (function->aot == NULL) {
+        for (int i = 0; i < vm->aotEntryCount; ++i) {
+            const AotEntry *entry = &vm->aotEntries[i];
+
+            if (sameCode(function, entry->code, entry->count)) {
+                function->aot = entry->function;
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < function->chunk.constants.count; ++i) {
+        Value constant = function->chunk.constants.values[i];
+
+        if (IS_FUNCTION(constant)) {
+            aotLink(vm, AS_FUNCTION(constant));
+        }
+    }
+}
+
+int aotMain(int argc, char *argv[], const char *path, const char *source,
+            const AotEntry *entries, int entryCount) {
+    // Scripts see the same arguments as when run by the interpreter.
+    argv[0] = (char *) path;
+
+    DictuVM *vm = dictuInitVM(false, argc, argv);
+    vm->aotEntries = entries;
+    vm->aotEntryCount = entryCount;
+
+    DictuInterpretResult result = dictuInterpret(vm, (char *) path, (char *) source);
+
+    if (result == INTERPRET_COMPILE_ERROR) exit(65);
+    if (result == INTERPRET_RUNTIME_ERROR) exit(70);
+
+    dictuFreeVM(vm);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#ifndef oolong_aot_h
+#define oolong_aot_h
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "object.h"
+#include "memory.h"
+#include "vm.h"
+#include "iterators.h"
+#include "optionals.h"
+
+/*
+ * Ahead of time compilation turns the bytecode of every function in a
+ * script into a C function. `oolong --aot out.c script.du` writes them
+ * out along with the script source and a main(). To build a standalone
+ * executable, compile every VM source but main.c in its own directory
+ * without src/vm on the include path, since src/vm/time.h and math.h
+ * shadow the system headers. Then compile out.c with -I src/vm and link
+ * it against those objects with -lm -lpthread. From a build directory
+ * beside src, `cc -c ../src/vm/NAME.c` for each source, then
+ * `cc -I ../src/vm out.c OBJECTS -lm -lpthread`.
+ *
+ * At startup the embedded source is compiled as usual and each function
+ * whose bytecode matches a generated one is linked to it, call() then
+ * runs the C code instead of interpreting the frame. Instructions are
+ * translated with their common cases inline, anything else (an operand
+ * of an unexpected type, an error, a rare opcode) stores the frame state
+ * and resumes the interpreter at that instruction for the rest of the
+ * call, so behaviour matches the interpreter exactly.
+ */
+
+struct sAotEntry {
+    const uint8_t *code;
+    int count;
+    AotFn function;
+};
+
+// Attaches generated code to function and every function nested in it.
+void aotLink(DictuVM *vm, ObjFunction *function);
+
+// Compiles source and writes the C translation of it to out. Returns
+// false if the source does not compile.
+bool aotWriteSource(DictuVM *vm, char *path, char *source, FILE *out);
+
+// Entry point of a generated executable, runs source as the script at path.
+int aotMain(int argc, char *argv[], const char *path, const char *source,
+            const AotEntry *entries, int entryCount);
+
+// Runtime entry points used by generated code, defined in vm.c. Calls
+// leave the result in place of the callee.
+bool aotCall(DictuVM *vm, int argCount, bool unpack);
+
+bool aotInvoke(DictuVM *vm, ObjString *name, int argCount, bool unpack);
+
+bool aotInvokeInternal(DictuVM *vm, ObjString *name, int argCount, bool unpack);
+
+// Pops the superclass off the stack before calling its method.
+bool aotSuper(DictuVM *vm, ObjString *name, int argCount, bool unpack);
+
+bool aotImportBuiltin(DictuVM *vm, int index, ObjString *fileName);
+
+void aotClass(DictuVM *vm, ObjString *name, ObjClass *superclass, ClassType type);
+
+void aotMethod(DictuVM *vm, ObjString *name);
+
+// Interprets the current frame from its saved ip until it returns.
+bool aotResume(DictuVM *vm);
+
+// Returns from the current frame with the value on top of the stack.
+bool aotReturn(DictuVM *vm);
+
+void aotConcatenate(DictuVM *vm);
+
+void aotCloseUpvalues(DictuVM *vm, Value *last);
+
+// Pushes a closure of function, captures points at the OP_CLOSURE
+// upvalue operands.
+void aotClosure(DictuVM *vm, ObjFunction *function, uint8_t *captures);
+
+/*
+ * Generated functions keep the stack top in sp, like run() does, and
+ * write it back before anything that may collect garbage or call out.
+ */
+#define AOT_ENTER()                                                     \
+    int frameIndex = vm->frameCount - 1;                                \
+    ObjClosure *closure = vm->frames[frameIndex].closure;               \
+    uint8_t *code = closure->function->chunk.code;                      \
+    Value *constants = closure->function->chunk.constants.values;       \
+    Table *module = &closure->function->module->values;                 \
+    Value *slots = vm->frames[frameIndex].slots;                        \
+    Value *sp = vm->stackTop;                                           \
+    (void) code; (void) constants; (void) module; (void) slots
+
+#define AOT_PUSH(value) (*sp++ = (value))
+#define AOT_POP() (*--sp)
+#define AOT_PEEK(distance) (sp[-1 - (distance)])
+#define AOT_TOP (sp[-1])
+#define AOT_STRING(index) AS_STRING(constants[index])
+#define AOT_FALSEY(value) (IS_BOOL(value) ? !AS_BOOL(value) : isFalsey(value))
+
+// offset is where the interpreter would stand, the next instruction for
+// a call so errors report the right line.
+#define AOT_SYNC(offset) (vm->frames[frameIndex].ip = code + (offset), vm->stackTop = sp)
+#define AOT_RELOAD() (sp = vm->stackTop)
+
+#define AOT_RESUME(offset)                                              \
+    do {                                                                \
+        AOT_SYNC(offset);                                               \
+        return aotResume(vm);                                           \
+    } while (false)
+
+// OP_DEFINE_OPTIONAL, keeps the defaults for the parameters not passed.
+#define AOT_DEFINE_OPTIONAL(arity, arityOptional)                       \
+    do {                                                                \
+        int argCount = sp - slots - (arityOptional) - 1;                \
+        int remaining = (arity) + (arityOptional) - argCount;           \
+        Value *defaults = slots + 1 + argCount;                         \
+        memmove(defaults, defaults + (arityOptional) - remaining,       \
+                sizeof(Value) * remaining);                             \
+        sp = defaults + remaining;                                      \
+    } while (false)
+
+#endif //oolong_aot_h
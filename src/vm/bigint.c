@@ -0,0 +1,1196 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bigint.h"
+#include "memory.h"
+
+/*
+ * Magnitudes are little endian arrays of 32 bit limbs. The routines
+ * below work on plain arrays so intermediate results live in malloc'd
+ * scratch space and only the final value is allocated on the GC heap.
+ */
+
+#define LIMB_BITS 32
+#define DECIMAL_BASE 1000000000u
+#define DECIMAL_DIGITS 9
+
+static int magNormalize(const uint32_t *a, int count) {
+    while (count > 0 && a[count - 1] == 0) {
+        count--;
+    }
+
+    return count;
+}
+
+static int magCompare(const uint32_t *a, int aCount, const uint32_t *b, int bCount) {
+    if (aCount != bCount) {
+        return aCount < bCount ? -1 : 1;
+    }
+
+    for (int i = aCount - 1; i >= 0; --i) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+// result = a + b where aCount >= bCount, result holds aCount + 1 limbs.
+static int magAdd(uint32_t *result, const uint32_t *a, int aCount, const uint32_t *b, int bCount) {
+    uint64_t carry = 0;
+    int i = 0;
+
+    for (; i < bCount; ++i) {
+        carry += (uint64_t) a[i] + b[i];
+        result[i] = (uint32_t) carry;
+        carry >>= LIMB_BITS;
+    }
+
+    for (; i < aCount; ++i) {
+        carry += a[i];
+        result[i] = (uint32_t) carry;
+        carry >>= LIMB_BITS;
+    }
+
+    result[i] = (uint32_t) carry;
+    return magNormalize(result, aCount + 1);
+}
+
+// result = a - b where a >= b, result holds aCount limbs.
+static int magSub(uint32_t *result, const uint32_t *a, int aCount, const uint32_t *b, int bCount) {
+    int64_t borrow = 0;
+    int i = 0;
+
+    for (; i < bCount; ++i) {
+        borrow += (int64_t) a[i] - b[i];
+        result[i] = (uint32_t) borrow;
+        borrow >>= LIMB_BITS;
+    }
+
+    for (; i < aCount; ++i) {
+        borrow += a[i];
+        result[i] = (uint32_t) borrow;
+        borrow >>= LIMB_BITS;
+    }
+
+    return magNormalize(result, aCount);
+}
+
+// a += b in place, the caller guarantees the sum fits in aCount limbs.
+static void magAddInto(uint32_t *a, int aCount, const uint32_t *b, int bCount) {
+    uint64_t carry = 0;
+    int i = 0;
+
+    for (; i < bCount; ++i) {
+        carry += (uint64_t) a[i] + b[i];
+        a[i] = (uint32_t) carry;
+        carry >>= LIMB_BITS;
+    }
+
+    for (; carry != 0 && i < aCount; ++i) {
+        carry += a[i];
+        a[i] = (uint32_t) carry;
+        carry >>= LIMB_BITS;
+    }
+}
+
+// a -= b in place where a >= b.
+static void magSubInto(uint32_t *a, int aCount, const uint32_t *b, int bCount) {
+    int64_t borrow = 0;
+    int i = 0;
+
+    for (; i < bCount; ++i) {
+        borrow += (int64_t) a[i] - b[i];
+        a[i] = (uint32_t) borrow;
+        borrow >>= LIMB_BITS;
+    }
+
+    for (; borrow != 0 && i < aCount; ++i) {
+        borrow += a[i];
+        a[i] = (uint32_t) borrow;
+        borrow >>= LIMB_BITS;
+    }
+}
+
+static void magMulSchoolbook(uint32_t *result, const uint32_t *a, int aCount, const uint32_t *b, int bCount) {
+    memset(result, 0, sizeof(uint32_t) * (aCount + bCount));
+
+    for (int i = 0; i < bCount; ++i) {
+        uint64_t carry = 0;
+        uint64_t limb = b[i];
+
+        if (limb == 0) {
+            continue;
+        }
+
+        for (int j = 0; j < aCount; ++j) {
+            carry += a[j] * limb + result[i + j];
+            result[i + j] = (uint32_t) carry;
+            carry >>= LIMB_BITS;
+        }
+
+        result[i + aCount] = (uint32_t) carry;
+    }
+}
+
+// result = a * b, result holds aCount + bCount limbs and must not
+// overlap either operand.
+static void magMul(uint32_t *result, const uint32_t *a, int aCount, const uint32_t *b, int bCount) {
+    if (aCount < bCount) {
+        const uint32_t *tmp = a;
+        a = b;
+        b = tmp;
+
+        int tmpCount = aCount;
+        aCount = bCount;
+        bCount = tmpCount;
+    }
+
+    if (bCount < BIGINT_KARATSUBA_THRESHOLD) {
+        magMulSchoolbook(result, a, aCount, b, bCount);
+        return;
+    }
+
+    memset(result, 0, sizeof(uint32_t) * (aCount + bCount));
+
+    // Unbalanced operands, multiply b by each bCount sized slice of a
+    // so every recursive call is balanced.
+    if (bCount * 2 <= aCount) {
+        uint32_t *product = malloc(sizeof(uint32_t) * bCount * 2);
+
+        for (int i = 0; i < aCount; i += bCount) {
+            int sliceCount = aCount - i < bCount ? aCount - i : bCount;
+            sliceCount = magNormalize(a + i, sliceCount);
+
+            if (sliceCount == 0) {
+                continue;
+            }
+
+            magMul(product, a + i, sliceCount, b, bCount);
+            magAddInto(result + i, aCount + bCount - i, product, magNormalize(product, sliceCount + bCount));
+        }
+
+        free(product);
+        return;
+    }
+
+    // a = a1 * B^half + a0, b = b1 * B^half + b0, bCount > half here.
+    int half = (aCount + 1) / 2;
+    int a0Count = magNormalize(a, half);
+    int b0Count = magNormalize(b, half);
+    int a1Count = aCount - half;
+    int b1Count = magNormalize(b + half, bCount - half);
+
+    // z0 = a0 * b0 and z2 = a1 * b1 go straight into the two halves of
+    // the result, they cannot overlap.
+    if (a0Count > 0 && b0Count > 0) {
+        magMul(result, a, a0Count, b, b0Count);
+    }
+
+    if (b1Count > 0) {
+        magMul(result + half * 2, a + half, a1Count, b + half, b1Count);
+    }
+
+    int z0Count = magNormalize(result, half * 2);
+    int z2Count = magNormalize(result + half * 2, aCount + bCount - half * 2);
+
+    uint32_t *scratch = malloc(sizeof(uint32_t) * (half + 1) * 4);
+    uint32_t *aSum = scratch;
+    uint32_t *bSum = scratch + half + 1;
+    uint32_t *middle = scratch + (half + 1) * 2;
+
+    int aSumCount = a0Count >= a1Count ? magAdd(aSum, a, a0Count, a + half, a1Count)
+                                       : magAdd(aSum, a + half, a1Count, a, a0Count);
+    int bSumCount = b0Count >= b1Count ? magAdd(bSum, b, b0Count, b + half, b1Count)
+                                       : magAdd(bSum, b + half, b1Count, b, b0Count);
+
+    // z1 = (a0 + a1)(b0 + b1) - z0 - z2 = a0 * b1 + a1 * b0
+    int middleCount = aSumCount + bSumCount;
+    if (aSumCount > 0 && bSumCount > 0) {
+        magMul(middle, aSum, aSumCount, bSum, bSumCount);
+    } else {
+        memset(middle, 0, sizeof(uint32_t) * middleCount);
+    }
+
+    magSubInto(middle, middleCount, result, z0Count);
+    magSubInto(middle, middleCount, result + half * 2, z2Count);
+    magAddInto(result + half, aCount + bCount - half, middle, magNormalize(middle, middleCount));
+
+    free(scratch);
+}
+
+// Divides a in place by a single limb and returns the remainder.
+static uint32_t magDivLimb(uint32_t *a, int count, uint32_t divisor) {
+    uint64_t remainder = 0;
+
+    for (int i = count - 1; i >= 0; --i) {
+        uint64_t current = (remainder << LIMB_BITS) | a[i];
+        a[i] = (uint32_t) (current / divisor);
+        remainder = current % divisor;
+    }
+
+    return (uint32_t) remainder;
+}
+
+// a = a * factor + addend in place, a holds count + 1 limbs.
+static int magMulAddLimb(uint32_t *a, int count, uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+
+    for (int i = 0; i < count; ++i) {
+        carry += (uint64_t) a[i] * factor;
+        a[i] = (uint32_t) carry;
+        carry >>= LIMB_BITS;
+    }
+
+    a[count] = (uint32_t) carry;
+    return magNormalize(a, count + 1);
+}
+
+static int leadingZeros(uint32_t limb) {
+    int count = 0;
+
+    while ((limb & 0x80000000u) == 0) {
+        limb <<= 1;
+        count++;
+    }
+
+    return count;
+}
+
+/*
+ * Knuth's algorithm D. quotient holds aCount - bCount + 1 limbs and
+ * remainder bCount limbs, either may be NULL. Requires bCount > 0.
+ */
+static void magDivMod(const uint32_t *a, int aCount, const uint32_t *b, int bCount,
+                      uint32_t *quotient, int *quotientCount, uint32_t *remainder, int *remainderCount) {
+    if (magCompare(a, aCount, b, bCount) < 0) {
+        if (quotient != NULL) {
+            *quotientCount = 0;
+        }
+
+        if (remainder != NULL) {
+            memcpy(remainder, a, sizeof(uint32_t) * aCount);
+            *remainderCount = aCount;
+        }
+
+        return;
+    }
+
+    if (bCount == 1) {
+        uint32_t *q = malloc(sizeof(uint32_t) * aCount);
+        memcpy(q, a, sizeof(uint32_t) * aCount);
+        uint32_t rest = magDivLimb(q, aCount, b[0]);
+
+        if (quotient != NULL) {
+            memcpy(quotient, q, sizeof(uint32_t) * aCount);
+            *quotientCount = magNormalize(quotient, aCount);
+        }
+
+        if (remainder != NULL) {
+            remainder[0] = rest;
+            *remainderCount = rest != 0;
+        }
+
+        free(q);
+        return;
+    }
+
+    // Normalise so the top bit of the divisor is set, which keeps every
+    // estimated quotient digit within two of the real one.
+    int shift = leadingZeros(b[bCount - 1]);
+    uint32_t *u = malloc(sizeof(uint32_t) * (aCount + 1 + bCount));
+    uint32_t *v = u + aCount + 1;
+
+    for (int i = bCount - 1; i > 0; --i) {
+        v[i] = shift ? (b[i] << shift) | (b[i - 1] >> (LIMB_BITS - shift)) : b[i];
+    }
+    v[0] = b[0] << shift;
+
+    u[aCount] = shift ? a[aCount - 1] >> (LIMB_BITS - shift) : 0;
+    for (int i = aCount - 1; i > 0; --i) {
+        u[i] = shift ? (a[i] << shift) | (a[i - 1] >> (LIMB_BITS - shift)) : a[i];
+    }
+    u[0] = a[0] << shift;
+
+    int steps = aCount - bCount;
+    uint64_t top = v[bCount - 1];
+    uint64_t next = v[bCount - 2];
+
+    for (int j = steps; j >= 0; --j) {
+        uint64_t numerator = ((uint64_t) u[j + bCount] << LIMB_BITS) | u[j + bCount - 1];
+        uint64_t estimate = numerator / top;
+        uint64_t rest = numerator % top;
+
+        while (estimate >> LIMB_BITS ||
+               estimate * next > ((rest << LIMB_BITS) | u[j + bCount - 2])) {
+            estimate--;
+            rest += top;
+
+            if (rest >> LIMB_BITS) {
+                break;
+            }
+        }
+
+        // u[j .. j + bCount] -= estimate * v
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (int i = 0; i < bCount; ++i) {
+            carry += estimate * v[i];
+            borrow += (int64_t) u[i + j] - (uint32_t) carry;
+            u[i + j] = (uint32_t) borrow;
+            carry >>= LIMB_BITS;
+            borrow >>= LIMB_BITS;
+        }
+        borrow += (int64_t) u[j + bCount] - (int64_t) carry;
+        u[j + bCount] = (uint32_t) borrow;
+
+        // The estimate was one too large, add the divisor back.
+        if (borrow < 0) {
+            estimate--;
+            carry = 0;
+            for (int i = 0; i < bCount; ++i) {
+                carry += (uint64_t) u[i + j] + v[i];
+                u[i + j] = (uint32_t) carry;
+                carry >>= LIMB_BITS;
+            }
+            u[j + bCount] += (uint32_t) carry;
+        }
+
+        if (quotient != NULL) {
+            quotient[j] = (uint32_t) estimate;
+        }
+    }
+
+    if (quotient != NULL) {
+        *quotientCount = magNormalize(quotient, steps + 1);
+    }
+
+    if (remainder != NULL) {
+        for (int i = 0; i < bCount - 1; ++i) {
+            remainder[i] = shift ? (u[i] >> shift) | (u[i + 1] << (LIMB_BITS - shift)) : u[i];
+        }
+        remainder[bCount - 1] = u[bCount - 1] >> shift;
+        *remainderCount = magNormalize(remainder, bCount);
+    }
+
+    free(u);
+}
+
+/*
+ * Signed values used while evaluating an operation. Operands that are
+ * plain numbers are converted into the inline buffer, which is large
+ * enough for any finite double.
+ */
+typedef struct {
+    int sign;
+    int count;
+    uint32_t *limbs;
+    uint32_t buffer[34];
+} BigNum;
+
+static bool numberToBigNum(Value value, BigNum *number) {
+    number->limbs = number->buffer;
+
+    if (IS_INT(value)) {
+        int64_t integer = AS_INT(value);
+        uint64_t magnitude = integer < 0 ? -(uint64_t) integer : (uint64_t) integer;
+
+        number->sign = integer < 0 ? -1 : integer > 0;
+        number->buffer[0] = (uint32_t) magnitude;
+        number->buffer[1] = (uint32_t) (magnitude >> LIMB_BITS);
+        number->count = magNormalize(number->buffer, 2);
+        return true;
+    }
+
+    double real = AS_NUMBER(value);
+    if (!isfinite(real) || real != trunc(real)) {
+        return false;
+    }
+
+    int exponent;
+    double fraction = frexp(fabs(real), &exponent);
+    uint64_t mantissa = (uint64_t) ldexp(fraction, 53);
+    exponent -= 53;
+
+    if (exponent < 0) {
+        mantissa >>= -exponent;
+        exponent = 0;
+    }
+
+    memset(number->buffer, 0, sizeof(number->buffer));
+    int limb = exponent / LIMB_BITS;
+    int bit = exponent % LIMB_BITS;
+
+    number->buffer[limb] = (uint32_t) (mantissa << bit);
+    number->buffer[limb + 1] = (uint32_t) ((mantissa << bit) >> LIMB_BITS);
+    number->buffer[limb + 2] = bit ? (uint32_t) (mantissa >> (64 - bit)) : 0;
+    number->count = magNormalize(number->buffer, limb + 3);
+    number->sign = real < 0 ? -1 : number->count > 0;
+    return true;
+}
+
+static bool toBigNum(Value value, BigNum *number) {
+    if (IS_BIGINT(value)) {
+        ObjBigInt *bigInt = AS_BIGINT(value);
+        number->sign = bigInt->sign;
+        number->count = bigInt->count;
+        number->limbs = bigInt->limbs;
+        return true;
+    }
+
+    return IS_NUMBER(value) && numberToBigNum(value, number);
+}
+
+static double bigNumToDouble(int sign, const uint32_t *limbs, int count) {
+    double result = 0;
+    int low = count > 3 ? count - 3 : 0;
+
+    for (int i = count - 1; i >= low; --i) {
+        result = result * 4294967296.0 + limbs[i];
+    }
+
+    return sign * ldexp(result, low * LIMB_BITS);
+}
+
+static int compareBigNum(BigNum *a, BigNum *b) {
+    if (a->sign != b->sign) {
+        return a->sign < b->sign ? -1 : 1;
+    }
+
+    return a->sign * magCompare(a->limbs, a->count, b->limbs, b->count);
+}
+
+bool bigIntEqualsNumber(ObjBigInt *bigInt, Value number) {
+    BigNum other;
+
+    if (!numberToBigNum(number, &other)) {
+        return false;
+    }
+
+    return bigInt->sign == other.sign &&
+           magCompare(bigInt->limbs, bigInt->count, other.limbs, other.count) == 0;
+}
+
+bool bigIntToExactNumber(ObjBigInt *bigInt, double *number) {
+    *number = bigNumToDouble(bigInt->sign, bigInt->limbs, bigInt->count);
+    return bigIntEqualsNumber(bigInt, NUMBER_VAL(*number));
+}
+
+// Signed addition, subtract flips the sign of b. The result holds
+// max(count) + 1 limbs.
+static int addBigNum(uint32_t *result, int *sign, BigNum *a, BigNum *b, bool subtract) {
+    int bSign = subtract ? -b->sign : b->sign;
+
+    if (b->sign == 0) {
+        memcpy(result, a->limbs, sizeof(uint32_t) * a->count);
+        *sign = a->sign;
+        return a->count;
+    }
+
+    if (a->sign == 0) {
+        memcpy(result, b->limbs, sizeof(uint32_t) * b->count);
+        *sign = bSign;
+        return b->count;
+    }
+
+    if (a->sign == bSign) {
+        *sign = a->sign;
+        return a->count >= b->count ? magAdd(result, a->limbs, a->count, b->limbs, b->count)
+                                    : magAdd(result, b->limbs, b->count, a->limbs, a->count);
+    }
+
+    if (magCompare(a->limbs, a->count, b->limbs, b->count) >= 0) {
+        *sign = a->sign;
+        return magSub(result, a->limbs, a->count, b->limbs, b->count);
+    }
+
+    *sign = bSign;
+    return magSub(result, b->limbs, b->count, a->limbs, a->count);
+}
+
+// base ** exponent by repeated squaring, returns a malloc'd magnitude.
+static uint32_t *magPow(const uint32_t *base, int baseCount, uint64_t exponent, int *count) {
+    uint64_t bits = 0;
+    for (uint64_t e = exponent; e != 0; e >>= 1) {
+        bits++;
+    }
+
+    int capacity = baseCount * (int) (exponent ? exponent : 1) + 1;
+    uint32_t *result = malloc(sizeof(uint32_t) * capacity);
+    uint32_t *scratch = malloc(sizeof(uint32_t) * capacity);
+    int resultCount = 1;
+    result[0] = 1;
+
+    // Left to right, the result is squared once per exponent bit.
+    for (int i = (int) bits - 1; i >= 0; --i) {
+        magMul(scratch, result, resultCount, result, resultCount);
+        resultCount = magNormalize(scratch, resultCount * 2);
+
+        if ((exponent >> i) & 1) {
+            magMul(result, scratch, resultCount, base, baseCount);
+            resultCount = magNormalize(result, resultCount + baseCount);
+        } else {
+            uint32_t *tmp = result;
+            result = scratch;
+            scratch = tmp;
+        }
+    }
+
+    free(scratch);
+    *count = resultCount;
+    return result;
+}
+
+// Returns NULL after a runtime error when the result would not fit.
+static ObjBigInt *powBigNum(DictuVM *vm, BigNum *base, uint64_t exponent) {
+    if (base->count > 1 || (base->count == 1 && base->limbs[0] > 1)) {
+        uint64_t bits = (uint64_t) base->count * LIMB_BITS * exponent;
+
+        if ((exponent != 0 && bits / exponent != (uint64_t) base->count * LIMB_BITS) ||
+            bits > (uint64_t) INT32_MAX * 4) {
+            runtimeError(vm, "BigInt power is too large.");
+            return NULL;
+        }
+    } else if (base->sign != 0) {
+        // Powers of 1 and -1 never grow.
+        uint32_t one = 1;
+        return newBigInt(vm, base->sign < 0 && (exponent & 1) ? -1 : 1, &one, 1);
+    }
+
+    if (base->sign == 0) {
+        uint32_t one = 1;
+        return newBigInt(vm, 1, &one, exponent == 0);
+    }
+
+    int count;
+    uint32_t *limbs = magPow(base->limbs, base->count, exponent, &count);
+    ObjBigInt *result = newBigInt(vm, base->sign < 0 && (exponent & 1) ? -1 : 1, limbs, count);
+    free(limbs);
+
+    return result;
+}
+
+static bool exponentValue(DictuVM *vm, BigNum *exponent, uint64_t *value) {
+    if (exponent->sign < 0) {
+        runtimeError(vm, "BigInt exponent must not be negative.");
+        return false;
+    }
+
+    if (exponent->count > 1) {
+        runtimeError(vm, "BigInt exponent is too large.");
+        return false;
+    }
+
+    *value = exponent->count ? exponent->limbs[0] : 0;
+    return true;
+}
+
+static Value bigNumDivide(DictuVM *vm, BigNum *a, BigNum *b, bool modulo) {
+    if (b->sign == 0) {
+        runtimeError(vm, modulo ? "Modulo by zero." : "Division by zero.");
+        return EMPTY_VAL;
+    }
+
+    int count = a->count + 1;
+    uint32_t *scratch = malloc(sizeof(uint32_t) * (count + b->count));
+    uint32_t *quotient = scratch;
+    uint32_t *remainder = scratch + count;
+    int quotientCount, remainderCount;
+
+    magDivMod(a->limbs, a->count, b->limbs, b->count,
+              quotient, &quotientCount, remainder, &remainderCount);
+
+    // Truncating like the integer operators, the remainder takes the
+    // sign of the dividend.
+    ObjBigInt *result = modulo ? newBigInt(vm, a->sign, remainder, remainderCount)
+                               : newBigInt(vm, a->sign * b->sign, quotient, quotientCount);
+    free(scratch);
+
+    return OBJ_VAL(result);
+}
+
+static void operandError(DictuVM *vm, const char *op) {
+    int firstLength = 0;
+    int secondLength = 0;
+    char *first = valueTypeToString(vm, vm->stackTop[-2], &firstLength);
+    char *second = valueTypeToString(vm, vm->stackTop[-1], &secondLength);
+
+    runtimeError(vm, "Unsupported operand types for %s: '%s', '%s'", op, first, second);
+    FREE_ARRAY(vm, char, first, firstLength + 1);
+    FREE_ARRAY(vm, char, second, secondLength + 1);
+}
+
+// Orders a BigInt against any number, fractional ones included.
+// Returns 2 when the number is NaN and unordered.
+static int compareMixed(BigNum *bigNum, Value number) {
+    double real = AS_NUMBER(number);
+
+    if (real != real) {
+        return 2;
+    }
+
+    if (isinf(real)) {
+        return real > 0 ? -1 : 1;
+    }
+
+    BigNum other;
+    double floored = floor(real);
+    numberToBigNum(NUMBER_VAL(floored), &other);
+
+    int comparison = compareBigNum(bigNum, &other);
+    if (floored != real && comparison == 0) {
+        return -1;
+    }
+
+    return comparison;
+}
+
+bool bigIntOperator(DictuVM *vm, OpCode op) {
+    Value aValue = vm->stackTop[-2];
+    Value bValue = vm->stackTop[-1];
+    BigNum a, b;
+
+    if (op == OP_LESS || op == OP_GREATER) {
+        int comparison;
+
+        if (IS_BIGINT(aValue) && IS_BIGINT(bValue)) {
+            toBigNum(aValue, &a);
+            toBigNum(bValue, &b);
+            comparison = compareBigNum(&a, &b);
+        } else if (IS_BIGINT(aValue) && IS_NUMBER(bValue)) {
+            toBigNum(aValue, &a);
+            comparison = compareMixed(&a, bValue);
+        } else if (IS_NUMBER(aValue) && IS_BIGINT(bValue)) {
+            toBigNum(bValue, &b);
+            comparison = compareMixed(&b, aValue);
+            comparison = comparison == 2 ? 2 : -comparison;
+        } else {
+            operandError(vm, op == OP_LESS ? "<" : ">");
+            return false;
+        }
+
+        vm->stackTop--;
+        vm->stackTop[-1] = BOOL_VAL(op == OP_LESS ? comparison == -1 : comparison == 1);
+        return true;
+    }
+
+    const char *symbol;
+    switch (op) {
+        case OP_ADD: symbol = "+"; break;
+        case OP_SUBTRACT: symbol = "-"; break;
+        case OP_MULTIPLY: symbol = "*"; break;
+        case OP_DIVIDE: symbol = "/"; break;
+        case OP_MOD: symbol = "%"; break;
+        default: symbol = "**"; break;
+    }
+
+    if ((!IS_BIGINT(aValue) && !IS_NUMBER(aValue)) || (!IS_BIGINT(bValue) && !IS_NUMBER(bValue))) {
+        operandError(vm, symbol);
+        return false;
+    }
+
+    if (!toBigNum(aValue, &a) || !toBigNum(bValue, &b)) {
+        runtimeError(vm, "BigInt arithmetic requires integer operands.");
+        return false;
+    }
+
+    Value result;
+
+    switch (op) {
+        case OP_ADD:
+        case OP_SUBTRACT: {
+            int count = (a.count > b.count ? a.count : b.count) + 1;
+            uint32_t *limbs = malloc(sizeof(uint32_t) * count);
+            int sign;
+
+            count = addBigNum(limbs, &sign, &a, &b, op == OP_SUBTRACT);
+            result = OBJ_VAL(newBigInt(vm, sign, limbs, count));
+            free(limbs);
+            break;
+        }
+
+        case OP_MULTIPLY: {
+            int count = a.count + b.count;
+            uint32_t *limbs = malloc(sizeof(uint32_t) * (count ? count : 1));
+
+            if (a.sign != 0 && b.sign != 0) {
+                magMul(limbs, a.limbs, a.count, b.limbs, b.count);
+            } else {
+                count = 0;
+            }
+
+            result = OBJ_VAL(newBigInt(vm, a.sign * b.sign, limbs, count));
+            free(limbs);
+            break;
+        }
+
+        case OP_DIVIDE:
+        case OP_MOD: {
+            result = bigNumDivide(vm, &a, &b, op == OP_MOD);
+
+            if (IS_EMPTY(result)) {
+                return false;
+            }
+            break;
+        }
+
+        default: {
+            uint64_t exponent;
+
+            if (!exponentValue(vm, &b, &exponent)) {
+                return false;
+            }
+
+            ObjBigInt *power = powBigNum(vm, &a, exponent);
+            if (power == NULL) {
+                return false;
+            }
+
+            result = OBJ_VAL(power);
+            break;
+        }
+    }
+
+    vm->stackTop--;
+    vm->stackTop[-1] = result;
+    return true;
+}
+
+void bigIntNegate(DictuVM *vm) {
+    ObjBigInt *bigInt = AS_BIGINT(vm->stackTop[-1]);
+    vm->stackTop[-1] = OBJ_VAL(newBigInt(vm, -bigInt->sign, bigInt->limbs, bigInt->count));
+}
+
+/*
+ * Base conversion splits the number around 10^(9 * 2^k) so the work is
+ * done by a few large multiplications or divisions instead of one limb
+ * at a time. powers[k] holds 10^(9 * 2^k).
+ */
+typedef struct {
+    uint32_t *limbs;
+    int count;
+} Power;
+
+static Power *decimalPowers(int levels) {
+    Power *powers = malloc(sizeof(Power) * levels);
+    powers[0].limbs = malloc(sizeof(uint32_t));
+    powers[0].limbs[0] = DECIMAL_BASE;
+    powers[0].count = 1;
+
+    for (int k = 1; k < levels; ++k) {
+        Power *previous = &powers[k - 1];
+        powers[k].limbs = malloc(sizeof(uint32_t) * previous->count * 2);
+        magMul(powers[k].limbs, previous->limbs, previous->count, previous->limbs, previous->count);
+        powers[k].count = magNormalize(powers[k].limbs, previous->count * 2);
+    }
+
+    return powers;
+}
+
+static void freeDecimalPowers(Power *powers, int levels) {
+    for (int k = 0; k < levels; ++k) {
+        free(powers[k].limbs);
+    }
+
+    free(powers);
+}
+
+// Writes exactly width digits of a, zero padded, consuming a.
+static void writeDigits(char *out, uint32_t *a, int count, int width, Power *powers, int level) {
+    if (level < 0 || count <= BIGINT_CONVERSION_THRESHOLD) {
+        char *cursor = out + width;
+
+        while (cursor > out) {
+            uint32_t chunk = count > 0 ? magDivLimb(a, count, DECIMAL_BASE) : 0;
+            count = magNormalize(a, count);
+
+            for (int i = 0; i < DECIMAL_DIGITS && cursor > out; ++i) {
+                *--cursor = (char) ('0' + chunk % 10);
+                chunk /= 10;
+            }
+        }
+
+        return;
+    }
+
+    int lowWidth = DECIMAL_DIGITS << level;
+    Power *power = &powers[level];
+
+    if (width <= lowWidth) {
+        writeDigits(out, a, count, width, powers, level - 1);
+        return;
+    }
+
+    uint32_t *scratch = malloc(sizeof(uint32_t) * (count + 1 + power->count));
+    uint32_t *high = scratch;
+    uint32_t *low = scratch + count + 1;
+    int highCount, lowCount;
+
+    magDivMod(a, count, power->limbs, power->count, high, &highCount, low, &lowCount);
+    writeDigits(out, high, highCount, width - lowWidth, powers, level - 1);
+    writeDigits(out + width - lowWidth, low, lowCount, lowWidth, powers, level - 1);
+    free(scratch);
+}
+
+char *bigIntToString(ObjBigInt *bigInt) {
+    if (bigInt->count == 0) {
+        char *zero = malloc(sizeof(char) * 2);
+        memcpy(zero, "0", 2);
+        return zero;
+    }
+
+    // 32 * log10(2) < 9.64 digits per limb.
+    int width = (int) (bigInt->count * 9.64) + 1;
+    int levels = 1;
+    while ((DECIMAL_DIGITS << levels) < width) {
+        levels++;
+    }
+
+    Power *powers = decimalPowers(levels);
+    uint32_t *limbs = malloc(sizeof(uint32_t) * bigInt->count);
+    memcpy(limbs, bigInt->limbs, sizeof(uint32_t) * bigInt->count);
+
+    char *digits = malloc(sizeof(char) * (width + 2));
+    writeDigits(digits + 1, limbs, bigInt->count, width, powers, levels - 1);
+    digits[width + 1] = '\0';
+
+    free(limbs);
+    freeDecimalPowers(powers, levels);
+
+    // Strip the zero padding, then prefix the sign.
+    char *start = digits + 1;
+    while (*start == '0' && start[1] != '\0') {
+        start++;
+    }
+
+    if (bigInt->sign < 0) {
+        *--start = '-';
+    }
+
+    int length = (int) strlen(start);
+    memmove(digits, start, length + 1);
+    return digits;
+}
+
+// Parses count digits, result holds count / 9 + 4 limbs.
+static int readDigits(uint32_t *result, const char *digits, int count, Power *powers, int level) {
+    if (level < 0 || count <= DECIMAL_DIGITS * BIGINT_CONVERSION_THRESHOLD) {
+        int resultCount = 0;
+
+        for (int i = 0; i < count;) {
+            uint32_t chunk = 0;
+            uint32_t scale = 1;
+
+            for (int j = 0; j < DECIMAL_DIGITS && i < count; ++j, ++i) {
+                chunk = chunk * 10 + (digits[i] - '0');
+                scale *= 10;
+            }
+
+            resultCount = magMulAddLimb(result, resultCount, scale, chunk);
+        }
+
+        return resultCount;
+    }
+
+    int lowWidth = DECIMAL_DIGITS << level;
+    if (count <= lowWidth) {
+        return readDigits(result, digits, count, powers, level - 1);
+    }
+
+    Power *power = &powers[level];
+    int highDigits = count - lowWidth;
+
+    uint32_t *high = malloc(sizeof(uint32_t) * (highDigits / DECIMAL_DIGITS + 4));
+    uint32_t *low = malloc(sizeof(uint32_t) * (lowWidth / DECIMAL_DIGITS + 4));
+    int highCount = readDigits(high, digits, highDigits, powers, level - 1);
+    int lowCount = readDigits(low, digits + highDigits, lowWidth, powers, level - 1);
+
+    // result = high * 10^lowWidth + low
+    int resultCount = highCount + power->count;
+    if (highCount > 0) {
+        magMul(result, high, highCount, power->limbs, power->count);
+    } else {
+        memset(result, 0, sizeof(uint32_t) * resultCount);
+    }
+
+    memset(result + resultCount, 0, sizeof(uint32_t) * 1);
+    magAddInto(result, resultCount + 1, low, lowCount);
+
+    free(high);
+    free(low);
+    return magNormalize(result, resultCount + 1);
+}
+
+static ObjBigInt *parseBigInt(DictuVM *vm, const char *string, int length) {
+    int sign = 1;
+    int start = 0;
+
+    if (length > 0 && (string[0] == '-' || string[0] == '+')) {
+        sign = string[0] == '-' ? -1 : 1;
+        start = 1;
+    }
+
+    if (start == length) {
+        return NULL;
+    }
+
+    for (int i = start; i < length; ++i) {
+        if (string[i] < '0' || string[i] > '9') {
+            return NULL;
+        }
+    }
+
+    int count = length - start;
+    int levels = 1;
+    while ((DECIMAL_DIGITS << levels) < count) {
+        levels++;
+    }
+
+    Power *powers = decimalPowers(levels);
+    uint32_t *limbs = malloc(sizeof(uint32_t) * (count / DECIMAL_DIGITS + 4));
+    int limbCount = readDigits(limbs, string + start, count, powers, levels - 1);
+    freeDecimalPowers(powers, levels);
+
+    ObjBigInt *bigInt = newBigInt(vm, sign, limbs, limbCount);
+    free(limbs);
+
+    return bigInt;
+}
+
+static Value toStringBigInt(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "toString() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    char *string = bigIntToString(AS_BIGINT(args[0]));
+    ObjString *result = copyString(vm, string, strlen(string));
+    free(string);
+
+    return OBJ_VAL(result);
+}
+
+static Value toNumberBigInt(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "toNumber() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    ObjBigInt *bigInt = AS_BIGINT(args[0]);
+
+    if (bigInt->count <= 2) {
+        uint64_t magnitude = bigInt->count == 0 ? 0 : bigInt->limbs[0];
+        if (bigInt->count == 2) {
+            magnitude |= (uint64_t) bigInt->limbs[1] << LIMB_BITS;
+        }
+
+        if (magnitude <= INT48_MAX) {
+            return INT_VAL(bigInt->sign * (int64_t) magnitude);
+        }
+    }
+
+    return NUMBER_VAL(bigNumToDouble(bigInt->sign, bigInt->limbs, bigInt->count));
+}
+
+static Value powBigInt(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 1) {
+        runtimeError(vm, "pow() takes 1 argument (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    BigNum base, exponent;
+    toBigNum(args[0], &base);
+
+    if (!toBigNum(args[1], &exponent)) {
+        runtimeError(vm, "pow() argument must be an integer");
+        return EMPTY_VAL;
+    }
+
+    uint64_t value;
+    if (!exponentValue(vm, &exponent, &value)) {
+        return EMPTY_VAL;
+    }
+
+    ObjBigInt *power = powBigNum(vm, &base, value);
+    if (power == NULL) {
+        return EMPTY_VAL;
+    }
+
+    return OBJ_VAL(power);
+}
+
+// result = a * b mod m, result holds m->count limbs.
+static int mulMod(uint32_t *result, uint32_t *scratch, const uint32_t *a, int aCount,
+                  const uint32_t *b, int bCount, BigNum *modulus) {
+    if (aCount == 0 || bCount == 0) {
+        return 0;
+    }
+
+    int count;
+    magMul(scratch, a, aCount, b, bCount);
+    magDivMod(scratch, magNormalize(scratch, aCount + bCount), modulus->limbs, modulus->count,
+              NULL, NULL, result, &count);
+
+    return count;
+}
+
+static Value modPowBigInt(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 2) {
+        runtimeError(vm, "modPow() takes 2 arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    BigNum base, exponent, modulus;
+    toBigNum(args[0], &base);
+
+    if (!toBigNum(args[1], &exponent) || !toBigNum(args[2], &modulus)) {
+        runtimeError(vm, "modPow() arguments must be integers");
+        return EMPTY_VAL;
+    }
+
+    if (exponent.sign < 0) {
+        runtimeError(vm, "modPow() exponent must not be negative");
+        return EMPTY_VAL;
+    }
+
+    if (modulus.sign <= 0) {
+        runtimeError(vm, "modPow() modulus must be positive");
+        return EMPTY_VAL;
+    }
+
+    int size = modulus.count;
+    uint32_t *scratch = malloc(sizeof(uint32_t) * (size * 4 + base.count + 1));
+    uint32_t *result = scratch;
+    uint32_t *square = scratch + size;
+    uint32_t *product = scratch + size * 2;
+    int resultCount, squareCount;
+
+    // Reduce the base first, a negative base is taken mod m as well.
+    magDivMod(base.limbs, base.count, modulus.limbs, modulus.count, NULL, NULL, square, &squareCount);
+    if (base.sign < 0 && squareCount > 0) {
+        squareCount = magSub(square, modulus.limbs, modulus.count, square, squareCount);
+    }
+
+    result[0] = 1;
+    resultCount = magCompare(result, 1, modulus.limbs, modulus.count) < 0;
+
+    // Right to left binary exponentiation over the exponent bits.
+    for (int i = 0; i < exponent.count; ++i) {
+        uint32_t limb = exponent.limbs[i];
+
+        for (int bit = 0; bit < LIMB_BITS; ++bit) {
+            if (i == exponent.count - 1 && (limb >> bit) == 0) {
+                break;
+            }
+
+            if ((limb >> bit) & 1) {
+                resultCount = mulMod(result, product, result, resultCount, square, squareCount, &modulus);
+            }
+
+            squareCount = mulMod(square, product, square, squareCount, square, squareCount, &modulus);
+        }
+    }
+
+    ObjBigInt *bigInt = newBigInt(vm, 1, result, resultCount);
+    free(scratch);
+
+    return OBJ_VAL(bigInt);
+}
+
+static Value absBigInt(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "abs() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    ObjBigInt *bigInt = AS_BIGINT(args[0]);
+    if (bigInt->sign >= 0) {
+        return args[0];
+    }
+
+    return OBJ_VAL(newBigInt(vm, 1, bigInt->limbs, bigInt->count));
+}
+
+static Value signBigInt(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "sign() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    return INT_VAL(AS_BIGINT(args[0])->sign);
+}
+
+static Value bitLengthBigInt(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "bitLength() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    ObjBigInt *bigInt = AS_BIGINT(args[0]);
+    if (bigInt->count == 0) {
+        return INT_VAL(0);
+    }
+
+    return INT_VAL((int64_t) bigInt->count * LIMB_BITS - leadingZeros(bigInt->limbs[bigInt->count - 1]));
+}
+
+void declareBigIntMethods(DictuVM *vm) {
+    defineNative(vm, &vm->bigIntMethods, "toString", toStringBigInt);
+    defineNative(vm, &vm->bigIntMethods, "toNumber", toNumberBigInt);
+    defineNative(vm, &vm->bigIntMethods, "pow", powBigInt);
+    defineNative(vm, &vm->bigIntMethods, "modPow", modPowBigInt);
+    defineNative(vm, &vm->bigIntMethods, "abs", absBigInt);
+    defineNative(vm, &vm->bigIntMethods, "sign", signBigInt);
+    defineNative(vm, &vm->bigIntMethods, "bitLength", bitLengthBigInt);
+    defineNative(vm, &vm->bigIntMethods, "toBool", boolNative); // Defined in util
+}
+
+static Value newBigIntNative(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 1) {
+        runtimeError(vm, "new() takes 1 argument (%d given).", argCount);
+        return EMPTY_VAL;
+    }
+
+    if (IS_BIGINT(args[0])) {
+        return args[0];
+    }
+
+    if (IS_STRING(args[0])) {
+        ObjString *string = AS_STRING(args[0]);
+        ObjBigInt *bigInt = parseBigInt(vm, string->chars, string->length);
+
+        if (bigInt == NULL) {
+            runtimeError(vm, "Invalid BigInt literal '%s'.", string->chars);
+            return EMPTY_VAL;
+        }
+
+        return OBJ_VAL(bigInt);
+    }
+
+    BigNum number;
+    if (!IS_NUMBER(args[0]) || !numberToBigNum(args[0], &number)) {
+        runtimeError(vm, "new() argument must be an integer or a string of digits.");
+        return EMPTY_VAL;
+    }
+
+    return OBJ_VAL(newBigInt(vm, number.sign, number.limbs, number.count));
+}
+
+Value createBigIntModule(DictuVM *vm) {
+    ObjString *name = copyString(vm, "BigInt", 6);
+    push(vm, OBJ_VAL(name));
+    ObjModule *module = newModule(vm, name);
+    push(vm, OBJ_VAL(module));
+
+    /**
+     * Define BigInt methods
+     */
+    defineNative(vm, &module->values, "new", newBigIntNative);
+    pop(vm);
+    pop(vm);
+
+    return OBJ_VAL(module);
+}
@@ -0,0 +1,32 @@
+#ifndef oolong_bigint_h
+#define oolong_bigint_h
+
+#include "optionals.h"
+#include "vm.h"
+
+// Operand count above which multiplication switches from schoolbook
+// to Karatsuba.
+#define BIGINT_KARATSUBA_THRESHOLD 32
+
+// Limb count above which base conversion splits the number in halves.
+#define BIGINT_CONVERSION_THRESHOLD 32
+
+// Applies an arithmetic or comparison opcode to the two values on top
+// of the stack where at least one of them is a BigInt. The operands are
+// replaced by the result, false is returned after a runtime error.
+bool bigIntOperator(DictuVM *vm, OpCode op);
+
+void bigIntNegate(DictuVM *vm);
+
+bool bigIntEqualsNumber(ObjBigInt *bigInt, Value number);
+
+// Sets number to the double equal to bigInt, false if there isn't one.
+bool bigIntToExactNumber(ObjBigInt *bigInt, double *number);
+
+char *bigIntToString(ObjBigInt *bigInt);
+
+void declareBigIntMethods(DictuVM *vm);
+
+Value createBigIntModule(DictuVM *vm);
+
+#endif //dictu_bigint_h
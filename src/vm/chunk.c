@@ -11,12 +11,16 @@ void initChunk(DictuVM *vm, Chunk *chunk) {
   chunk->capacity = 0;
   chunk->code = NULL;
   chunk->lines = NULL;
+  chunk->fieldCache = NULL;
   initValueArray(&chunk->constants);
 }
 
 void freeChunk(DictuVM *vm, Chunk *chunk) {
   FREE_ARRAY(vm, uint8_t, chunk->code, chunk->capacity);
   FREE_ARRAY(vm, int, chunk->lines, chunk->capacity);
+  if (chunk->fieldCache != NULL) {
+    FREE_ARRAY(vm, uint8_t, chunk->fieldCache, chunk->capacity);
+  }
   freeValueArray(vm, &chunk->constants);
   initChunk(vm, chunk);
 }
@@ -24,11 +28,12 @@ void freeChunk(DictuVM *vm, Chunk *chunk) {
 void writeChunk(DictuVM *vm, Chunk *chunk, uint8_t byte, int line) {
   if (chunk->capacity < chunk->count + 1) {
     int oldCapacity = chunk->capacity;
-    chunk->capacity = GROW_CAPACITY(oldCapacity);
+    int capacity = GROW_CAPACITY(oldCapacity);
     chunk->code = GROW_ARRAY(vm, chunk->code, uint8_t,
-			    oldCapacity, chunk->capacity);
+			    oldCapacity, capacity);
     chunk->lines = GROW_ARRAY(vm, chunk->lines, int,
-			     oldCapacity, chunk->capacity);
+			     oldCapacity, capacity);
+    chunk->capacity = capacity;
   }
 
   chunk->code[chunk->count] = byte;
@@ -10,6 +10,10 @@ typedef struct {
   uint8_t *code;
   int *lines;
   ValueArray constants;
+
+  // One byte per code byte for the property accesses on typed abstracts,
+  // allocated on the first one, see findField in abstracts.c.
+  uint8_t *fieldCache;
 } Chunk;
 
 typedef enum {
@@ -18,6 +22,17 @@ typedef enum {
 #undef OPCODE
 } OpCode;
 
+// Comparison performed by OP_FOR_PREP / OP_FOR_LOOP. FOR_RANGE picks
+// the direction from the sign of the step, the others mirror the
+// condition of a recognised C-style loop.
+typedef enum {
+  FOR_RANGE,
+  FOR_LESS,
+  FOR_LESS_EQUAL,
+  FOR_GREATER,
+  FOR_GREATER_EQUAL
+} ForLoopMode;
+
 void initChunk(DictuVM *vm, Chunk *chunk);
 
 void freeChunk(DictuVM *vm, Chunk *chunk);
@@ -53,6 +53,10 @@ return newResultError(vm, buf);  \
 #define COMPUTED_GOTO
 #endif
 
+// Keeps the top of the stack in a register in run(), build with
+// -DTOS_CACHE to compare against the plain loop.
+//#define TOS_CACHE
+
 //#undef DEBUG_PRINT_CODE
 //#undef DEBUG_TRACE_EXECUTION
 #undef DEBUG_TRACE_GC
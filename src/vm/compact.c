@@ -0,0 +1,255 @@
+#include "compact.h"
+#include "abstracts.h"
+#include "compiler.h"
+#include "vm.h"
+#include "weak.h"
+
+static inline void *forward(void *object) {
+    return object == NULL ? NULL : heapForward(object);
+}
+
+static void forwardValue(Value *value) {
+    if (IS_OBJ(*value)) {
+        *value = OBJ_VAL(heapForward(AS_OBJ(*value)));
+    }
+}
+
+static void forwardArray(ValueArray *array) {
+    for (int i = 0; i < array->count; i++) {
+        forwardValue(&array->values[i]);
+    }
+}
+
+static void forwardEntries(Entry *entries, int capacityMask) {
+    for (int i = 0; i <= capacityMask; i++) {
+        Entry *entry = &entries[i];
+        entry->key = forward(entry->key);
+        forwardValue(&entry->value);
+    }
+}
+
+static void forwardTable(Table *table) {
+    forwardEntries(table->entries, table->capacityMask);
+
+    TableResize *resize = tableResize(table);
+    if (resize != NULL) {
+        forwardEntries(resize->entries, resize->capacityMask);
+    }
+}
+
+// Follows what blackenObject grays, along with the references it leaves
+// out because they are reachable some other way.
+static void forwardObject(DictuVM *vm, Obj *object) {
+    switch (object->type) {
+        case OBJ_MODULE: {
+            ObjModule *module = (ObjModule *) object;
+            module->name = forward(module->name);
+            module->path = forward(module->path);
+            forwardTable(&module->values);
+            break;
+        }
+
+        case OBJ_BOUND_METHOD: {
+            ObjBoundMethod *bound = (ObjBoundMethod *) object;
+            forwardValue(&bound->receiver);
+            bound->method = forward(bound->method);
+            break;
+        }
+
+        case OBJ_CLASS: {
+            ObjClass *klass = (ObjClass *) object;
+            klass->name = forward(klass->name);
+            klass->superclass = forward(klass->superclass);
+            klass->classAnnotations = forward(klass->classAnnotations);
+            klass->methodAnnotations = forward(klass->methodAnnotations);
+            forwardTable(&klass->publicMethods);
+            forwardTable(&klass->privateMethods);
+            forwardTable(&klass->abstractMethods);
+            forwardTable(&klass->publicProperties);
+            forwardTable(&klass->publicConstantProperties);
+            break;
+        }
+
+        case OBJ_ENUM: {
+            ObjEnum *enumObj = (ObjEnum *) object;
+            enumObj->name = forward(enumObj->name);
+            forwardTable(&enumObj->values);
+            break;
+        }
+
+        case OBJ_CLOSURE: {
+            ObjClosure *closure = (ObjClosure *) object;
+            closure->function = forward(closure->function);
+            for (int i = 0; i < closure->upvalueCount; i++) {
+                closure->upvalues[i] = forward(closure->upvalues[i]);
+            }
+            break;
+        }
+
+        case OBJ_FUNCTION: {
+            ObjFunction *function = (ObjFunction *) object;
+            function->name = forward(function->name);
+            function->module = forward(function->module);
+            forwardArray(&function->chunk.constants);
+            break;
+        }
+
+        case OBJ_INSTANCE: {
+            ObjInstance *instance = (ObjInstance *) object;
+            instance->klass = forward(instance->klass);
+            forwardTable(&instance->publicFields);
+            forwardTable(&instance->privateFields);
+            break;
+        }
+
+        case OBJ_UPVALUE: {
+            ObjUpvalue *upvalue = (ObjUpvalue *) object;
+            forwardValue(&upvalue->closed);
+
+            // A closed upvalue points at its own copy of the value, which
+            // may have moved along with it.
+            if (upvalue->value < vm->stack || upvalue->value >= vm->stack + STACK_MAX) {
+                upvalue->value = &upvalue->closed;
+            }
+            break;
+        }
+
+        case OBJ_LIST: {
+            ObjList *list = (ObjList *) object;
+            forwardArray(&list->values);
+            break;
+        }
+
+        case OBJ_DICT: {
+            ObjDict *dict = (ObjDict *) object;
+            for (int i = 0; i <= dict->capacityMask; i++) {
+                forwardValue(&dict->entries[i].key);
+                forwardValue(&dict->entries[i].value);
+            }
+            break;
+        }
+
+        case OBJ_SET: {
+            ObjSet *set = (ObjSet *) object;
+            for (int i = 0; i <= set->capacityMask; i++) {
+                forwardValue(&set->entries[i].value);
+            }
+            break;
+        }
+
+        case OBJ_ABSTRACT: {
+            ObjAbstract *abstract = (ObjAbstract *) object;
+            forwardTable(&abstract->values);
+            break;
+        }
+
+        case OBJ_RESULT: {
+            ObjResult *result = (ObjResult *) object;
+            forwardValue(&result->value);
+            break;
+        }
+
+        case OBJ_STREAM: {
+            ObjStream *stream = (ObjStream *) object;
+            forwardValue(&stream->source);
+            for (int i = 0; i < stream->stageCount; ++i) {
+                forwardValue(&stream->stages[i].value);
+            }
+            break;
+        }
+
+        case OBJ_NATIVE:
+        case OBJ_STRING:
+        case OBJ_FILE:
+        case OBJ_BIGINT:
+            break;
+    }
+}
+
+static void forwardWeakKeys(DictuVM *vm, Entry *entries, int capacityMask) {
+    for (int i = 0; i <= capacityMask; i++) {
+        Entry *entry = &entries[i];
+
+        if (entry->key != NULL) {
+            entry->key = heapForwardWeak(&vm->heap, entry->key);
+        }
+    }
+}
+
+// The roots collectGarbage marks, along with the references the VM
+// keeps to objects reachable from them.
+static void forwardRoots(DictuVM *vm) {
+    for (Value *slot = vm->stack; slot < vm->stackTop; slot++) {
+        forwardValue(slot);
+    }
+
+    for (int i = 0; i < vm->frameCount; i++) {
+        vm->frames[i].closure = forward(vm->frames[i].closure);
+        vm->frames[i].varargs = forward(vm->frames[i].varargs);
+    }
+
+    ObjUpvalue **upvalue = &vm->openUpvalues;
+    while (*upvalue != NULL) {
+        *upvalue = forward(*upvalue);
+        upvalue = &(*upvalue)->next;
+    }
+
+    forwardTable(&vm->modules);
+    forwardTable(&vm->globals);
+    forwardTable(&vm->strings);
+    forwardTable(&vm->numberMethods);
+    forwardTable(&vm->boolMethods);
+    forwardTable(&vm->nilMethods);
+    forwardTable(&vm->stringMethods);
+    forwardTable(&vm->listMethods);
+    forwardTable(&vm->dictMethods);
+    forwardTable(&vm->setMethods);
+    forwardTable(&vm->fileMethods);
+    forwardTable(&vm->classMethods);
+    forwardTable(&vm->instanceMethods);
+    forwardTable(&vm->resultMethods);
+    forwardTable(&vm->streamMethods);
+    forwardTable(&vm->bigIntMethods);
+
+    // Names of constants are not marked, some may have been freed.
+    forwardWeakKeys(vm, vm->constants.entries, vm->constants.capacityMask);
+    TableResize *resize = tableResize(&vm->constants);
+    if (resize != NULL) {
+        forwardWeakKeys(vm, resize->entries, resize->capacityMask);
+    }
+
+    vm->initString = forward(vm->initString);
+    vm->annotationString = forward(vm->annotationString);
+    vm->hasNextString = forward(vm->hasNextString);
+    vm->nextString = forward(vm->nextString);
+    vm->replVar = forward(vm->replVar);
+    vm->lastModule = forward(vm->lastModule);
+    vm->mathModule = forward(vm->mathModule);
+    forwardValue(&vm->callResult);
+
+    for (int i = 0; i < vm->varargsPoolCount; ++i) {
+        vm->varargsPool[i] = forward(vm->varargsPool[i]);
+    }
+
+    for (DictuHandle *handle = vm->handles; handle != NULL; handle = handle->next) {
+        forwardValue(&handle->value);
+    }
+
+    for (AbstractType *type = vm->abstractTypes; type != NULL; type = type->next) {
+        forwardTable(&type->methods);
+
+        if (type->fieldNames == NULL) {
+            continue;
+        }
+
+        for (int i = 0; i < type->descriptor->fieldCount; ++i) {
+            type->fieldNames[i] = forward(type->fieldNames[i]);
+        }
+    }
+}
+
+void forwardReferences(DictuVM *vm) {
+    forwardRoots(vm);
+    heapVisitObjects(vm, forwardObject);
+    forwardWeakReferences(vm);
+}
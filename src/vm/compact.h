@@ -0,0 +1,27 @@
+#ifndef oolong_compact_h
+#define oolong_compact_h
+
+#include "dictu_include.h"
+#include "common.h"
+
+/*
+ * Pages left sparse after a peak in allocation are only reused by
+ * objects of their own size class, and the memory of the process stays
+ * at its peak. A collection that finds more of the heap's pages free
+ * than the next cycle will fill asks for a compaction, which marks the
+ * heap again, moves the surviving objects of the sparsest pages into
+ * the free slots of the others and gives the emptied pages back to the
+ * system.
+ *
+ * Native code holds objects in C locals the collector cannot see, so
+ * objects are only moved at a back edge of the outermost run(), where
+ * every reference is in the VM's own state and is rewritten in place.
+ */
+
+// Free pages below which a compaction is not worth its pause.
+#define GC_COMPACT_MIN (1024 * 1024)
+
+// Rewrites every reference to an object moved out of an evacuated page.
+void forwardReferences(DictuVM *vm);
+
+#endif
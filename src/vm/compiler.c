@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +9,7 @@
 #include "vm.h"
 #include "error.h"
 #include "optionals.h"
+#include "aot.h"
 
 #ifdef DEBUG_PRINT_CODE
 
@@ -154,6 +156,153 @@ static void patchJump(Compiler *compiler, int offset) {
   currentChunk(compiler)->code[offset + 1] = jump & 0xff;
 }
 
+static void clearType(Compiler *compiler) {
+  compiler->lastType.numeric = false;
+  compiler->lastType.depends = 0;
+}
+
+static void addTypedSite(Compiler *compiler, int offset, int slot, uint64_t depends) {
+  if (compiler->typedSiteCapacity < compiler->typedSiteCount + 1) {
+    int oldCapacity = compiler->typedSiteCapacity;
+    int capacity = GROW_CAPACITY(oldCapacity);
+    compiler->typedSites = GROW_ARRAY(compiler->parser->vm, compiler->typedSites, TypedSite,
+				      oldCapacity, capacity);
+    compiler->typedSiteCapacity = capacity;
+  }
+
+  TypedSite *site = &compiler->typedSites[compiler->typedSiteCount++];
+  site->offset = offset;
+  site->slot = slot;
+  site->depends = depends;
+}
+
+static uint8_t uncheckedOp(uint8_t op) {
+  switch (op) {
+  case OP_ADD: return OP_ADD_NN;
+  case OP_SUBTRACT: return OP_SUBTRACT_NN;
+  case OP_MULTIPLY: return OP_MULTIPLY_NN;
+  case OP_DIVIDE: return OP_DIVIDE_NN;
+  case OP_LESS: return OP_LESS_NN;
+  case OP_GREATER: return OP_GREATER_NN;
+  default: return op;
+  }
+}
+
+static uint8_t checkedOp(uint8_t op) {
+  switch (op) {
+  case OP_ADD_NN: return OP_ADD;
+  case OP_SUBTRACT_NN: return OP_SUBTRACT;
+  case OP_MULTIPLY_NN: return OP_MULTIPLY;
+  case OP_DIVIDE_NN: return OP_DIVIDE;
+  case OP_LESS_NN: return OP_LESS;
+  case OP_GREATER_NN: return OP_GREATER;
+  default: return op;
+  }
+}
+
+// Emits a binary operator whose left operand had type left and whose
+// right operand was compiled last. Operands known to be numbers get the
+// unchecked form of the instruction.
+static void emitOperator(Compiler *compiler, uint8_t op, ExprType left) {
+  ExprType right = compiler->lastType;
+  bool numeric = left.numeric && right.numeric;
+  uint64_t depends = left.depends | right.depends;
+
+  if (numeric && uncheckedOp(op) != op) {
+    if (depends != 0) {
+      addTypedSite(compiler, currentChunk(compiler)->count, -1, depends);
+    }
+
+    emitByte(compiler, uncheckedOp(op));
+  } else {
+    emitByte(compiler, op);
+  }
+
+  switch (op) {
+  case OP_ADD:
+  case OP_SUBTRACT:
+  case OP_MULTIPLY:
+  case OP_DIVIDE:
+  case OP_MOD:
+  case OP_POW:
+    compiler->lastType.numeric = numeric;
+    compiler->lastType.depends = numeric ? depends : 0;
+    break;
+
+  // These raise an error for anything but numbers.
+  case OP_BITWISE_AND:
+  case OP_BITWISE_XOR:
+  case OP_BITWISE_OR:
+  case OP_SHIFT_LEFT:
+  case OP_SHIFT_RIGHT:
+    compiler->lastType.numeric = true;
+    compiler->lastType.depends = 0;
+    break;
+
+  default:
+    clearType(compiler);
+    break;
+  }
+}
+
+// Emits a store of the value compiled last. A local that is assigned
+// anything but a number is dirty for the rest of the function.
+static void emitSetVariable(Compiler *compiler, uint8_t setOp, int arg) {
+  emitBytes(compiler, setOp, (uint8_t) arg);
+
+  if (setOp != OP_SET_LOCAL) {
+    return;
+  }
+
+  if (!compiler->lastType.numeric) {
+    compiler->dirtyLocals |= NUMERIC_LOCAL(arg);
+  } else if (compiler->lastType.depends != 0) {
+    addTypedSite(compiler, -1, arg, compiler->lastType.depends);
+  }
+}
+
+// Numeric inference assumes every local it read as a number keeps
+// holding one. Slots assigned anything else are dirty, that spreads
+// through the numeric assignments reading them, and each unchecked
+// instruction relying on a dirty slot is put back to its checked form.
+static void downgradeTypedSites(Compiler *compiler) {
+  uint64_t dirty = compiler->dirtyLocals;
+  bool changed = true;
+
+  while (changed) {
+    changed = false;
+
+    for (int i = 0; i < compiler->typedSiteCount; ++i) {
+      TypedSite *site = &compiler->typedSites[i];
+
+      if (site->offset != -1 || !(site->depends & dirty)) {
+	continue;
+      }
+
+      uint64_t slot = NUMERIC_LOCAL(site->slot);
+
+      if (!(dirty & slot)) {
+	dirty |= slot;
+	changed = true;
+      }
+    }
+  }
+
+  Chunk *chunk = currentChunk(compiler);
+  for (int i = 0; i < compiler->typedSiteCount; ++i) {
+    TypedSite *site = &compiler->typedSites[i];
+
+    if (site->offset != -1 && (site->depends & dirty)) {
+      chunk->code[site->offset] = checkedOp(chunk->code[site->offset]);
+    }
+  }
+
+  FREE_ARRAY(compiler->parser->vm, TypedSite, compiler->typedSites, compiler->typedSiteCapacity);
+  compiler->typedSites = NULL;
+  compiler->typedSiteCount = 0;
+  compiler->typedSiteCapacity = 0;
+}
+
 static void initCompiler(Parser *parser, Compiler *compiler, Compiler *parent, FunctionType type, AccessLevel level) {
   compiler->parser = parser;
   compiler->enclosing = parent;
@@ -164,6 +313,15 @@ static void initCompiler(Parser *parser, Compiler *compiler, Compiler *parent, F
   compiler->withBlock = false;
   compiler->classAnnotations = NULL;
   compiler->methodAnnotations = NULL;
+  compiler->dirtyLocals = 0;
+  compiler->typedSites = NULL;
+  compiler->typedSiteCount = 0;
+  compiler->typedSiteCapacity = 0;
+  compiler->varargsSlot = -1;
+  compiler->varargsEscapes = false;
+  compiler->varargsReceiver = false;
+  compiler->lastCall = -1;
+  clearType(compiler);
 
   if (parent != NULL) {
     compiler->class = parent->class;
@@ -206,6 +364,7 @@ static void initCompiler(Parser *parser, Compiler *compiler, Compiler *parent, F
   Local *local = &compiler->locals[compiler->localCount++];
   local->depth = compiler->scopeDepth;
   local->isUpvalue = false;
+  local->numeric = false;
   if (type == TYPE_METHOD || type == TYPE_INITIALIZER) {
     // In a method, it holds the receiver, "this".
     local->name.start = "this";
@@ -220,8 +379,11 @@ static void initCompiler(Parser *parser, Compiler *compiler, Compiler *parent, F
 
 static ObjFunction *endCompiler(Compiler *compiler) {
   emitReturn(compiler);
+  downgradeTypedSites(compiler);
 
   ObjFunction *function = compiler->function;
+  function->pooledVarargs = compiler->varargsSlot != -1 && !compiler->varargsEscapes &&
+                            function->arityOptional == 0;
 #ifdef DEBUG_PRINT_CODE
   if (!compiler->parser->hadError) {
 
@@ -277,6 +439,14 @@ static ParseRule *getRule(TokenType type);
 
 static void parsePrecedence(Compiler *compiler, Precedence precedence);
 
+static void parseInfix(Compiler *compiler, Precedence precedence, bool canAssign);
+
+static Token syntheticToken(const char *text);
+
+static bool isShadowed(Compiler *compiler, Token *name);
+
+static bool isContainedListMethod(Token *name);
+
 static uint8_t identifierConstant(Compiler *compiler, Token *name) {
   ObjString *string = copyString(compiler->parser->vm, name->start, name->length);
   Value indexValue;
@@ -345,6 +515,13 @@ static int resolveUpvalue(Compiler *compiler, Token *name) {
         // Mark the local as an upvalue so we know to close it when it goes
         // out of scope.
         compiler->enclosing->locals[local].isUpvalue = true;
+
+        // The closure may assign it anything.
+        compiler->enclosing->dirtyLocals |= NUMERIC_LOCAL(local);
+
+        if (local == compiler->enclosing->varargsSlot) {
+            compiler->enclosing->varargsEscapes = true;
+        }
         return addUpvalue(compiler, (uint8_t) local, true, compiler->enclosing->locals[local].constant);
     }
 
@@ -377,6 +554,7 @@ static void addLocal(Compiler *compiler, Token name) {
   local->depth = -1;
   local->isUpvalue = false;
   local->constant = false;
+  local->numeric = false;
   compiler->localCount++;
 }
 
@@ -430,6 +608,34 @@ static void defineVariable(Compiler *compiler, uint8_t global, bool constant) {
   }
 }
 
+// Compiles the elements of a list literal whose '[' has just been
+// consumed. If the literal is directly followed by terminator the
+// elements are left on the stack and their count is returned, so a
+// literal that is only spread never becomes a list. Otherwise the list
+// is built and the rest of the expression compiled, returning -1.
+static int spreadList(Compiler *compiler, TokenType terminator) {
+  int count = 0;
+
+  do {
+    if (check(compiler, TOKEN_RIGHT_BRACKET))
+      break;
+
+    expression(compiler);
+    count++;
+  } while (match(compiler, TOKEN_COMMA));
+
+  consume(compiler, TOKEN_RIGHT_BRACKET, "Expected closing ']'");
+
+  if (check(compiler, terminator)) {
+    return count;
+  }
+
+  emitBytes(compiler, OP_NEW_LIST, count);
+  clearType(compiler);
+  parseInfix(compiler, PREC_ASSIGNMENT, true);
+  return -1;
+}
+
 static int argumentList(Compiler *compiler, bool *unpack) {
   int argCount = 0;
 
@@ -441,9 +647,21 @@ static int argumentList(Compiler *compiler, bool *unpack) {
 
       if (match(compiler, TOKEN_DOT_DOT_DOT)) {
 	*unpack = true;
+
+	if (match(compiler, TOKEN_LEFT_BRACKET)) {
+	  int count = spreadList(compiler, TOKEN_RIGHT_PAREN);
+
+	  if (count != -1) {
+	    *unpack = false;
+	    argCount += count - 1;
+	  }
+	} else {
+	  expression(compiler);
+	}
+      } else {
+	expression(compiler);
       }
 
-      expression(compiler);
       argCount++;
 
       if (argCount > 255) {
@@ -479,75 +697,55 @@ static void and_(Compiler *compiler, Token previousToken, bool canAssign) {
 }
 
 static bool foldBinary(Compiler *compiler, TokenType operatorType) {
-#define FOLD(operator)							\
-  do {									\
-    Chunk *chunk = currentChunk(compiler);				\
-    uint8_t index = chunk->code[chunk->count - 1];			\
-    uint8_t constant = chunk->code[chunk->count - 3];			\
-    if (chunk->code[chunk->count - 2] != OP_CONSTANT) return false;	\
-    if (chunk->code[chunk->count - 4] != OP_CONSTANT) return false;	\
-    chunk->constants.values[constant] = NUMBER_VAL(			\
-									  AS_NUMBER(chunk->constants.values[constant]) operator \
-									  AS_NUMBER(chunk->constants.values[index]) \
-									  ); \
-    chunk->constants.count--;						\
-    chunk->count -= 2;							\
-    return true;							\
-  } while (false)
-
-#define FOLD_FUNC(func)                                                 \
-  do {                                                                  \
-    Chunk *chunk = currentChunk(compiler);                              \
-    uint8_t index = chunk->code[chunk->count - 1];                        \
-    uint8_t constant = chunk->code[chunk->count - 3];                     \
-    if (chunk->code[chunk->count - 2] != OP_CONSTANT) return false;       \
-    if (chunk->code[chunk->count - 4] != OP_CONSTANT) return false;       \
-    chunk->constants.values[constant] = NUMBER_VAL(                      \
-                                                        func(           \
-                                                              AS_NUMBER(chunk->constants.values[constant]), \
-                                                              AS_NUMBER(chunk->constants.values[index]) \
-                                                              )         \
-                                                        );              \
-    chunk->constants.count--;                                            \
-    chunk->count -= 2;                                                   \
-    return true;                                                        \
-  } while (false)
+  Chunk *chunk = currentChunk(compiler);
+  if (chunk->code[chunk->count - 2] != OP_CONSTANT) return false;
+  if (chunk->code[chunk->count - 4] != OP_CONSTANT) return false;
+
+  uint8_t index = chunk->code[chunk->count - 1];
+  uint8_t constant = chunk->code[chunk->count - 3];
+  Value a = chunk->constants.values[constant];
+  Value b = chunk->constants.values[index];
+
+  if (!IS_NUMBER(a) || !IS_NUMBER(b)) return false;
+
+  // Folding follows the VM, integer operands give an integer result
+  // unless it leaves the small int range.
+  bool integers = IS_INT(a) && IS_INT(b);
+  Value result;
 
   switch (operatorType) {
-  case TOKEN_PLUS: {
-    FOLD(+);
-    return false;
-  }
+  case TOKEN_PLUS:
+    result = integers ? integerToValue(AS_INT(a) + AS_INT(b)) : NUMBER_VAL(AS_NUMBER(a) + AS_NUMBER(b));
+    break;
 
-  case TOKEN_MINUS: {
-    FOLD(-);
-    return false;
-  }
+  case TOKEN_MINUS:
+    result = integers ? integerToValue(AS_INT(a) - AS_INT(b)) : NUMBER_VAL(AS_NUMBER(a) - AS_NUMBER(b));
+    break;
 
-  case TOKEN_STAR: {
-    FOLD(*);
-    return false;
-  }
+  case TOKEN_STAR:
+    result = integers ? multiplyIntegers(AS_INT(a), AS_INT(b)) : NUMBER_VAL(AS_NUMBER(a) * AS_NUMBER(b));
+    break;
 
-  case TOKEN_SLASH: {
-    FOLD(/);
-    return false;
-  }
-  case TOKEN_PERCENT: {
-    FOLD_FUNC(fmod);
-    return false;
-  }
+  case TOKEN_SLASH:
+    result = integers ? divideIntegers(AS_INT(a), AS_INT(b)) : NUMBER_VAL(AS_NUMBER(a) / AS_NUMBER(b));
+    break;
 
-  case TOKEN_STAR_STAR: {
-    FOLD_FUNC(powf);
-    return false;
-  }
-  default: {
+  case TOKEN_PERCENT:
+    result = modNumbers(a, b);
+    break;
+
+  case TOKEN_STAR_STAR:
+    result = powNumbers(a, b);
+    break;
+
+  default:
     return false;
   }
-  }
-#undef FOLD
-#undef FOLD_FUNC
+
+  chunk->constants.values[constant] = result;
+  chunk->constants.count--;
+  chunk->count -= 2;
+  return true;
 }
 
 
@@ -555,6 +753,7 @@ static void binary(Compiler *compiler, Token previousToken, bool canAssign) {
   UNUSED(canAssign);
 
   TokenType operatorType = compiler->parser->previous.type;
+  ExprType left = compiler->lastType;
 
   ParseRule *rule = getRule(operatorType);
   parsePrecedence(compiler, (Precedence) (rule->precedence + 1));
@@ -566,50 +765,69 @@ static void binary(Compiler *compiler, Token previousToken, bool canAssign) {
       (currentToken == TOKEN_NUMBER || currentToken == TOKEN_LEFT_PAREN) &&
       foldBinary(compiler, operatorType)
       ) {
+    compiler->lastType.numeric = true;
+    compiler->lastType.depends = 0;
     return;
   }
 
   switch (operatorType) {
   case TOKEN_BANG_EQUAL:
     emitBytes(compiler, OP_EQUAL, OP_NOT);
+    clearType(compiler);
     break;
   case TOKEN_EQUAL_EQUAL:
     emitByte(compiler, OP_EQUAL);
+    clearType(compiler);
     break;
   case TOKEN_GREATER:
-    emitByte(compiler, OP_GREATER);
+    emitOperator(compiler, OP_GREATER, left);
     break;
   case TOKEN_GREATER_EQUAL:
-    emitBytes(compiler, OP_LESS, OP_NOT);
+    emitOperator(compiler, OP_LESS, left);
+    emitByte(compiler, OP_NOT);
     break;
   case TOKEN_LESS:
-    emitByte(compiler, OP_LESS);
+    emitOperator(compiler, OP_LESS, left);
     break;
   case TOKEN_LESS_EQUAL:
-    emitBytes(compiler, OP_GREATER, OP_NOT);
+    emitOperator(compiler, OP_GREATER, left);
+    emitByte(compiler, OP_NOT);
     break;
   case TOKEN_PLUS:
-    emitByte(compiler, OP_ADD);
+    emitOperator(compiler, OP_ADD, left);
     break;
   case TOKEN_MINUS:
-    emitByte(compiler, OP_SUBTRACT);
+    emitOperator(compiler, OP_SUBTRACT, left);
     break;
   case TOKEN_STAR:
-    emitByte(compiler, OP_MULTIPLY);
+    emitOperator(compiler, OP_MULTIPLY, left);
     break;
   case TOKEN_SLASH:
-    emitByte(compiler, OP_DIVIDE);
+    emitOperator(compiler, OP_DIVIDE, left);
     break;
   case TOKEN_AMPERSAND:
-    emitByte(compiler, OP_BITWISE_AND);
+    emitOperator(compiler, OP_BITWISE_AND, left);
     break;
   case TOKEN_CARET:
-    emitByte(compiler, OP_BITWISE_XOR);
+    emitOperator(compiler, OP_BITWISE_XOR, left);
     break;
   case TOKEN_PIPE:
-    emitByte(compiler, OP_BITWISE_OR);
+    emitOperator(compiler, OP_BITWISE_OR, left);
+    break;
+  case TOKEN_LESS_LESS:
+    emitOperator(compiler, OP_SHIFT_LEFT, left);
+    break;
+  case TOKEN_GREATER_GREATER:
+    emitOperator(compiler, OP_SHIFT_RIGHT, left);
+    break;
+  case TOKEN_PERCENT:
+    emitOperator(compiler, OP_MOD, left);
+    break;
+  case TOKEN_STAR_STAR:
+    emitOperator(compiler, OP_POW, left);
     break;
   default:
+    clearType(compiler);
     return;
   }
 }
@@ -621,10 +839,39 @@ static void call(Compiler *compiler, Token previousToken, bool canAssign) {
 
   int argCount = argumentList(compiler, &unpack);
 
+  compiler->lastCall = currentChunk(compiler)->count;
   emitBytes(compiler, OP_CALL, argCount);
   emitByte(compiler, unpack);
 }
 
+// Builtin method calls with a dedicated instruction. The instruction
+// checks its receiver at runtime and falls back to an ordinary invoke
+// when it is not the builtin, so a rebound name still behaves.
+static bool emitIntrinsic(Compiler *compiler, Token receiver, Token method, uint8_t name, int argCount, bool unpack) {
+  if (unpack) {
+    return false;
+  }
+
+  if (argCount == 0 && method.length == 3 && memcmp(method.start, "len", 3) == 0) {
+    emitBytes(compiler, OP_LEN, name);
+    return true;
+  }
+
+  Token math = syntheticToken("Math");
+  if (argCount == 1 && receiver.type == TOKEN_IDENTIFIER && identifiersEqual(&receiver, &math) &&
+      !isShadowed(compiler, &receiver)) {
+    int function = findMathFunction(method.start, method.length);
+
+    if (function != -1) {
+      emitBytes(compiler, OP_MATH_UNARY, function);
+      emitByte(compiler, name);
+      return true;
+    }
+  }
+
+  return false;
+}
+
 static void dot(Compiler *compiler, Token previousToken, bool canAssign) {
   UNUSED(previousToken);
 
@@ -633,12 +880,22 @@ static void dot(Compiler *compiler, Token previousToken, bool canAssign) {
 
   Token identifier = compiler->parser->previous;
 
+  if (compiler->varargsReceiver) {
+    compiler->varargsReceiver = false;
+
+    if (!check(compiler, TOKEN_LEFT_PAREN) || !isContainedListMethod(&identifier)) {
+      compiler->varargsEscapes = true;
+    }
+  }
+
   if (match(compiler, TOKEN_LEFT_PAREN)) {
     bool unpack = false;
 
     int argCount = argumentList(compiler, &unpack);
     if (compiler->class != NULL && (previousToken.type == TOKEN_THIS || identifiersEqual(&previousToken, &compiler->class->name))) {
       emitBytes(compiler, OP_INVOKE_INTERNAL, argCount);
+    } else if (emitIntrinsic(compiler, previousToken, identifier, name, argCount, unpack)) {
+      return;
     } else {
       emitBytes(compiler, OP_INVOKE, argCount);
     }
@@ -768,6 +1025,7 @@ static void beginFunction(Compiler *compiler, Compiler *fnCompiler, FunctionType
           error(fnCompiler->parser, "spread parameter cannot be used in a class constructor");
         }
         fnCompiler->function->isVariadic = isSpreadParam;
+        fnCompiler->varargsSlot = fnCompiler->localCount - 1;
       }
 
       if (match(fnCompiler, TOKEN_EQUAL)) {
@@ -828,16 +1086,41 @@ static Value parseNumber(Compiler *compiler, bool canAssign) {
   // Terminate the string with a null character.
   *current = '\0';
 
-  // Parse the string.
-  double value = strtod(buffer, NULL);
+  // Literals without a fraction or exponent are integers.
+  Value value;
+  bool hex = buffer[0] == '0' && (buffer[1] == 'x' || buffer[1] == 'X');
+
+  if (hex || strpbrk(buffer, ".eE") == NULL) {
+    errno = 0;
+    long long integer = strtoll(buffer, NULL, hex ? 16 : 10);
+
+    if (errno == 0 && integer >= INT48_MIN && integer <= INT48_MAX) {
+      value = INT_VAL(integer);
+    } else {
+      value = NUMBER_VAL(strtod(buffer, NULL));
+    }
+  } else {
+    value = NUMBER_VAL(strtod(buffer, NULL));
+  }
+
   // Free the malloc'd buffer.
   FREE_ARRAY(compiler->parser->vm, char, buffer, compiler->parser->previous.length + 1);
 
-  return NUMBER_VAL(value);
+  return value;
+}
+
+static Value negateNumber(Value value) {
+  if (IS_INT(value)) {
+    return integerToValue(-AS_INT(value));
+  }
+
+  return NUMBER_VAL(-AS_NUMBER(value));
 }
 
 static void number(Compiler *compiler, bool canAssign) {
   emitConstant(compiler, parseNumber(compiler, canAssign));
+  compiler->lastType.numeric = true;
+  compiler->lastType.depends = 0;
 }
 
 static void or_(Compiler *compiler, Token previousToken, bool canAssign) {
@@ -1049,6 +1332,38 @@ static void checkConst(Compiler *compiler, uint8_t setOp, int arg) {
   }
 }
 
+// Called for every use of the variadic parameter, anything other than
+// a subscript or a method call on it lets the list escape the call.
+static void noteVarargsUse(Compiler *compiler) {
+  if (check(compiler, TOKEN_LEFT_BRACKET)) {
+    return;
+  }
+
+  if (check(compiler, TOKEN_DOT)) {
+    compiler->varargsReceiver = true;
+    return;
+  }
+
+  compiler->varargsEscapes = true;
+}
+
+// List methods which don't keep hold of the list they are called on.
+static bool isContainedListMethod(Token *name) {
+  static const char *methods[] = {
+    "len", "contains", "join", "copy", "deepCopy", "toString", "toBool",
+    "push", "pop", "insert", "remove", "extend", "sort", "reverse"
+  };
+
+  for (int i = 0; i < (int) (sizeof(methods) / sizeof(methods[0])); ++i) {
+    if ((int) strlen(methods[i]) == name->length &&
+        memcmp(methods[i], name->start, name->length) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 static void namedVariable(Compiler *compiler, Token name, bool canAssign) {
   uint8_t getOp, setOp;
   int arg = resolveLocal(compiler, &name, false);
@@ -1072,54 +1387,72 @@ static void namedVariable(Compiler *compiler, Token name, bool canAssign) {
     }
   }
 
+  if (getOp == OP_GET_LOCAL && arg == compiler->varargsSlot) {
+    noteVarargsUse(compiler);
+  }
+
   if (canAssign && match(compiler, TOKEN_EQUAL)) {
     checkConst(compiler, setOp, arg);
     expression(compiler);
-    emitBytes(compiler, setOp, (uint8_t) arg);
+    emitSetVariable(compiler, setOp, arg);
   } else if (canAssign && match(compiler, TOKEN_PLUS_EQUALS)) {
     checkConst(compiler, setOp, arg);
     namedVariable(compiler, name, false);
+    ExprType left = compiler->lastType;
     expression(compiler);
-    emitByte(compiler, OP_ADD);
-    emitBytes(compiler, setOp, (uint8_t) arg);
+    emitOperator(compiler, OP_ADD, left);
+    emitSetVariable(compiler, setOp, arg);
   } else if (canAssign && match(compiler, TOKEN_MINUS_EQUALS)) {
     checkConst(compiler, setOp, arg);
     namedVariable(compiler, name, false);
+    ExprType left = compiler->lastType;
     expression(compiler);
-    emitByte(compiler, OP_SUBTRACT);
-    emitBytes(compiler, setOp, (uint8_t) arg);
+    emitOperator(compiler, OP_SUBTRACT, left);
+    emitSetVariable(compiler, setOp, arg);
   } else if (canAssign && match(compiler, TOKEN_MULTIPLY_EQUALS)) {
     checkConst(compiler, setOp, arg);
     namedVariable(compiler, name, false);
+    ExprType left = compiler->lastType;
     expression(compiler);
-    emitByte(compiler, OP_MULTIPLY);
-    emitBytes(compiler, setOp, (uint8_t) arg);
+    emitOperator(compiler, OP_MULTIPLY, left);
+    emitSetVariable(compiler, setOp, arg);
   } else if (canAssign && match(compiler, TOKEN_DIVIDE_EQUALS)) {
     checkConst(compiler, setOp, arg);
     namedVariable(compiler, name, false);
+    ExprType left = compiler->lastType;
     expression(compiler);
-    emitByte(compiler, OP_DIVIDE);
-    emitBytes(compiler, setOp, (uint8_t) arg);
+    emitOperator(compiler, OP_DIVIDE, left);
+    emitSetVariable(compiler, setOp, arg);
   } else if (canAssign && match(compiler, TOKEN_AMPERSAND_EQUALS)) {
     checkConst(compiler, setOp, arg);
     namedVariable(compiler, name, false);
+    ExprType left = compiler->lastType;
     expression(compiler);
-    emitByte(compiler, OP_BITWISE_AND);
-    emitBytes(compiler, setOp, (uint8_t) arg);
+    emitOperator(compiler, OP_BITWISE_AND, left);
+    emitSetVariable(compiler, setOp, arg);
   } else if (canAssign && match(compiler, TOKEN_CARET_EQUALS)) {
     checkConst(compiler, setOp, arg);
     namedVariable(compiler, name, false);
+    ExprType left = compiler->lastType;
     expression(compiler);
-    emitByte(compiler, OP_BITWISE_XOR);
-    emitBytes(compiler, setOp, (uint8_t) arg);
+    emitOperator(compiler, OP_BITWISE_XOR, left);
+    emitSetVariable(compiler, setOp, arg);
   } else if (canAssign && match(compiler, TOKEN_PIPE_EQUALS)) {
     checkConst(compiler, setOp, arg);
     namedVariable(compiler, name, false);
+    ExprType left = compiler->lastType;
     expression(compiler);
-    emitByte(compiler, OP_BITWISE_OR);
-    emitBytes(compiler, setOp, (uint8_t) arg);
+    emitOperator(compiler, OP_BITWISE_OR, left);
+    emitSetVariable(compiler, setOp, arg);
   } else {
     emitBytes(compiler, getOp, (uint8_t) arg);
+    clearType(compiler);
+
+    if (getOp == OP_GET_LOCAL && compiler->locals[arg].numeric &&
+	!(compiler->dirtyLocals & NUMERIC_LOCAL(arg))) {
+      compiler->lastType.numeric = NUMERIC_LOCAL(arg) != 0;
+      compiler->lastType.depends = NUMERIC_LOCAL(arg);
+    }
   }
 }
 
@@ -1202,7 +1535,7 @@ static bool foldUnary(Compiler *compiler, TokenType operatorType) {
     if (valueToken == TOKEN_NUMBER) {
       Chunk *chunk = currentChunk(compiler);
       uint8_t constant = chunk->code[chunk->count - 1];
-      chunk->constants.values[constant] = NUMBER_VAL(-AS_NUMBER(chunk->constants.values[constant]));
+      chunk->constants.values[constant] = negateNumber(chunk->constants.values[constant]);
       return true;
     }
 
@@ -1224,17 +1557,24 @@ static void unary(Compiler *compiler, bool canAssign) {
 
   // Constant fold.
   if (foldUnary(compiler, operatorType)) {
+    if (operatorType == TOKEN_NOT) {
+      clearType(compiler);
+    }
+
     return;
   }
 
   switch (operatorType) {
   case TOKEN_NOT:
     emitByte(compiler, OP_NOT);
+    clearType(compiler);
     break;
   case TOKEN_MINUS:
+    // Negation keeps the operand type.
     emitByte(compiler, OP_NEGATE);
     break;
   default:
+    clearType(compiler);
     return;
   }
 }
@@ -1360,6 +1700,11 @@ ParseRule rules[] = {
   [TOKEN_FROM]          = {NULL,     NULL,   PREC_NONE},
   [TOKEN_PERCENT]       = {NULL,     binary, PREC_FACTOR},
   [TOKEN_STAR_STAR]     = {NULL,     binary, PREC_INDICES},
+  [TOKEN_AMPERSAND]     = {NULL,     binary, PREC_BITWISE_AND},
+  [TOKEN_CARET]         = {NULL,     binary, PREC_BITWISE_XOR},
+  [TOKEN_PIPE]          = {NULL,     binary, PREC_BITWISE_OR},
+  [TOKEN_LESS_LESS]     = {NULL,     binary, PREC_SHIFT},
+  [TOKEN_GREATER_GREATER] = {NULL,   binary, PREC_SHIFT},
   [TOKEN_LEFT_BRACKET]  = {list,     subscript, PREC_CALL},
   [TOKEN_RIGHT_BRACKET] = {NULL,     NULL,      PREC_NONE},
   [TOKEN_COLON]         = {NULL,     NULL,      PREC_NONE},
@@ -1378,11 +1723,30 @@ static void parsePrecedence(Compiler *compiler, Precedence precedence) {
   bool canAssign = precedence <= PREC_ASSIGNMENT;
   prefixRule(compiler, canAssign);
 
+  // Only these rules track the type of what they compile, anything
+  // else may have left the type of a subexpression behind.
+  if (prefixRule != number && prefixRule != variable &&
+      prefixRule != grouping && prefixRule != unary) {
+    clearType(compiler);
+  }
+
+  parseInfix(compiler, precedence, canAssign);
+}
+
+// Compiles the infix operators following an operand that has already
+// been compiled.
+static void parseInfix(Compiler *compiler, Precedence precedence, bool canAssign) {
+  Parser *parser = compiler->parser;
+
   while (precedence <= getRule(parser->current.type)->precedence) {
     Token token = compiler->parser->previous;
     advance(parser);
     ParseInfixFn infixRule = getRule(parser->previous.type)->infix;
     infixRule(compiler, token, canAssign);
+
+    if (infixRule != binary) {
+      clearType(compiler);
+    }
   }
 
   if (canAssign && match(compiler, TOKEN_EQUAL)) {
@@ -1540,6 +1904,28 @@ static void funDeclaration(Compiler *compiler) {
   defineVariable(compiler, global, false);
 }
 
+// Compiles the value of a list destructure, leaving varCount values on
+// the stack. A list literal on the right is never built.
+static void unpackExpression(Compiler *compiler, int varCount) {
+  if (match(compiler, TOKEN_LEFT_BRACKET)) {
+    int count = spreadList(compiler, TOKEN_SEMICOLON);
+
+    if (count > varCount) {
+      error(compiler->parser, "Too many values to unpack");
+    } else if (count != -1 && count < varCount) {
+      error(compiler->parser, "Not enough values to unpack");
+    }
+
+    if (count != -1) {
+      return;
+    }
+  } else {
+    expression(compiler);
+  }
+
+  emitBytes(compiler, OP_UNPACK_LIST, varCount);
+}
+
 static void varDeclaration(Compiler *compiler, bool constant) {
   if (match(compiler, TOKEN_LEFT_BRACKET)) {
     Token variables[255];
@@ -1554,9 +1940,7 @@ static void varDeclaration(Compiler *compiler, bool constant) {
     consume(compiler, TOKEN_RIGHT_BRACKET, "Expect ']' after list destructure.");
     consume(compiler, TOKEN_EQUAL, "Expect '=' after list destructure.");
 
-    expression(compiler);
-
-    emitBytes(compiler, OP_UNPACK_LIST, varCount);
+    unpackExpression(compiler, varCount);
 
     if (compiler->scopeDepth == 0) {
       for (int i = varCount - 1; i >= 0; --i) {
@@ -1579,6 +1963,16 @@ static void varDeclaration(Compiler *compiler, bool constant) {
       } else {
         // Default to nil.
         emitByte(compiler, OP_NIL);
+        clearType(compiler);
+      }
+
+      if (compiler->scopeDepth > 0) {
+        int slot = compiler->localCount - 1;
+        compiler->locals[slot].numeric = compiler->lastType.numeric;
+
+        if (compiler->lastType.depends != 0) {
+          addTypedSite(compiler, -1, slot, compiler->lastType.depends);
+        }
       }
 
       defineVariable(compiler, global, constant);
@@ -1607,7 +2001,7 @@ static void expressionStatement(Compiler *compiler) {
   }
 }
 
-static int getArgCount(uint8_t *code, const ValueArray constants, int ip) {
+int getArgCount(uint8_t *code, const ValueArray constants, int ip) {
   switch (code[ip]) {
   case OP_NIL:
   case OP_TRUE:
@@ -1617,7 +2011,9 @@ static int getArgCount(uint8_t *code, const ValueArray constants, int ip) {
   case OP_GREATER:
   case OP_LESS:
   case OP_ADD:
+  case OP_SUBTRACT:
   case OP_MULTIPLY:
+  case OP_DIVIDE:
   case OP_NOT:
   case OP_NEGATE:
   case OP_CLOSE_UPVALUE:
@@ -1626,31 +2022,31 @@ static int getArgCount(uint8_t *code, const ValueArray constants, int ip) {
   case OP_END_CLASS:
   case OP_IMPORT_VARIABLE:
   case OP_IMPORT_END:
-  case OP_BREAK:
   case OP_POW:
   case OP_MOD:
   case OP_BITWISE_AND:
   case OP_BITWISE_XOR:
   case OP_BITWISE_OR:
+  case OP_SHIFT_LEFT:
+  case OP_SHIFT_RIGHT:
   case OP_POP_REPL:
+  case OP_ITER_INIT:
+  case OP_ADD_NN:
+  case OP_SUBTRACT_NN:
+  case OP_MULTIPLY_NN:
+  case OP_DIVIDE_NN:
+  case OP_LESS_NN:
+  case OP_GREATER_NN:
+  case OP_SLICE:
+  case OP_SUBSCRIPT:
+  case OP_SUBSCRIPT_ASSIGN:
+  case OP_SUBSCRIPT_PUSH:
     return 0;
 
-  case OP_CONSTANT:
-  case OP_GET_LOCAL:
-  case OP_SET_LOCAL:
-  case OP_GET_GLOBAL:
-  case OP_GET_MODULE:
-  case OP_DEFINE_MODULE:
-  case OP_SET_MODULE:
-  case OP_GET_UPVALUE:
-  case OP_SET_UPVALUE:
-  case OP_GET_PROPERTY:
   case OP_SET_CLASS_VAR:
-  case OP_GET_SUPER:
-  case OP_METHOD:
-  case OP_IMPORT:
   case OP_DEFINE_OPTIONAL:
   case OP_JUMP:
+  case OP_BREAK:
   case OP_JUMP_IF_NIL:
   case OP_JUMP_IF_FALSE:
   case OP_LOOP:
@@ -1658,11 +2054,41 @@ static int getArgCount(uint8_t *code, const ValueArray constants, int ip) {
   case OP_SUBCLASS:
   case OP_IMPORT_BUILTIN:
   case OP_CALL:
+  case OP_TAIL_CALL:
     return 2;
   case OP_INVOKE:
+  case OP_INVOKE_INTERNAL:
   case OP_SUPER:
+  case OP_ITER_NEXT:
     return 3;
 
+  case OP_CONSTANT:
+  case OP_GET_LOCAL:
+  case OP_SET_LOCAL:
+  case OP_GET_GLOBAL:
+  case OP_GET_MODULE:
+  case OP_DEFINE_MODULE:
+  case OP_SET_MODULE:
+  case OP_GET_UPVALUE:
+  case OP_SET_UPVALUE:
+  case OP_GET_PROPERTY:
+  case OP_LEN:
+  case OP_GET_SUPER:
+  case OP_METHOD:
+  case OP_IMPORT:
+  case OP_GET_PROPERTY_NO_POP:
+  case OP_SET_PROPERTY:
+  case OP_NEW_LIST:
+  case OP_UNPACK_LIST:
+    return 1;
+
+  case OP_MATH_UNARY:
+    return 2;
+
+  case OP_FOR_PREP:
+  case OP_FOR_LOOP:
+    return 6;
+
   case OP_IMPORT_BUILTIN_VARIABLE: {
     int argCount = code[ip + 2];
     return 2 + argCount;
@@ -1706,6 +2132,246 @@ static void endLoop(Compiler *compiler) {
     compiler->loop = compiler->loop->enclosing;
 }
 
+// Returns true if [name] resolves to a local or an upvalue and would
+// therefore shadow a builtin of the same name.
+static bool isShadowed(Compiler *compiler, Token *name) {
+  for (Compiler *current = compiler; current != NULL; current = current->enclosing) {
+    if (resolveLocal(current, name, true) != -1) return true;
+  }
+
+  return false;
+}
+
+// Names the value on top of the stack as a local of the loop scope.
+static int addLoopLocal(Compiler *compiler, Token name) {
+  addLocal(compiler, name);
+  compiler->locals[compiler->localCount - 1].depth = compiler->scopeDepth;
+  return compiler->localCount - 1;
+}
+
+// Compiles the body of a counted loop whose counter, limit and step
+// live in local slots.
+//
+//   OP_FOR_PREP  counter limit step mode -> exit
+// body:                                 <--.
+//   statement                              |
+//   OP_FOR_LOOP  counter limit step mode --'
+// exit:
+//
+// OP_FOR_PREP checks the operands and the first iteration, OP_FOR_LOOP
+// does the increment, compare and branch in a single dispatch.
+static void countedLoop(Compiler *compiler, int counter, int limit, int step, ForLoopMode mode) {
+  emitBytes(compiler, OP_FOR_PREP, counter);
+  emitBytes(compiler, limit, step);
+  emitByte(compiler, mode);
+  emitBytes(compiler, 0xff, 0xff);
+  int exitJump = currentChunk(compiler)->count - 2;
+
+  Loop loop;
+  loop.start = -1;
+  loop.end = -1;
+  loop.continueCount = 0;
+  loop.scopeDepth = compiler->scopeDepth;
+  loop.enclosing = compiler->loop;
+  compiler->loop = &loop;
+
+  loop.body = currentChunk(compiler)->count;
+  statement(compiler);
+
+  for (int i = 0; i < loop.continueCount; i++) {
+    patchJump(compiler, loop.continueJumps[i]);
+  }
+
+  emitBytes(compiler, OP_FOR_LOOP, counter);
+  emitBytes(compiler, limit, step);
+  emitByte(compiler, mode);
+
+  int offset = currentChunk(compiler)->count - loop.body + 2;
+  if (offset > UINT16_MAX) error(compiler->parser, "Loop body too large.");
+
+  emitBytes(compiler, (offset >> 8) & 0xff, offset & 0xff);
+
+  patchJump(compiler, exitJump);
+  endLoop(compiler);
+}
+
+// Recognises the canonical numeric loop
+//
+//   for (var i = start; i < limit; i += step)
+//
+// where limit is a number literal or a local, step is a number literal
+// and the comparison is one of < <= > >=. The initialiser has already
+// been compiled. Returns false without consuming anything if the
+// remaining clauses take any other shape.
+static bool countedForStatement(Compiler *compiler) {
+  Parser *parser = compiler->parser;
+  int counter = compiler->localCount - 1;
+  Token name = compiler->locals[counter].name;
+
+  // Look ahead on a copy of the scanner so nothing has to be undone.
+  Scanner scanner = parser->scanner;
+  Token token = parser->current;
+
+  if (token.type != TOKEN_IDENTIFIER || !identifiersEqual(&token, &name)) return false;
+
+  ForLoopMode mode;
+  switch (scanToken(&scanner).type) {
+    case TOKEN_LESS: mode = FOR_LESS; break;
+    case TOKEN_LESS_EQUAL: mode = FOR_LESS_EQUAL; break;
+    case TOKEN_GREATER: mode = FOR_GREATER; break;
+    case TOKEN_GREATER_EQUAL: mode = FOR_GREATER_EQUAL; break;
+    default: return false;
+  }
+
+  token = scanToken(&scanner);
+  bool negativeLimit = token.type == TOKEN_MINUS;
+  if (negativeLimit) token = scanToken(&scanner);
+
+  int limit = -1;
+  if (token.type == TOKEN_IDENTIFIER && !negativeLimit) {
+    // The limit is re-read on every iteration, so the body may still
+    // change it as it could in the generic lowering.
+    limit = resolveLocal(compiler, &token, true);
+    if (limit == -1 || limit == counter) return false;
+  } else if (token.type != TOKEN_NUMBER) {
+    return false;
+  }
+
+  if (scanToken(&scanner).type != TOKEN_SEMICOLON) return false;
+
+  token = scanToken(&scanner);
+  if (token.type != TOKEN_IDENTIFIER || !identifiersEqual(&token, &name)) return false;
+
+  token = scanToken(&scanner);
+  if (token.type != TOKEN_PLUS_EQUALS && token.type != TOKEN_MINUS_EQUALS) return false;
+  bool negativeStep = token.type == TOKEN_MINUS_EQUALS;
+
+  if (scanToken(&scanner).type != TOKEN_NUMBER) return false;
+  if (scanToken(&scanner).type != TOKEN_RIGHT_PAREN) return false;
+
+  // The clauses match, consume them for real.
+  advance(parser); // Counter.
+  advance(parser); // Comparison.
+
+  if (limit == -1) {
+    if (negativeLimit) advance(parser);
+    advance(parser);
+
+    Value value = parseNumber(compiler, false);
+    emitConstant(compiler, negativeLimit ? negateNumber(value) : value);
+    limit = addLoopLocal(compiler, syntheticToken(""));
+  } else {
+    advance(parser);
+  }
+
+  advance(parser); // ';'
+  advance(parser); // Counter.
+  advance(parser); // '+=' or '-='.
+  advance(parser);
+
+  Value step = parseNumber(compiler, false);
+  emitConstant(compiler, negativeStep ? negateNumber(step) : step);
+  int stepSlot = addLoopLocal(compiler, syntheticToken(""));
+
+  consume(compiler, TOKEN_RIGHT_PAREN, "Expect ')' after for clauses.");
+
+  countedLoop(compiler, counter, limit, stepSlot, mode);
+  return true;
+}
+
+// Compiles 'for i in range(start, end, step)' into a counted loop. The
+// arguments are evaluated before the loop variable comes into scope,
+// range(end) counts from 0 and the step defaults to 1.
+static void rangeStatement(Compiler *compiler, Token name) {
+  consume(compiler, TOKEN_LEFT_PAREN, "Expect '(' after 'range'.");
+  expression(compiler);
+
+  bool hasStart = match(compiler, TOKEN_COMMA);
+  if (hasStart) {
+    expression(compiler);
+  } else {
+    emitConstant(compiler, INT_VAL(0));
+  }
+
+  if (hasStart && match(compiler, TOKEN_COMMA)) {
+    expression(compiler);
+  } else {
+    emitConstant(compiler, INT_VAL(1));
+  }
+
+  int counter, limit;
+  if (hasStart) {
+    counter = addLoopLocal(compiler, name);
+    limit = addLoopLocal(compiler, syntheticToken(""));
+  } else {
+    limit = addLoopLocal(compiler, syntheticToken(""));
+    counter = addLoopLocal(compiler, name);
+  }
+  int step = addLoopLocal(compiler, syntheticToken(""));
+
+  // OP_FOR_PREP only enters the loop with a numeric counter.
+  compiler->locals[counter].numeric = true;
+
+  consume(compiler, TOKEN_RIGHT_PAREN, "Expect ')' after range arguments.");
+
+  countedLoop(compiler, counter, limit, step, FOR_RANGE);
+}
+
+static void forInStatement(Compiler *compiler) {
+  // for x in collection print x;
+  //
+  //   OP_ITER_INIT              iterable, cursor, size
+  //   OP_NIL                    x
+  // start:                   <--.
+  //   OP_ITER_NEXT -> exit  --. |
+  //   print x;                | |
+  //   goto start;  -----------+-'
+  // exit:                  <--'
+  consume(compiler, TOKEN_IDENTIFIER, "Expect loop variable name after 'for'.");
+  Token name = compiler->parser->previous;
+  consume(compiler, TOKEN_IN, "Expect 'in' after loop variable.");
+
+  // Create a scope for the loop variables.
+  beginScope(compiler);
+
+  Token range = syntheticToken("range");
+  if (check(compiler, TOKEN_IDENTIFIER) &&
+      identifiersEqual(&compiler->parser->current, &range) &&
+      !isShadowed(compiler, &range)) {
+    advance(compiler->parser);
+    rangeStatement(compiler, name);
+    endScope(compiler);
+    return;
+  }
+
+  expression(compiler);
+  int iterable = addLoopLocal(compiler, syntheticToken(""));
+  emitByte(compiler, OP_ITER_INIT);
+  addLoopLocal(compiler, syntheticToken("")); // Cursor.
+  addLoopLocal(compiler, syntheticToken("")); // Size.
+  emitByte(compiler, OP_NIL);
+  addLoopLocal(compiler, name);
+
+  Loop loop;
+  loop.start = currentChunk(compiler)->count;
+  loop.end = -1;
+  loop.scopeDepth = compiler->scopeDepth;
+  loop.enclosing = compiler->loop;
+  compiler->loop = &loop;
+
+  emitBytes(compiler, OP_ITER_NEXT, iterable);
+  emitBytes(compiler, 0xff, 0xff);
+  int exitJump = currentChunk(compiler)->count - 2;
+
+  loop.body = currentChunk(compiler)->count;
+  statement(compiler);
+  emitLoop(compiler, loop.start);
+
+  patchJump(compiler, exitJump);
+  endLoop(compiler);
+  endScope(compiler); // Loop variables.
+}
+
 static void forStatement(Compiler *compiler) {
   // for (var i = 0; i < 10; i = i + 1) print i;
   //
@@ -1728,6 +2394,11 @@ static void forStatement(Compiler *compiler) {
   consume(compiler, TOKEN_LEFT_PAREN, "Expect '(' after 'for'.");
   if (match(compiler, TOKEN_VAR)) {
     varDeclaration(compiler, false);
+
+    if (countedForStatement(compiler)) {
+      endScope(compiler); // Loop variable.
+      return;
+    }
   } else if (match(compiler, TOKEN_SEMICOLON)) {
     // No initializer.
   } else {
@@ -1818,8 +2489,17 @@ static void continueStatement(Compiler *compiler) {
       emitByte(compiler, OP_POP);
   }
 
-  // Jump to top of current innermost loop.
-  emitLoop(compiler, compiler->loop->start);
+  if (compiler->loop->start == -1) {
+    if (compiler->loop->continueCount == UINT8_COUNT) {
+      error(compiler->parser, "Too many 'continue' statements in loop.");
+      return;
+    }
+
+    compiler->loop->continueJumps[compiler->loop->continueCount++] = emitJump(compiler, OP_JUMP);
+  } else {
+    // Jump to top of current innermost loop.
+    emitLoop(compiler, compiler->loop->start);
+  }
 }
 
 static void ifStatement(Compiler *compiler) {
@@ -1861,6 +2541,13 @@ static void returnStatement(Compiler *compiler) {
     expression(compiler);
     consume(compiler, TOKEN_SEMICOLON, "Expect ';' after return value.");
 
+    // A call in tail position reuses the frame. Rewriting it in place
+    // keeps any jumps into the return valid, and the OP_RETURN is still
+    // needed for callees that are not closures.
+    if (compiler->lastCall != -1 && compiler->lastCall == currentChunk(compiler)->count - 3) {
+      currentChunk(compiler)->code[compiler->lastCall] = OP_TAIL_CALL;
+    }
+
     emitByte(compiler, OP_RETURN);
   }
 }
@@ -2087,9 +2774,7 @@ static void unpackListStatement(Compiler *compiler){
 
     consume(compiler, TOKEN_EQUAL, "Expect '=' after list destructure.");
 
-    expression(compiler);
-
-    emitBytes(compiler, OP_UNPACK_LIST, varCount);
+    unpackExpression(compiler, varCount);
 
 
     for(int i=varCount-1;i>-1;i--){
@@ -2099,6 +2784,9 @@ static void unpackListStatement(Compiler *compiler){
         int arg = resolveLocal(compiler, &token, false);
         if (arg != -1) {
                 setOp = OP_SET_LOCAL;
+                if (arg == compiler->varargsSlot) {
+                    compiler->varargsEscapes = true;
+                }
         } else if ((arg = resolveUpvalue(compiler, &token)) != -1) {
                 setOp = OP_SET_UPVALUE;
         } else {
@@ -2106,7 +2794,8 @@ static void unpackListStatement(Compiler *compiler){
                 setOp = OP_SET_MODULE;
         }
         checkConst(compiler, setOp, arg);
-        emitBytes(compiler, setOp, (uint8_t) arg);
+        clearType(compiler);
+        emitSetVariable(compiler, setOp, arg);
         emitByte(compiler, OP_POP);
     }
 
@@ -2158,7 +2847,11 @@ static void declaration(Compiler *compiler) {
 
 static void statement(Compiler *compiler) {
   if (match(compiler, TOKEN_FOR)) {
-    forStatement(compiler);
+    if (check(compiler, TOKEN_LEFT_PAREN)) {
+      forStatement(compiler);
+    } else {
+      forInStatement(compiler);
+    }
   } else if (match(compiler, TOKEN_IF)) {
     ifStatement(compiler);
   } else if (match(compiler, TOKEN_RETURN)) {
@@ -2252,7 +2945,15 @@ ObjFunction *compile(DictuVM *vm, ObjModule *module, const char *source) {
 
   // If there was a compile error, the code is not valid, so don't
   // create a function.
-  return parser.hadError ? NULL : function;
+  if (parser.hadError) {
+    return NULL;
+  }
+
+  if (vm->aotEntryCount > 0) {
+    aotLink(vm, function);
+  }
+
+  return function;
 }
 
 void grayCompilerRoots(DictuVM *vm) {
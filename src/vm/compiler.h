@@ -16,6 +16,7 @@ typedef enum {
   PREC_BITWISE_OR,  // bitwise or
   PREC_BITWISE_XOR, // bitwise xor
   PREC_BITWISE_AND, // bitwise and
+  PREC_SHIFT,       // << >>
   PREC_TERM,        // + -
   PREC_FACTOR,      // * /
   PREC_INDICES,     // **
@@ -40,6 +41,9 @@ typedef struct {
 
   // True if it's a constant value.
   bool constant;
+
+  // True if the variable was initialised with a number.
+  bool numeric;
 } Local;
 
 typedef struct {
@@ -73,8 +77,35 @@ typedef struct Loop {
   int body;
   int end;
   int scopeDepth;
+
+  // Counted loops test at the bottom, so 'continue' is a forward jump
+  // (start is -1) that gets patched once the body has been compiled.
+  int continueCount;
+  int continueJumps[UINT8_COUNT];
 } Loop;
 
+// Only the first 64 local slots take part in numeric inference.
+#define NUMERIC_LOCALS 64
+#define NUMERIC_LOCAL(slot) ((slot) < NUMERIC_LOCALS ? 1ULL << (slot) : 0)
+
+typedef struct {
+  // True if the expression is known to produce a number.
+  bool numeric;
+
+  // The local slots that have to hold numbers for the above to be
+  // true. Inference is optimistic, it is checked once the function has
+  // been compiled.
+  uint64_t depends;
+} ExprType;
+
+typedef struct {
+  // Offset of an unchecked arithmetic opcode, or -1 when this records
+  // a numeric assignment to slot.
+  int offset;
+  int slot;
+  uint64_t depends;
+} TypedSite;
+
 typedef struct {
   DictuVM *vm;
   Scanner scanner;
@@ -103,6 +134,27 @@ typedef struct Compiler {
 
   int scopeDepth;
   bool withBlock;
+
+  // Type of the expression compiled last.
+  ExprType lastType;
+
+  // Local slots assigned something other than a number.
+  uint64_t dirtyLocals;
+  TypedSite *typedSites;
+  int typedSiteCount;
+  int typedSiteCapacity;
+
+  // Slot of the variadic parameter, -1 if there is none. Its list only
+  // stays in the call if it is used as a subscript target or as the
+  // receiver of a list method that doesn't hold on to it.
+  int varargsSlot;
+  bool varargsEscapes;
+  bool varargsReceiver;
+
+  // Offset of the last OP_CALL emitted, a return can turn it into a
+  // tail call if nothing was emitted after it.
+  int lastCall;
+
   ObjDict *classAnnotations;
   ObjDict *methodAnnotations;
 } Compiler;
@@ -118,6 +170,9 @@ typedef struct {
 
 ObjFunction *compile(DictuVM *vm, ObjModule *module, const char *source);
 
+// Number of operand bytes following the instruction at ip.
+int getArgCount(uint8_t *code, const ValueArray constants, int ip);
+
 void grayCompilerRoots(DictuVM *vm);
 
 #endif
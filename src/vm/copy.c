@@ -70,6 +70,9 @@ ObjInstance *copyInstance(DictuVM* vm, ObjInstance *oldInstance, bool shallow) {
     if (shallow) {
         tableAddAll(vm, &oldInstance->publicFields, &instance->publicFields);
     } else {
+        tableFinishResize(vm, &oldInstance->publicFields);
+        tableFinishResize(vm, &oldInstance->privateFields);
+
         for (int i = 0; i <= oldInstance->publicFields.capacityMask; i++) {
             Entry *entry = &oldInstance->publicFields.entries[i];
             if (entry->key != NULL) {
@@ -123,6 +123,27 @@ static int jumpInstruction(const char *name, int sign, Chunk *chunk,
   return offset + 3;
 }
 
+static int forInstruction(const char *name, int sign, Chunk *chunk,
+                          int offset) {
+  uint8_t counter = chunk->code[offset + 1];
+  uint8_t limit = chunk->code[offset + 2];
+  uint8_t step = chunk->code[offset + 3];
+  uint8_t mode = chunk->code[offset + 4];
+  uint16_t jump = (uint16_t)(chunk->code[offset + 5] << 8);
+  jump |= chunk->code[offset + 6];
+  printf("%-16s %4d %4d %4d (%d) %4d -> %d\n", name, counter, limit, step,
+         mode, offset, offset + 7 + sign * jump);
+  return offset + 7;
+}
+
+static int iterInstruction(const char *name, Chunk *chunk, int offset) {
+  uint8_t slot = chunk->code[offset + 1];
+  uint16_t jump = (uint16_t)(chunk->code[offset + 2] << 8);
+  jump |= chunk->code[offset + 3];
+  printf("%-16s %4d %4d -> %d\n", name, slot, offset, offset + 4 + jump);
+  return offset + 4;
+}
+
 int disassembleInstruction(Chunk *chunk, int offset) {
   printf("%04d ", offset);
   if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1]) {
@@ -194,6 +215,26 @@ int disassembleInstruction(Chunk *chunk, int offset) {
     return simpleInstruction("OP_BITWISE_XOR", offset);
   case OP_BITWISE_OR:
     return simpleInstruction("OP_BITWISE_OR", offset);
+  case OP_SHIFT_LEFT:
+    return simpleInstruction("OP_SHIFT_LEFT", offset);
+  case OP_SHIFT_RIGHT:
+    return simpleInstruction("OP_SHIFT_RIGHT", offset);
+  case OP_POW:
+    return simpleInstruction("OP_POW", offset);
+  case OP_MOD:
+    return simpleInstruction("OP_MOD", offset);
+  case OP_ADD_NN:
+    return simpleInstruction("OP_ADD_NN", offset);
+  case OP_SUBTRACT_NN:
+    return simpleInstruction("OP_SUBTRACT_NN", offset);
+  case OP_MULTIPLY_NN:
+    return simpleInstruction("OP_MULTIPLY_NN", offset);
+  case OP_DIVIDE_NN:
+    return simpleInstruction("OP_DIVIDE_NN", offset);
+  case OP_LESS_NN:
+    return simpleInstruction("OP_LESS_NN", offset);
+  case OP_GREATER_NN:
+    return simpleInstruction("OP_GREATER_NN", offset);
   case OP_NOT:
     return simpleInstruction("OP_NOT", offset);
   case OP_NEGATE:
@@ -214,10 +255,22 @@ int disassembleInstruction(Chunk *chunk, int offset) {
     return simpleInstruction("OP_IMPORT_END", offset);
   case OP_CALL:
     return callInstruction("OP_CALL", chunk, offset);
+  case OP_TAIL_CALL:
+    return callInstruction("OP_TAIL_CALL", chunk, offset);
   case OP_INVOKE_INTERNAL:
     return invokeInstruction("OP_INVOKE_INTERNAL", chunk, offset);
   case OP_INVOKE:
     return invokeInstruction("OP_INVOKE", chunk, offset);
+  case OP_LEN:
+    return constantInstruction("OP_LEN", chunk, offset);
+  case OP_MATH_UNARY: {
+    uint8_t function = chunk->code[offset + 1];
+    uint8_t constant = chunk->code[offset + 2];
+    printf("%-16s %4d '", "OP_MATH_UNARY", function);
+    printValue(chunk->constants.values[constant]);
+    printf("'\n");
+    return offset + 3;
+  }
   case OP_SUPER:
     return invokeInstruction("OP_SUPER_", chunk, offset);
   case OP_CLOSURE: {
@@ -255,6 +308,14 @@ int disassembleInstruction(Chunk *chunk, int offset) {
     return constantInstruction("OP_METHOD", chunk, offset);
   case OP_BREAK:
     return simpleInstruction("OP_BREAK", offset);
+  case OP_ITER_INIT:
+    return simpleInstruction("OP_ITER_INIT", offset);
+  case OP_ITER_NEXT:
+    return iterInstruction("OP_ITER_NEXT", chunk, offset);
+  case OP_FOR_PREP:
+    return forInstruction("OP_FOR_PREP", 1, chunk, offset);
+  case OP_FOR_LOOP:
+    return forInstruction("OP_FOR_LOOP", -1, chunk, offset);
   default:
     printf("Unknown opcode %d\n", instruction);
     return offset + 1;
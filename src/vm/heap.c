@@ -0,0 +1,683 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "heap.h"
+#include "memory.h"
+#include "vm.h"
+
+// Slot sizes of each class, every granule up to 128 bytes then coarser
+// steps, objects the VM allocates mostly sit in the first few.
+static const size_t classSizes[HEAP_SIZE_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+
+#define PAGE_HEADER_SIZE \
+    ((sizeof(HeapPage) + HEAP_GRANULE - 1) & ~(size_t) (HEAP_GRANULE - 1))
+
+#define BIT_WORD(bit) ((bit) / 64)
+#define BIT_MASK(bit) ((uint64_t) 1 << ((bit) % 64))
+
+static inline int lowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int) index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+static inline int countBits(uint64_t bits) {
+#ifdef _MSC_VER
+    return (int) __popcnt64(bits);
+#else
+    return __builtin_popcountll(bits);
+#endif
+}
+
+static inline int sizeClassOf(size_t size) {
+    if (size <= 128) {
+        return (int) ((size + HEAP_GRANULE - 1) / HEAP_GRANULE) - 1;
+    }
+
+    if (size <= 256) {
+        return 7 + (int) ((size - 128 + 31) / 32);
+    }
+
+    return 11 + (int) ((size - 256 + 63) / 64);
+}
+
+void initHeap(Heap *heap) {
+    for (int i = 0; i <= HEAP_SIZE_CLASSES; ++i) {
+        heap->pages[i] = NULL;
+    }
+
+    for (int i = 0; i < HEAP_SIZE_CLASSES; ++i) {
+        heap->allocating[i] = NULL;
+        heap->lastPage[i] = NULL;
+        heap->swept[i] = NULL;
+    }
+
+    heap->unsweptPages = 0;
+    heap->sweepClass = 0;
+    heap->sweepPace = 0;
+    heap->sweepCredit = 0;
+    heap->pageBytes = 0;
+    heap->reclaimableBytes = 0;
+    heap->evacuating = NULL;
+    heap->evacuatingCount = 0;
+}
+
+size_t heapSlotSize(size_t size) {
+    if (size > HEAP_LARGE_OBJECT) {
+        return size;
+    }
+
+    return classSizes[sizeClassOf(size)];
+}
+
+static HeapPage *newPage(Heap *heap, int sizeClass, size_t slotSize, size_t pageSize) {
+    void *memory;
+
+#ifdef _WIN32
+    memory = _aligned_malloc(pageSize, HEAP_PAGE_SIZE);
+#else
+    if (posix_memalign(&memory, HEAP_PAGE_SIZE, pageSize) != 0) {
+        memory = NULL;
+    }
+#endif
+
+    if (memory == NULL) {
+        return NULL;
+    }
+
+    HeapPage *page = (HeapPage *) memory;
+    page->marks = calloc(HEAP_BITMAP_WORDS, sizeof(uint64_t));
+    if (page->marks == NULL) {
+#ifdef _WIN32
+        _aligned_free(page);
+#else
+        free(page);
+#endif
+        return NULL;
+    }
+
+    page->next = NULL;
+    page->sizeClass = sizeClass;
+    page->slotSize = slotSize;
+    page->slotCount = (int) ((pageSize - PAGE_HEADER_SIZE) / slotSize);
+    page->liveCount = 0;
+    page->evacuating = false;
+    page->slots = (char *) page + PAGE_HEADER_SIZE;
+    memset(page->live, 0, sizeof(page->live));
+
+    // Linked in reverse so the first slot is handed out first.
+    page->freeSlots = NULL;
+    for (int i = page->slotCount - 1; i >= 0; --i) {
+        void *slot = page->slots + slotSize * i;
+        *(void **) slot = page->freeSlots;
+        page->freeSlots = slot;
+    }
+
+    if (sizeClass == HEAP_SIZE_CLASSES) {
+        page->next = heap->pages[sizeClass];
+        heap->pages[sizeClass] = page;
+    } else {
+        if (heap->lastPage[sizeClass] == NULL) {
+            heap->pages[sizeClass] = page;
+        } else {
+            heap->lastPage[sizeClass]->next = page;
+        }
+
+        heap->lastPage[sizeClass] = page;
+    }
+
+    heap->pageBytes += pageSize;
+
+    return page;
+}
+
+// Pages freed with release set are given back to the system as well,
+// free() alone keeps them in the process for the next allocation.
+static void freePage(Heap *heap, HeapPage *page, bool release) {
+    size_t pageSize = HEAP_PAGE_SIZE;
+
+    if (page->sizeClass == HEAP_SIZE_CLASSES) {
+        pageSize = PAGE_HEADER_SIZE + page->slotSize;
+    }
+
+    heap->pageBytes -= pageSize;
+    free(page->marks);
+
+#ifdef _WIN32
+    UNUSED(release);
+    _aligned_free(page);
+#else
+    if (release) {
+        // Only whole system pages, the malloc chunk after this one may
+        // share the last.
+        size_t length = pageSize & ~((size_t) sysconf(_SC_PAGESIZE) - 1);
+
+        if (length > 0) {
+            madvise(page, length, MADV_DONTNEED);
+        }
+    }
+
+    free(page);
+#endif
+}
+
+static inline void *takeSlot(HeapPage *page) {
+    void *slot = page->freeSlots;
+    page->freeSlots = *(void **) slot;
+
+    size_t bit = HEAP_BIT(page, slot);
+    page->live[BIT_WORD(bit)] |= BIT_MASK(bit);
+    page->liveCount++;
+
+    return slot;
+}
+
+// Frees the unmarked objects of a page onto its free list. Words with
+// nothing dead are left alone, so a page where everything survived is
+// only read.
+static void sweepPage(DictuVM *vm, HeapPage *page) {
+    size_t before = vm->bytesAllocated;
+
+    for (int word = 0; word < HEAP_BITMAP_WORDS; ++word) {
+        uint64_t dead = page->live[word] & ~page->marks[word];
+        if (dead == 0) {
+            continue;
+        }
+
+        page->live[word] &= ~dead;
+
+        while (dead != 0) {
+            int bit = lowestBit(dead);
+            dead &= dead - 1;
+
+            Obj *object = (Obj *) ((char *) page + (word * 64 + bit) * HEAP_GRANULE);
+            freeObject(vm, object);
+
+            *(void **) object = page->freeSlots;
+            page->freeSlots = object;
+            page->liveCount--;
+            vm->bytesAllocated -= page->slotSize;
+        }
+    }
+
+    memset(page->marks, 0, HEAP_BITMAP_WORDS * sizeof(uint64_t));
+
+    size_t freed = before - vm->bytesAllocated;
+    vm->nextGC = vm->nextGC > freed ? vm->nextGC - freed : 0;
+}
+
+static HeapPage *firstUnswept(Heap *heap, int sizeClass) {
+    HeapPage *swept = heap->swept[sizeClass];
+
+    return swept == NULL ? heap->pages[sizeClass] : swept->next;
+}
+
+// Moves the allocation cursor of a size class to the next page with a
+// free slot, sweeping pages on the way.
+static HeapPage *nextPage(DictuVM *vm, int sizeClass) {
+    Heap *heap = &vm->heap;
+    HeapPage *page = heap->allocating[sizeClass];
+    bool unswept = page == heap->swept[sizeClass];
+    page = page == NULL ? heap->pages[sizeClass] : page->next;
+
+    while (page != NULL) {
+        if (unswept) {
+            sweepPage(vm, page);
+            heap->swept[sizeClass] = page;
+            heap->unsweptPages--;
+        }
+
+        heap->allocating[sizeClass] = page;
+
+        if (page->freeSlots != NULL) {
+            return page;
+        }
+
+        if (page == heap->swept[sizeClass]) {
+            unswept = true;
+        }
+
+        page = page->next;
+    }
+
+    page = newPage(heap, sizeClass, classSizes[sizeClass], HEAP_PAGE_SIZE);
+    if (page != NULL) {
+        heap->allocating[sizeClass] = page;
+        heap->swept[sizeClass] = page;
+    }
+
+    return page;
+}
+
+void *heapAllocate(DictuVM *vm, size_t size) {
+    Heap *heap = &vm->heap;
+
+    if (size > HEAP_LARGE_OBJECT) {
+        HeapPage *page = newPage(heap, HEAP_SIZE_CLASSES, size, PAGE_HEADER_SIZE + size);
+        if (page == NULL) {
+            return NULL;
+        }
+
+        return takeSlot(page);
+    }
+
+    int sizeClass = sizeClassOf(size);
+    HeapPage *page = heap->allocating[sizeClass];
+
+    if (page == NULL || page->freeSlots == NULL) {
+        page = nextPage(vm, sizeClass);
+
+        if (page == NULL) {
+            return NULL;
+        }
+    }
+
+    return takeSlot(page);
+}
+
+void finishSweep(DictuVM *vm) {
+    Heap *heap = &vm->heap;
+
+    for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; ++sizeClass) {
+        HeapPage *unswept = firstUnswept(heap, sizeClass);
+
+        for (; unswept != NULL; unswept = unswept->next) {
+            sweepPage(vm, unswept);
+        }
+
+        // Return the pages nothing survived on.
+        HeapPage **page = &heap->pages[sizeClass];
+        HeapPage *last = NULL;
+
+        while (*page != NULL) {
+            HeapPage *current = *page;
+
+            if (current->liveCount == 0) {
+                *page = current->next;
+                freePage(heap, current, false);
+                continue;
+            }
+
+            last = current;
+            page = &current->next;
+        }
+
+        heap->allocating[sizeClass] = NULL;
+        heap->lastPage[sizeClass] = last;
+        heap->swept[sizeClass] = last;
+    }
+
+    heap->unsweptPages = 0;
+}
+
+size_t startSweep(DictuVM *vm) {
+    Heap *heap = &vm->heap;
+    size_t objectBytes = 0;
+    size_t deadBytes = 0;
+
+    heap->reclaimableBytes = 0;
+
+    for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; ++sizeClass) {
+        heap->allocating[sizeClass] = NULL;
+        heap->swept[sizeClass] = NULL;
+
+        int pageCount = 0;
+        int marked = 0;
+        int slotCount = 1;
+
+        for (HeapPage *page = heap->pages[sizeClass]; page != NULL; page = page->next) {
+            heap->unsweptPages++;
+
+            int dead = 0;
+
+            for (int word = 0; word < HEAP_BITMAP_WORDS; ++word) {
+                dead += countBits(page->live[word] & ~page->marks[word]);
+            }
+
+            objectBytes += page->liveCount * page->slotSize;
+            deadBytes += dead * page->slotSize;
+
+            pageCount++;
+            marked += page->liveCount - dead;
+            slotCount = page->slotCount;
+        }
+
+        // Pages beyond those the survivors would fill if packed.
+        int needed = (marked + slotCount - 1) / slotCount;
+        heap->reclaimableBytes += (size_t) (pageCount - needed) * HEAP_PAGE_SIZE;
+    }
+
+    // What the dead objects own is only known once they are freed, take
+    // it to be in proportion to their slots.
+    if (objectBytes > 0 && vm->bytesAllocated > objectBytes) {
+        double owned = (double) (vm->bytesAllocated - objectBytes);
+        deadBytes += (size_t) (owned * deadBytes / objectBytes);
+    }
+
+    HeapPage **page = &heap->pages[HEAP_SIZE_CLASSES];
+    while (*page != NULL) {
+        HeapPage *current = *page;
+        sweepPage(vm, current);
+
+        if (current->liveCount == 0) {
+            *page = current->next;
+            freePage(heap, current, false);
+            continue;
+        }
+
+        page = &current->next;
+    }
+
+    return deadBytes;
+}
+
+void freeHeap(DictuVM *vm) {
+    Heap *heap = &vm->heap;
+
+    for (int sizeClass = 0; sizeClass <= HEAP_SIZE_CLASSES; ++sizeClass) {
+        HeapPage *page = heap->pages[sizeClass];
+
+        while (page != NULL) {
+            HeapPage *next = page->next;
+
+            for (int word = 0; word < HEAP_BITMAP_WORDS; ++word) {
+                uint64_t bits = page->live[word];
+
+                while (bits != 0) {
+                    int bit = lowestBit(bits);
+                    bits &= bits - 1;
+
+                    freeObject(vm, (Obj *) ((char *) page + (word * 64 + bit) * HEAP_GRANULE));
+                    vm->bytesAllocated -= page->slotSize;
+                }
+            }
+
+            freePage(heap, page, false);
+            page = next;
+        }
+    }
+
+    initHeap(heap);
+}
+
+void setSweepPace(Heap *heap, size_t headroom) {
+    heap->sweepCredit = 0;
+    heap->sweepPace = heap->unsweptPages > 0 ? headroom / heap->unsweptPages : 0;
+
+    if (heap->sweepPace == 0) {
+        heap->sweepPace = 1;
+    }
+}
+
+void paceSweep(DictuVM *vm, size_t bytes) {
+    Heap *heap = &vm->heap;
+    heap->sweepCredit += bytes;
+
+    while (heap->sweepCredit >= heap->sweepPace && heap->unsweptPages > 0) {
+        int sizeClass = heap->sweepClass;
+        HeapPage *page = firstUnswept(heap, sizeClass);
+
+        if (page == NULL) {
+            heap->sweepClass = (sizeClass + 1) % HEAP_SIZE_CLASSES;
+            continue;
+        }
+
+        sweepPage(vm, page);
+        heap->swept[sizeClass] = page;
+        heap->unsweptPages--;
+        heap->sweepCredit -= heap->sweepPace;
+    }
+}
+
+static int countMarked(HeapPage *page) {
+    int count = 0;
+
+    for (int word = 0; word < HEAP_BITMAP_WORDS; ++word) {
+        count += countBits(page->marks[word]);
+    }
+
+    return count;
+}
+
+typedef struct {
+    HeapPage *page;
+    int marked;
+} PageOccupancy;
+
+static int compareOccupancy(const void *a, const void *b) {
+    return ((const PageOccupancy *) a)->marked - ((const PageOccupancy *) b)->marked;
+}
+
+static int compareAddress(const void *a, const void *b) {
+    uintptr_t first = (uintptr_t) *(HeapPage *const *) a;
+    uintptr_t second = (uintptr_t) *(HeapPage *const *) b;
+
+    return (first > second) - (first < second);
+}
+
+int selectEvacuation(DictuVM *vm) {
+    Heap *heap = &vm->heap;
+    int pageCount = 0;
+
+    for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; ++sizeClass) {
+        for (HeapPage *page = heap->pages[sizeClass]; page != NULL; page = page->next) {
+            pageCount++;
+        }
+    }
+
+    if (pageCount == 0) {
+        return 0;
+    }
+
+    // Not using reallocate() here because we don't want to trigger the
+    // GC inside a GC!
+    PageOccupancy *occupancy = malloc(sizeof(PageOccupancy) * pageCount);
+    heap->evacuating = malloc(sizeof(HeapPage *) * pageCount);
+    heap->evacuatingCount = 0;
+
+    if (occupancy == NULL || heap->evacuating == NULL) {
+        free(occupancy);
+        free(heap->evacuating);
+        heap->evacuating = NULL;
+        return 0;
+    }
+
+    for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; ++sizeClass) {
+        int count = 0;
+        int freeSlots = 0;
+
+        // Empty pages are freed by the sweep, they take no part.
+        for (HeapPage *page = heap->pages[sizeClass]; page != NULL; page = page->next) {
+            int marked = countMarked(page);
+
+            if (marked > 0) {
+                occupancy[count].page = page;
+                occupancy[count].marked = marked;
+                freeSlots += page->slotCount - marked;
+                count++;
+            }
+        }
+
+        qsort(occupancy, count, sizeof(PageOccupancy), compareOccupancy);
+
+        // Sparsest first, while less than half full and the objects
+        // moved so far still fit in the pages left.
+        int moved = 0;
+
+        for (int i = 0; i < count; ++i) {
+            HeapPage *page = occupancy[i].page;
+            int marked = occupancy[i].marked;
+
+            if (marked * 2 >= page->slotCount ||
+                moved + marked > freeSlots - (page->slotCount - marked)) {
+                break;
+            }
+
+            moved += marked;
+            freeSlots -= page->slotCount - marked;
+            page->evacuating = true;
+            heap->evacuating[heap->evacuatingCount++] = page;
+        }
+    }
+
+    free(occupancy);
+
+    qsort(heap->evacuating, heap->evacuatingCount, sizeof(HeapPage *), compareAddress);
+
+    return heap->evacuatingCount;
+}
+
+// Next free slot of a size class outside the pages being evacuated.
+// selectEvacuation left room for every object moved.
+static void *evacuationSlot(Heap *heap, int sizeClass) {
+    HeapPage *page = heap->allocating[sizeClass];
+
+    while (page == NULL || page->evacuating || page->freeSlots == NULL) {
+        page = page == NULL ? heap->pages[sizeClass] : page->next;
+    }
+
+    heap->allocating[sizeClass] = page;
+
+    return takeSlot(page);
+}
+
+void evacuatePages(DictuVM *vm) {
+    Heap *heap = &vm->heap;
+
+    for (int sizeClass = 0; sizeClass <= HEAP_SIZE_CLASSES; ++sizeClass) {
+        HeapPage **page = &heap->pages[sizeClass];
+        HeapPage *last = NULL;
+
+        while (*page != NULL) {
+            HeapPage *current = *page;
+
+            if (!current->evacuating) {
+                sweepPage(vm, current);
+
+                if (current->liveCount == 0) {
+                    *page = current->next;
+                    freePage(heap, current, true);
+                    continue;
+                }
+            }
+
+            last = current;
+            page = &current->next;
+        }
+
+        if (sizeClass < HEAP_SIZE_CLASSES) {
+            heap->allocating[sizeClass] = NULL;
+            heap->lastPage[sizeClass] = last;
+            heap->swept[sizeClass] = last;
+        }
+    }
+
+    heap->unsweptPages = 0;
+
+    for (int i = 0; i < heap->evacuatingCount; ++i) {
+        HeapPage *page = heap->evacuating[i];
+
+        for (int word = 0; word < HEAP_BITMAP_WORDS; ++word) {
+            uint64_t bits = page->live[word];
+
+            while (bits != 0) {
+                int bit = lowestBit(bits);
+                bits &= bits - 1;
+
+                Obj *object = (Obj *) ((char *) page + (word * 64 + bit) * HEAP_GRANULE);
+
+                if (page->marks[word] & BIT_MASK(bit)) {
+                    void *slot = evacuationSlot(heap, page->sizeClass);
+                    memcpy(slot, object, page->slotSize);
+                    *(void **) object = slot;
+                } else {
+                    freeObject(vm, object);
+                    vm->bytesAllocated -= page->slotSize;
+                }
+            }
+        }
+    }
+
+    for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; ++sizeClass) {
+        heap->allocating[sizeClass] = NULL;
+    }
+}
+
+void *heapForwardWeak(Heap *heap, void *object) {
+    HeapPage *page = HEAP_PAGE_OF(object);
+
+    if (bsearch(&page, heap->evacuating, heap->evacuatingCount, sizeof(HeapPage *), compareAddress) == NULL) {
+        return object;
+    }
+
+    return heapForward(object);
+}
+
+void heapVisitObjects(DictuVM *vm, void (*visit)(DictuVM *vm, Obj *object)) {
+    Heap *heap = &vm->heap;
+
+    for (int sizeClass = 0; sizeClass <= HEAP_SIZE_CLASSES; ++sizeClass) {
+        for (HeapPage *page = heap->pages[sizeClass]; page != NULL; page = page->next) {
+            if (page->evacuating) {
+                continue;
+            }
+
+            for (int word = 0; word < HEAP_BITMAP_WORDS; ++word) {
+                uint64_t bits = page->live[word];
+
+                while (bits != 0) {
+                    int bit = lowestBit(bits);
+                    bits &= bits - 1;
+
+                    visit(vm, (Obj *) ((char *) page + (word * 64 + bit) * HEAP_GRANULE));
+                }
+            }
+        }
+    }
+}
+
+void releaseEvacuated(DictuVM *vm) {
+    Heap *heap = &vm->heap;
+
+    for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; ++sizeClass) {
+        HeapPage **page = &heap->pages[sizeClass];
+        HeapPage *last = NULL;
+
+        while (*page != NULL) {
+            HeapPage *current = *page;
+
+            if (current->evacuating) {
+                *page = current->next;
+                freePage(heap, current, true);
+                continue;
+            }
+
+            last = current;
+            page = &current->next;
+        }
+
+        heap->lastPage[sizeClass] = last;
+        heap->swept[sizeClass] = last;
+    }
+
+    free(heap->evacuating);
+    heap->evacuating = NULL;
+    heap->evacuatingCount = 0;
+}
@@ -0,0 +1,188 @@
+#ifndef oolong_heap_h
+#define oolong_heap_h
+
+#include "dictu_include.h"
+#include "common.h"
+
+/*
+ * Objects are allocated from pages of HEAP_PAGE_SIZE bytes, each aligned
+ * to its size so the page of an object is found by masking its address.
+ * A page holds slots of a single size class and a bitmap of the slots in
+ * use, sweeping walks the pages and their bitmaps rather than chasing a
+ * list through every object. Objects too big for the largest class get
+ * a page of their own.
+ *
+ * Mark bits are kept in a bitmap allocated apart from each page, so a
+ * collection reads the objects it traces but writes only to the pages
+ * where something died. Pages are swept lazily, by the allocator as it
+ * needs their slots, so the pause of a collection is its marking.
+ */
+
+#define HEAP_PAGE_SIZE (64 * 1024)
+#define HEAP_GRANULE 16
+#define HEAP_SIZE_CLASSES 16
+#define HEAP_LARGE_OBJECT 512
+#define HEAP_BITMAP_WORDS (HEAP_PAGE_SIZE / HEAP_GRANULE / 64)
+
+#define HEAP_PAGE_OF(object) \
+    ((HeapPage *) ((uintptr_t) (object) & ~(uintptr_t) (HEAP_PAGE_SIZE - 1)))
+
+// Index of the granule an object starts at, its bit in the bitmaps.
+#define HEAP_BIT(page, object) \
+    ((size_t) ((char *) (object) - (char *) (page)) / HEAP_GRANULE)
+
+typedef struct sObj Obj;
+typedef struct sHeapPage HeapPage;
+
+struct sHeapPage {
+    HeapPage *next;
+
+    // HEAP_SIZE_CLASSES for a page holding a single large object.
+    int sizeClass;
+    int slotCount;
+    int liveCount;
+    size_t slotSize;
+    char *slots;
+
+    // Free slots of the page, linked through their first word.
+    void *freeSlots;
+
+    // Bit i is set while an object starts at granule i of the page.
+    uint64_t live[HEAP_BITMAP_WORDS];
+
+    // Objects reached by the current collection, laid out like live.
+    uint64_t *marks;
+
+    // Set while a compaction moves the objects out of the page, see
+    // compact.h.
+    bool evacuating;
+};
+
+typedef struct {
+    // Pages of each size class, large object pages last.
+    HeapPage *pages[HEAP_SIZE_CLASSES + 1];
+
+    // Page each size class allocates from, NULL before the first. New
+    // pages go on the end.
+    HeapPage *allocating[HEAP_SIZE_CLASSES];
+    HeapPage *lastPage[HEAP_SIZE_CLASSES];
+
+    // Last page of each class swept since the collection, NULL before
+    // the first. Pages are swept in order, by allocation as it reaches
+    // them and ahead of it in proportion to what it allocates, so the
+    // ones after this have not been.
+    HeapPage *swept[HEAP_SIZE_CLASSES];
+    int unsweptPages;
+    int sweepClass;
+
+    // Bytes to allocate per page swept ahead, and those allocated since
+    // the last one.
+    size_t sweepPace;
+    size_t sweepCredit;
+    size_t pageBytes;
+
+    // Bytes of small object pages a compaction could give back, as of
+    // the last collection.
+    size_t reclaimableBytes;
+
+    // Pages being evacuated by a compaction, sorted by address.
+    HeapPage **evacuating;
+    int evacuatingCount;
+} Heap;
+
+static inline bool heapIsMarked(void *object) {
+    HeapPage *page = HEAP_PAGE_OF(object);
+    size_t bit = HEAP_BIT(page, object);
+
+    return (page->marks[bit / 64] >> (bit % 64)) & 1;
+}
+
+// Marks object, returning false if it already was.
+static inline bool heapMark(void *object) {
+    HeapPage *page = HEAP_PAGE_OF(object);
+    size_t bit = HEAP_BIT(page, object);
+    uint64_t mask = (uint64_t) 1 << (bit % 64);
+
+    if (page->marks[bit / 64] & mask) {
+        return false;
+    }
+
+    page->marks[bit / 64] |= mask;
+    return true;
+}
+
+// heapMark for when other threads are marking too.
+static inline bool heapMarkAtomic(void *object) {
+    HeapPage *page = HEAP_PAGE_OF(object);
+    size_t bit = HEAP_BIT(page, object);
+    uint64_t mask = (uint64_t) 1 << (bit % 64);
+
+    if (__atomic_load_n(&page->marks[bit / 64], __ATOMIC_RELAXED) & mask) {
+        return false;
+    }
+
+    return !(__atomic_fetch_or(&page->marks[bit / 64], mask, __ATOMIC_RELAXED) & mask);
+}
+
+// Where object is now, following the forwarding address a compaction
+// left in its old slot if it was moved.
+static inline void *heapForward(void *object) {
+    HeapPage *page = HEAP_PAGE_OF(object);
+
+    if (!page->evacuating || !heapIsMarked(object)) {
+        return object;
+    }
+
+    return *(void **) object;
+}
+
+void initHeap(Heap *heap);
+
+// Bytes an object of the given size takes up on the heap.
+size_t heapSlotSize(size_t size);
+
+// Returns an uninitialised slot of at least size bytes, or NULL if no
+// page could be allocated.
+void *heapAllocate(DictuVM *vm, size_t size);
+
+// Sweeps the pages the last collection left unswept, so marking starts
+// from clear marks.
+void finishSweep(DictuVM *vm);
+
+// Starts sweeping once marking is done. Large objects are freed now,
+// pages of the size classes as allocation reaches them. Returns an
+// estimate of the bytes the dead objects left for later hold.
+//
+// vm->nextGC is lowered by what is freed afterwards, it was counted
+// when the threshold was set.
+size_t startSweep(DictuVM *vm);
+
+// Spreads the pages left to sweep over the next headroom bytes.
+void setSweepPace(Heap *heap, size_t headroom);
+
+// Sweeps ahead of allocation, called with the bytes just allocated
+// while pages are left to sweep.
+void paceSweep(DictuVM *vm, size_t bytes);
+
+// Picks the sparsest pages of each size class whose marked objects fit
+// in the free slots of the others. Returns the number picked.
+int selectEvacuation(DictuVM *vm);
+
+// Sweeps every page not picked, then moves the marked objects out of
+// the picked ones, leaving their new address in the old slot.
+void evacuatePages(DictuVM *vm);
+
+// heapForward for a reference that may be to an object already freed,
+// the page is looked up rather than read.
+void *heapForwardWeak(Heap *heap, void *object);
+
+// Calls visit with every object outside the pages being evacuated.
+void heapVisitObjects(DictuVM *vm, void (*visit)(DictuVM *vm, Obj *object));
+
+// Returns the evacuated pages to the system.
+void releaseEvacuated(DictuVM *vm);
+
+// Frees every object along with the pages themselves.
+void freeHeap(DictuVM *vm);
+
+#endif
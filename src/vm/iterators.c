@@ -0,0 +1,113 @@
+#include "iterators.h"
+#include "streams.h"
+#include "vm.h"
+
+bool iteratorStart(Value iterable, int *size) {
+    if (!IS_OBJ(iterable)) {
+        return false;
+    }
+
+    switch (OBJ_TYPE(iterable)) {
+        case OBJ_LIST:
+            *size = AS_LIST(iterable)->values.count;
+            return true;
+
+        case OBJ_STRING:
+            *size = AS_STRING(iterable)->length;
+            return true;
+
+        case OBJ_DICT:
+            *size = AS_DICT(iterable)->count;
+            return true;
+
+        case OBJ_SET:
+            *size = AS_SET(iterable)->count;
+            return true;
+
+        case OBJ_STREAM:
+            *size = 0;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+IteratorResult iteratorNext(DictuVM *vm, Value iterable, int *cursor, int size, Value *value) {
+    switch (OBJ_TYPE(iterable)) {
+        case OBJ_LIST: {
+            ObjList *list = AS_LIST(iterable);
+
+            if (list->values.count != size) {
+                runtimeError(vm, "List changed size during iteration.");
+                return ITERATOR_ERROR;
+            }
+
+            if (*cursor >= list->values.count) {
+                return ITERATOR_DONE;
+            }
+
+            *value = list->values.values[(*cursor)++];
+            return ITERATOR_VALUE;
+        }
+
+        case OBJ_STRING: {
+            ObjString *string = AS_STRING(iterable);
+
+            if (*cursor >= string->length) {
+                return ITERATOR_DONE;
+            }
+
+            *value = OBJ_VAL(copyString(vm, string->chars + *cursor, 1));
+            (*cursor)++;
+            return ITERATOR_VALUE;
+        }
+
+        case OBJ_DICT: {
+            ObjDict *dict = AS_DICT(iterable);
+
+            if (dict->count != size) {
+                runtimeError(vm, "Dict changed size during iteration.");
+                return ITERATOR_ERROR;
+            }
+
+            // Yields the keys, skipping empty buckets.
+            while (*cursor <= dict->capacityMask) {
+                DictItem *item = &dict->entries[(*cursor)++];
+
+                if (!IS_EMPTY(item->key)) {
+                    *value = item->key;
+                    return ITERATOR_VALUE;
+                }
+            }
+
+            return ITERATOR_DONE;
+        }
+
+        case OBJ_SET: {
+            ObjSet *set = AS_SET(iterable);
+
+            if (set->count != size) {
+                runtimeError(vm, "Set changed size during iteration.");
+                return ITERATOR_ERROR;
+            }
+
+            while (*cursor <= set->capacityMask) {
+                SetItem *item = &set->entries[(*cursor)++];
+
+                if (!IS_EMPTY(item->value) && !item->deleted) {
+                    *value = item->value;
+                    return ITERATOR_VALUE;
+                }
+            }
+
+            return ITERATOR_DONE;
+        }
+
+        case OBJ_STREAM:
+            return streamNext(vm, AS_STREAM(iterable), value);
+
+        default:
+            return ITERATOR_DONE;
+    }
+}
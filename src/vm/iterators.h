@@ -0,0 +1,19 @@
+#ifndef oolong_iterators_h
+#define oolong_iterators_h
+
+#include "object.h"
+
+typedef enum {
+    ITERATOR_VALUE,
+    ITERATOR_DONE,
+    ITERATOR_ERROR
+} IteratorResult;
+
+// Native iteration over lists, strings, dicts, sets and streams. The cursor is
+// an index into the backing array and size the element count captured
+// by iteratorStart, used to detect modification during iteration.
+bool iteratorStart(Value iterable, int *size);
+
+IteratorResult iteratorNext(DictuVM *vm, Value iterable, int *cursor, int size, Value *value);
+
+#endif
@@ -13,11 +13,6 @@
 #include "list-source.h"
 
 static Value toStringList(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "toString() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     char *valueString = listToString(args[0]);
 
     ObjString *string = copyString(vm, valueString, strlen(valueString));
@@ -27,26 +22,11 @@ static Value toStringList(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value lenList(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "len() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList *list = AS_LIST(args[0]);
-    return NUMBER_VAL(list->values.count);
+    return INT_VAL(list->values.count);
 }
 
 static Value extendList(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "extend() takes 1 argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_LIST(args[1])) {
-        runtimeError(vm, "extend() argument must be a list");
-        return EMPTY_VAL;
-    }
-
     ObjList *list = AS_LIST(args[0]);
     ObjList *listArgument = AS_LIST(args[1]);
 
@@ -58,11 +38,6 @@ static Value extendList(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value pushListItem(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "push() takes 1 argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList *list = AS_LIST(args[0]);
     writeValueArray(vm, &list->values, args[1]);
 
@@ -70,16 +45,6 @@ static Value pushListItem(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value insertListItem(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 2) {
-        runtimeError(vm, "insert() takes 2 arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[2])) {
-        runtimeError(vm, "insert() second argument must be a number");
-        return EMPTY_VAL;
-    }
-
     ObjList *list = AS_LIST(args[0]);
     Value insertValue = args[1];
     int index = AS_NUMBER(args[2]);
@@ -91,9 +56,10 @@ static Value insertListItem(DictuVM *vm, int argCount, Value *args) {
 
     if (list->values.capacity < list->values.count + 1) {
         int oldCapacity = list->values.capacity;
-        list->values.capacity = GROW_CAPACITY(oldCapacity);
+        int capacity = GROW_CAPACITY(oldCapacity);
         list->values.values = GROW_ARRAY(vm, list->values.values, Value,
-                                         oldCapacity, list->values.capacity);
+                                         oldCapacity, capacity);
+        list->values.capacity = capacity;
     }
 
     list->values.count++;
@@ -108,11 +74,6 @@ static Value insertListItem(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value popListItem(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0 && argCount != 1) {
-        runtimeError(vm, "pop() takes either 0 or 1 arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList *list = AS_LIST(args[0]);
 
     if (list->values.count == 0) {
@@ -123,11 +84,6 @@ static Value popListItem(DictuVM *vm, int argCount, Value *args) {
     Value element;
 
     if (argCount == 1) {
-        if (!IS_NUMBER(args[1])) {
-            runtimeError(vm, "pop() index argument must be a number");
-            return EMPTY_VAL;
-        }
-
         int index = AS_NUMBER(args[1]);
 
         if (index < 0 || index > list->values.count) {
@@ -150,11 +106,6 @@ static Value popListItem(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value removeListItem(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "remove() takes 1 argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList *list = AS_LIST(args[0]);
     Value remove = args[1];
     bool found = false;
@@ -196,11 +147,6 @@ static Value removeListItem(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value containsListItem(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "contains() takes 1 argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList *list = AS_LIST(args[0]);
     Value search = args[1];
 
@@ -214,11 +160,6 @@ static Value containsListItem(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value joinListItem(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0 && argCount != 1) {
-        runtimeError(vm, "join() takes 1 optional argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList *list = AS_LIST(args[0]);
 
     if (list->values.count == 0) {
@@ -228,11 +169,6 @@ static Value joinListItem(DictuVM *vm, int argCount, Value *args) {
     char *delimiter = ", ";
 
     if (argCount == 1) {
-        if (!IS_STRING(args[1])) {
-            runtimeError(vm, "join() only takes a string as an argument");
-            return EMPTY_VAL;
-        }
-
         delimiter = AS_CSTRING(args[1]);
     }
 
@@ -282,22 +218,12 @@ static Value joinListItem(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value copyListShallow(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "copy() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList *oldList = AS_LIST(args[0]);
     ObjList *list = copyList(vm, oldList, true);
     return OBJ_VAL(list);
 }
 
 static Value copyListDeep(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "deepCopy() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList *oldList = AS_LIST(args[0]);
     ObjList *list = copyList(vm, oldList, false);
 
@@ -356,11 +282,6 @@ static void quickSort(ObjList* arr, int start, int end) {
 }
 
 static Value sortList(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "sort() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList* list = AS_LIST(args[0]);
 
     // Check if all the list elements are indeed numbers.
@@ -377,11 +298,6 @@ static Value sortList(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value reverseList(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "reverse() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjList* list = AS_LIST(args[0]);
     int listLength = list->values.count;
 
@@ -395,20 +311,20 @@ static Value reverseList(DictuVM *vm, int argCount, Value *args) {
 }
 
 void declareListMethods(DictuVM *vm) {
-    defineNative(vm, &vm->listMethods, "toString", toStringList);
-    defineNative(vm, &vm->listMethods, "len", lenList);
-    defineNative(vm, &vm->listMethods, "extend", extendList);
-    defineNative(vm, &vm->listMethods, "push", pushListItem);
-    defineNative(vm, &vm->listMethods, "insert", insertListItem);
-    defineNative(vm, &vm->listMethods, "pop", popListItem);
-    defineNative(vm, &vm->listMethods, "remove", removeListItem);
-    defineNative(vm, &vm->listMethods, "contains", containsListItem);
-    defineNative(vm, &vm->listMethods, "join", joinListItem);
-    defineNative(vm, &vm->listMethods, "copy", copyListShallow);
-    defineNative(vm, &vm->listMethods, "deepCopy", copyListDeep);
+    defineTypedNative(vm, &vm->listMethods, "toString", toStringList, "");
+    defineTypedNative(vm, &vm->listMethods, "len", lenList, "");
+    defineTypedNative(vm, &vm->listMethods, "extend", extendList, "l");
+    defineTypedNative(vm, &vm->listMethods, "push", pushListItem, ".");
+    defineTypedNative(vm, &vm->listMethods, "insert", insertListItem, ".n");
+    defineTypedNative(vm, &vm->listMethods, "pop", popListItem, "|n");
+    defineTypedNative(vm, &vm->listMethods, "remove", removeListItem, ".");
+    defineTypedNative(vm, &vm->listMethods, "contains", containsListItem, ".");
+    defineTypedNative(vm, &vm->listMethods, "join", joinListItem, "|s");
+    defineTypedNative(vm, &vm->listMethods, "copy", copyListShallow, "");
+    defineTypedNative(vm, &vm->listMethods, "deepCopy", copyListDeep, "");
     defineNative(vm, &vm->listMethods, "toBool", boolNative); // Defined in util
-    defineNative(vm, &vm->listMethods, "sort", sortList);
-    defineNative(vm, &vm->listMethods, "reverse", reverseList);
+    defineTypedNative(vm, &vm->listMethods, "sort", sortList, "");
+    defineTypedNative(vm, &vm->listMethods, "reverse", reverseList, "");
     
     dictuInterpret(vm, "List", DICTU_LIST_SOURCE);
     
@@ -0,0 +1,372 @@
+#include <string.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include "mark.h"
+#include "memory.h"
+#include "vm.h"
+
+THREAD_LOCAL Marker *currentMarker = NULL;
+
+void initMarker(Marker *marker) {
+    marker->objects = NULL;
+    marker->count = 0;
+    marker->capacity = 0;
+    marker->parallel = false;
+    marker->share = NULL;
+}
+
+void freeMarker(Marker *marker) {
+    free(marker->objects);
+    initMarker(marker);
+}
+
+static void drainMarker(DictuVM *vm, Marker *marker) {
+    while (marker->count > 0) {
+        // Pop an item from the gray stack.
+        Obj *object = marker->objects[--marker->count];
+        blackenObject(vm, object);
+    }
+}
+
+#ifdef _WIN32
+
+int defaultMarkThreads(void) {
+    return 1;
+}
+
+void markObjects(DictuVM *vm) {
+    drainMarker(vm, &vm->marker);
+}
+
+void freeMarkPool(DictuVM *vm) {
+    UNUSED(vm);
+}
+
+#else
+
+int defaultMarkThreads(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (count < 1) {
+        return 1;
+    }
+
+    return count > GC_MARK_THREADS_MAX ? GC_MARK_THREADS_MAX : (int) count;
+}
+
+// Objects a thread keeps to itself before offering half to the others.
+#define SHARE_MIN 64
+
+struct sMarkShare {
+    MarkPool *pool;
+    pthread_mutex_t lock;
+    Obj **objects;
+    int count;
+    int capacity;
+
+    // count, readable without taking the lock.
+    int available;
+};
+
+struct sMarkPool {
+    DictuVM *vm;
+
+    // Threads taking part, the collecting thread included. Helpers
+    // have the markers and every thread a share, the collecting
+    // thread's first.
+    int threadCount;
+    pthread_t *threads;
+    Marker *markers;
+    MarkShare *shares;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned generation;
+    int finished;
+    bool stopping;
+
+    // Threads out of work, marking is over once all of them are.
+    int idle;
+};
+
+// Moves the newest half of a thread's stack to its share.
+static void offerWork(Marker *marker) {
+    MarkShare *share = marker->share;
+    int half = marker->count / 2;
+
+    pthread_mutex_lock(&share->lock);
+
+    if (share->capacity < share->count + half) {
+        share->capacity = share->count + half;
+        share->objects = realloc(share->objects, sizeof(Obj *) * share->capacity);
+    }
+
+    memcpy(share->objects + share->count, marker->objects + marker->count - half, sizeof(Obj *) * half);
+    share->count += half;
+    marker->count -= half;
+    __atomic_store_n(&share->available, share->count, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&share->lock);
+}
+
+static bool takeWork(Marker *marker, MarkShare *share) {
+    if (__atomic_load_n(&share->available, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&share->lock);
+
+    int count = share->count;
+    for (int i = 0; i < count; ++i) {
+        markerPush(marker, share->objects[i]);
+    }
+
+    share->count = 0;
+    __atomic_store_n(&share->available, 0, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&share->lock);
+
+    return count > 0;
+}
+
+static bool stealWork(MarkPool *pool, Marker *marker) {
+    int self = (int) (marker->share - pool->shares);
+
+    for (int i = 1; i < pool->threadCount; ++i) {
+        MarkShare *victim = &pool->shares[(self + i) % pool->threadCount];
+
+        if (takeWork(marker, victim)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool workAvailable(MarkPool *pool) {
+    for (int i = 0; i < pool->threadCount; ++i) {
+        if (__atomic_load_n(&pool->shares[i].available, __ATOMIC_ACQUIRE) > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void markLoop(MarkPool *pool, Marker *marker) {
+    for (;;) {
+        while (marker->count > 0) {
+            Obj *object = marker->objects[--marker->count];
+            blackenObject(pool->vm, object);
+
+            if (marker->count >= SHARE_MIN &&
+                __atomic_load_n(&marker->share->available, __ATOMIC_RELAXED) == 0) {
+                offerWork(marker);
+            }
+        }
+
+        if (takeWork(marker, marker->share) || stealWork(pool, marker)) {
+            continue;
+        }
+
+        // A thread only adds to its own share and goes idle with it
+        // empty, so once every thread is idle no work is left anywhere.
+        // One looking to steal counts as busy until it has failed.
+        __atomic_fetch_add(&pool->idle, 1, __ATOMIC_ACQ_REL);
+
+        for (;;) {
+            if (__atomic_load_n(&pool->idle, __ATOMIC_ACQUIRE) == pool->threadCount) {
+                return;
+            }
+
+            if (workAvailable(pool)) {
+                __atomic_fetch_sub(&pool->idle, 1, __ATOMIC_ACQ_REL);
+
+                if (stealWork(pool, marker)) {
+                    break;
+                }
+
+                __atomic_fetch_add(&pool->idle, 1, __ATOMIC_ACQ_REL);
+            }
+
+            sched_yield();
+        }
+    }
+}
+
+static void *markThread(void *argument) {
+    Marker *marker = (Marker *) argument;
+    MarkPool *pool = marker->share->pool;
+    unsigned generation = 0;
+
+    currentMarker = marker;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (;;) {
+        while (pool->generation == generation && !pool->stopping) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+
+        if (pool->stopping) {
+            break;
+        }
+
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        markLoop(pool, marker);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->finished++;
+        pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void initShare(MarkPool *pool, MarkShare *share) {
+    share->pool = pool;
+    pthread_mutex_init(&share->lock, NULL);
+    share->objects = NULL;
+    share->count = 0;
+    share->capacity = 0;
+    share->available = 0;
+}
+
+static MarkPool *startMarkPool(DictuVM *vm, int threadCount) {
+    MarkPool *pool = malloc(sizeof(MarkPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->vm = vm;
+    pool->threadCount = 1;
+    pool->threads = malloc(sizeof(pthread_t) * threadCount);
+    pool->markers = malloc(sizeof(Marker) * threadCount);
+    pool->shares = malloc(sizeof(MarkShare) * threadCount);
+    pool->generation = 0;
+    pool->finished = 0;
+    pool->stopping = false;
+    pool->idle = 0;
+
+    if (pool->threads == NULL || pool->markers == NULL || pool->shares == NULL) {
+        free(pool->threads);
+        free(pool->markers);
+        free(pool->shares);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    initShare(pool, &pool->shares[0]);
+
+    // Helpers that fail to start are simply left out.
+    for (int i = 1; i < threadCount; ++i) {
+        Marker *marker = &pool->markers[i];
+        initMarker(marker);
+        marker->parallel = true;
+        marker->share = &pool->shares[i];
+        initShare(pool, marker->share);
+
+        if (pthread_create(&pool->threads[i], NULL, markThread, marker) != 0) {
+            pthread_mutex_destroy(&marker->share->lock);
+            break;
+        }
+
+        pool->threadCount++;
+    }
+
+    return pool;
+}
+
+void markObjects(DictuVM *vm) {
+    int threadCount = vm->markThreads;
+    if (threadCount > GC_MARK_THREADS_MAX) {
+        threadCount = GC_MARK_THREADS_MAX;
+    }
+
+    if (threadCount <= 1 || vm->bytesAllocated < GC_PARALLEL_MARK_MIN) {
+        drainMarker(vm, &vm->marker);
+        return;
+    }
+
+    if (vm->markPool == NULL) {
+        vm->markPool = startMarkPool(vm, threadCount);
+
+        if (vm->markPool == NULL) {
+            drainMarker(vm, &vm->marker);
+            return;
+        }
+    }
+
+    MarkPool *pool = vm->markPool;
+    vm->marker.parallel = true;
+    vm->marker.share = &pool->shares[0];
+
+    pthread_mutex_lock(&pool->lock);
+    pool->idle = 0;
+    pool->finished = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    markLoop(pool, &vm->marker);
+
+    // Helpers may still be watching for work, wait until they are done
+    // before anything else touches the heap.
+    pthread_mutex_lock(&pool->lock);
+    while (pool->finished < pool->threadCount - 1) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    vm->marker.parallel = false;
+    vm->marker.share = NULL;
+}
+
+void freeMarkPool(DictuVM *vm) {
+    MarkPool *pool = vm->markPool;
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->threadCount; ++i) {
+        pthread_join(pool->threads[i], NULL);
+        freeMarker(&pool->markers[i]);
+    }
+
+    for (int i = 0; i < pool->threadCount; ++i) {
+        pthread_mutex_destroy(&pool->shares[i].lock);
+        free(pool->shares[i].objects);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+
+    free(pool->threads);
+    free(pool->markers);
+    free(pool->shares);
+    free(pool);
+
+    vm->markPool = NULL;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef oolong_mark_h
+#define oolong_mark_h
+
+#include <stdlib.h>
+
+#include "dictu_include.h"
+#include "common.h"
+
+/*
+ * Marking drains a stack of objects that are marked but not yet traced.
+ * On a large heap the drain is split across helper threads while the
+ * mutator stays stopped: each thread traces from its own stack, offers
+ * half of it to the others when it grows and steals from them when it
+ * runs dry. Mark bits are then set atomically, see heapMarkAtomic.
+ */
+
+// Threads marking at most, the collecting thread included.
+#define GC_MARK_THREADS_MAX 8
+
+// Live bytes below which marking stays on the collecting thread.
+#define GC_PARALLEL_MARK_MIN (16 * 1024 * 1024)
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+typedef struct sObj Obj;
+typedef struct sMarkShare MarkShare;
+typedef struct sMarkPool MarkPool;
+
+typedef struct {
+    Obj **objects;
+    int count;
+    int capacity;
+
+    // Set while marking in parallel.
+    bool parallel;
+
+    // Work offered to other threads, NULL when marking alone.
+    MarkShare *share;
+} Marker;
+
+// Marker of a helper thread, NULL on any other thread.
+extern THREAD_LOCAL Marker *currentMarker;
+
+// One thread per processor online, GC_MARK_THREADS_MAX at most.
+int defaultMarkThreads(void);
+
+void initMarker(Marker *marker);
+
+void freeMarker(Marker *marker);
+
+static inline void markerPush(Marker *marker, Obj *object) {
+    if (marker->capacity < marker->count + 1) {
+        marker->capacity = marker->capacity < 8 ? 8 : marker->capacity * 2;
+
+        // Not using reallocate() here because we don't want to trigger the
+        // GC inside a GC!
+        marker->objects = realloc(marker->objects, sizeof(Obj *) * marker->capacity);
+    }
+
+    marker->objects[marker->count++] = object;
+}
+
+// Traces everything reachable from the objects on vm's marker.
+void markObjects(DictuVM *vm);
+
+// Stops the helper threads, if any were started.
+void freeMarkPool(DictuVM *vm);
+
+#endif
@@ -26,64 +26,19 @@ static Value averageNative(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value floorNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "floor() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to floor()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(floor(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_FLOOR, AS_NUMBER(args[0])));
 }
 
 static Value roundNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "round() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to round()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(round(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_ROUND, AS_NUMBER(args[0])));
 }
 
 static Value ceilNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "ceil() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to ceil()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(ceil(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_CEIL, AS_NUMBER(args[0])));
 }
 
 static Value absNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "abs() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to abs()");
-        return EMPTY_VAL;
-    }
-
-    double absValue = AS_NUMBER(args[0]);
-
-    if (absValue < 0)
-        return NUMBER_VAL(absValue * -1);
-
-    return NUMBER_VAL(absValue);
+    return NUMBER_VAL(mathUnary(MATH_ABS, AS_NUMBER(args[0])));
 }
 
 static Value maxNative(DictuVM *vm, int argCount, Value *args) {
@@ -166,101 +121,31 @@ static Value sumNative(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value sqrtNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "sqrt() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to sqrt()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(sqrt(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_SQRT, AS_NUMBER(args[0])));
 }
 
 static Value sinNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "sin() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to sin()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(sin(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_SIN, AS_NUMBER(args[0])));
 }
 
 static Value cosNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "cos() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to cos()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(cos(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_COS, AS_NUMBER(args[0])));
 }
 
 static Value tanNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "tan() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to tan()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(tan(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_TAN, AS_NUMBER(args[0])));
 }
 
 static Value asinNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "asin() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to asin()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(asin(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_ASIN, AS_NUMBER(args[0])));
 }
 
 static Value acosNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "acos() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to acos()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(acos(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_ACOS, AS_NUMBER(args[0])));
 }
 
 static Value atanNative(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "atan() takes 1 argument (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[0])) {
-        runtimeError(vm, "A non-number value passed to atan()");
-        return EMPTY_VAL;
-    }
-
-    return NUMBER_VAL(atan(AS_NUMBER(args[0])));
+    return NUMBER_VAL(mathUnary(MATH_ATAN, AS_NUMBER(args[0])));
 }
 
 static long long gcd(long long a, long long b) {
@@ -277,30 +162,55 @@ long long lcm(long long a, long long b) {
     return (a * b) / gcd(a, b);
 }
 
+static const char *mathFunctionNames[] = {
+    [MATH_FLOOR] = "floor",
+    [MATH_ROUND] = "round",
+    [MATH_CEIL] = "ceil",
+    [MATH_ABS] = "abs",
+    [MATH_SQRT] = "sqrt",
+    [MATH_SIN] = "sin",
+    [MATH_COS] = "cos",
+    [MATH_TAN] = "tan",
+    [MATH_ASIN] = "asin",
+    [MATH_ACOS] = "acos",
+    [MATH_ATAN] = "atan",
+};
+
+int findMathFunction(const char *name, int length) {
+    for (int i = 0; i < (int) (sizeof(mathFunctionNames) / sizeof(mathFunctionNames[0])); ++i) {
+        if ((int) strlen(mathFunctionNames[i]) == length && memcmp(mathFunctionNames[i], name, length) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 Value createMathsModule(DictuVM *vm) {
     ObjString *name = copyString(vm, "Math", 4);
     push(vm, OBJ_VAL(name));
     ObjModule *module = newModule(vm, name);
     push(vm, OBJ_VAL(module));
+    vm->mathModule = module;
 
     /**
      * Define Math methods
      */
     defineNative(vm, &module->values, "average", averageNative);
-    defineNative(vm, &module->values, "floor", floorNative);
-    defineNative(vm, &module->values, "round", roundNative);
-    defineNative(vm, &module->values, "ceil", ceilNative);
-    defineNative(vm, &module->values, "abs", absNative);
+    defineTypedNative(vm, &module->values, "floor", floorNative, "n");
+    defineTypedNative(vm, &module->values, "round", roundNative, "n");
+    defineTypedNative(vm, &module->values, "ceil", ceilNative, "n");
+    defineTypedNative(vm, &module->values, "abs", absNative, "n");
     defineNative(vm, &module->values, "max", maxNative);
     defineNative(vm, &module->values, "min", minNative);
     defineNative(vm, &module->values, "sum", sumNative);
-    defineNative(vm, &module->values, "sqrt", sqrtNative);
-    defineNative(vm, &module->values, "sin", sinNative);
-    defineNative(vm, &module->values, "cos", cosNative);
-    defineNative(vm, &module->values, "tan", tanNative);
-    defineNative(vm, &module->values, "asin", asinNative);
-    defineNative(vm, &module->values, "acos", acosNative);
-    defineNative(vm, &module->values, "atan", atanNative);
+    defineTypedNative(vm, &module->values, "sqrt", sqrtNative, "n");
+    defineTypedNative(vm, &module->values, "sin", sinNative, "n");
+    defineTypedNative(vm, &module->values, "cos", cosNative, "n");
+    defineTypedNative(vm, &module->values, "tan", tanNative, "n");
+    defineTypedNative(vm, &module->values, "asin", asinNative, "n");
+    defineTypedNative(vm, &module->values, "acos", acosNative, "n");
+    defineTypedNative(vm, &module->values, "atan", atanNative, "n");
 
     /**
      * Define Math properties
@@ -9,6 +9,42 @@
 
 #define FLOAT_TOLERANCE 0.00001
 
+// The one argument Math functions, OP_MATH_UNARY calls them directly.
+typedef enum {
+    MATH_FLOOR,
+    MATH_ROUND,
+    MATH_CEIL,
+    MATH_ABS,
+    MATH_SQRT,
+    MATH_SIN,
+    MATH_COS,
+    MATH_TAN,
+    MATH_ASIN,
+    MATH_ACOS,
+    MATH_ATAN
+} MathFunction;
+
+static inline double mathUnary(MathFunction function, double value) {
+    switch (function) {
+        case MATH_FLOOR: return floor(value);
+        case MATH_ROUND: return round(value);
+        case MATH_CEIL: return ceil(value);
+        case MATH_ABS: return value < 0 ? -value : value;
+        case MATH_SQRT: return sqrt(value);
+        case MATH_SIN: return sin(value);
+        case MATH_COS: return cos(value);
+        case MATH_TAN: return tan(value);
+        case MATH_ASIN: return asin(value);
+        case MATH_ACOS: return acos(value);
+        case MATH_ATAN: return atan(value);
+    }
+
+    return value;
+}
+
+// Returns the MathFunction called name, or -1.
+int findMathFunction(const char *name, int length);
+
 Value createMathsModule(DictuVM *vm);
 
 #endif //dictu_math_h
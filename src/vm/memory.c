@@ -1,16 +1,189 @@
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #include "common.h"
+#include "compact.h"
 #include "compiler.h"
+#include "mark.h"
 #include "memory.h"
 #include "vm.h"
+#include "abstracts.h"
+#include "weak.h"
 
 #ifdef DEBUG_TRACE_GC
-#include <stdio.h>
 #include "debug.h"
 #endif
 
-#define GC_HEAP_GROW_FACTOR 2
+// Size of a huge page, see allocateZeroed.
+#define ZEROED_HUGE_MIN (2 * 1024 * 1024)
+
+#define GC_MIN_HEAP (4 * 1024 * 1024)
+#define GC_TARGET 0.05
+
+// Bounds of the growth between collections, as a share of what
+// survived the last.
+#define GC_GROWTH_MIN 0.5
+#define GC_GROWTH_MAX 4.0
+
+void dictuDefaultGCOptions(DictuGCOptions *options) {
+    static const char *const variables[][2] = {
+        {"OOLONG_GC_MIN_HEAP", "min-heap"},
+        {"OOLONG_GC_MAX_HEAP", "max-heap"},
+        {"OOLONG_GC_TARGET", "target"},
+        {"OOLONG_GC_THREADS", "threads"},
+        {"OOLONG_GC_COMPACT", "compact"}
+    };
+
+    options->minHeap = GC_MIN_HEAP;
+    options->maxHeap = 0;
+    options->target = GC_TARGET;
+    options->markThreads = 0;
+    options->compact = true;
+
+    for (size_t i = 0; i < sizeof(variables) / sizeof(variables[0]); ++i) {
+        const char *value = getenv(variables[i][0]);
+
+        if (value != NULL && !dictuSetGCOption(options, variables[i][1], value)) {
+            fprintf(stderr, "Ignoring invalid %s=%s\n", variables[i][0], value);
+        }
+    }
+}
+
+// A size in bytes with an optional K, M or G suffix.
+static bool parseSize(const char *value, size_t *size) {
+    char *end;
+    double number = strtod(value, &end);
+
+    switch (*end) {
+        case 'k': case 'K': number *= 1024; end++; break;
+        case 'm': case 'M': number *= 1024 * 1024; end++; break;
+        case 'g': case 'G': number *= 1024 * 1024 * 1024; end++; break;
+    }
+
+    if (end == value || *end != '\0' || !(number >= 0) || number >= (double) SIZE_MAX) {
+        return false;
+    }
+
+    *size = (size_t) number;
+    return true;
+}
+
+bool dictuSetGCOption(DictuGCOptions *options, const char *name, const char *value) {
+    char *end;
+
+    if (strcmp(name, "min-heap") == 0) {
+        return parseSize(value, &options->minHeap);
+    }
+
+    if (strcmp(name, "max-heap") == 0) {
+        return parseSize(value, &options->maxHeap);
+    }
+
+    if (strcmp(name, "target") == 0) {
+        double target = strtod(value, &end);
+
+        if (end == value || *end != '\0' || !(target >= 0 && target < 1)) {
+            return false;
+        }
+
+        options->target = target;
+        return true;
+    }
+
+    if (strcmp(name, "threads") == 0) {
+        long threads = strtol(value, &end, 10);
+
+        if (end == value || *end != '\0' || threads < 0 || threads > GC_MARK_THREADS_MAX) {
+            return false;
+        }
+
+        options->markThreads = (int) threads;
+        return true;
+    }
+
+    if (strcmp(name, "compact") == 0) {
+        if (strcmp(value, "0") != 0 && strcmp(value, "1") != 0) {
+            return false;
+        }
+
+        options->compact = value[0] == '1';
+        return true;
+    }
+
+    return false;
+}
+
+double gcClock(void) {
+    struct timespec now;
+
+#ifdef _WIN32
+    timespec_get(&now, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Reports an allocation of size bytes that cannot be made, taking the
+// bytes counted for it back off, and unwinds to the call that entered
+// the VM, see vm->memoryError. Outside of one there is nothing to
+// unwind to.
+static void outOfMemory(DictuVM *vm, size_t size, size_t counted) {
+    if (vm->maxHeap > 0 && vm->bytesAllocated > vm->maxHeap) {
+        fprintf(stderr, "Out of memory, the heap limit of %zu bytes was reached.\n\n", vm->maxHeap);
+    } else {
+        fprintf(stderr, "Out of memory, unable to allocate %zu bytes.\n\n", size);
+    }
+
+    vm->bytesAllocated -= counted;
+
+    if (vm->memoryError == NULL) {
+        exit(71);
+    }
+
+    longjmp(*vm->memoryError, 1);
+}
+
+// Collects garbage once the heap passes its threshold. Past the limit
+// the objects left for lazy sweeping are freed too, an allocation still
+// over it fails unless nothing could unwind from it.
+static inline void collectIfDue(DictuVM *vm, size_t size, size_t counted) {
+    if (vm->bytesAllocated > vm->nextGC) {
+        collectGarbage(vm);
+    }
+
+    if (vm->maxHeap > 0 && vm->bytesAllocated > vm->maxHeap) {
+        finishSweep(vm);
+
+        if (vm->bytesAllocated > vm->maxHeap && vm->memoryError != NULL) {
+            outOfMemory(vm, size, counted);
+        }
+    }
+}
+
+// Frees all the collector can before retrying an allocation the system
+// refused.
+static void releaseMemory(DictuVM *vm) {
+    collectGarbage(vm);
+    finishSweep(vm);
+
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
 
 void *reallocate(DictuVM *vm, void *previous, size_t oldSize, size_t newSize) {
     vm->bytesAllocated += newSize - oldSize;
@@ -20,13 +193,15 @@ void *reallocate(DictuVM *vm, void *previous, size_t oldSize, size_t newSize) {
 #endif
 
     if (newSize > oldSize) {
+        if (vm->heap.unsweptPages > 0) {
+            paceSweep(vm, newSize - oldSize);
+        }
+
 #ifdef DEBUG_STRESS_GC
         collectGarbage(vm);
 #endif
 
-        if (vm->bytesAllocated > vm->nextGC) {
-            collectGarbage(vm);
-        }
+        collectIfDue(vm, newSize, newSize - oldSize);
     }
 
     if (newSize == 0) {
@@ -34,14 +209,103 @@ void *reallocate(DictuVM *vm, void *previous, size_t oldSize, size_t newSize) {
         return NULL;
     }
 
-    return realloc(previous, newSize);
+    void *result = realloc(previous, newSize);
+
+    if (result == NULL) {
+        releaseMemory(vm);
+        result = realloc(previous, newSize);
+
+        if (result == NULL) {
+            outOfMemory(vm, newSize, newSize - oldSize);
+        }
+    }
+
+    return result;
+}
+
+void *allocateZeroed(DictuVM *vm, size_t size) {
+    vm->bytesAllocated += size;
+
+#ifdef DEBUG_TRACE_MEM
+    printf("Total bytes allocated: %zu\nNew zeroed allocation: %zu\n\n", vm->bytesAllocated, size);
+#endif
+
+    if (vm->heap.unsweptPages > 0) {
+        paceSweep(vm, size);
+    }
+
+#ifdef DEBUG_STRESS_GC
+    collectGarbage(vm);
+#endif
+
+    collectIfDue(vm, size, size);
+
+    void *result = calloc(1, size);
+
+    if (result == NULL) {
+        releaseMemory(vm);
+        result = calloc(1, size);
+
+        if (result == NULL) {
+            outOfMemory(vm, size, size);
+        }
+    }
+
+#ifdef MADV_HUGEPAGE
+    // Each page is faulted in by whatever first writes to it. For a large
+    // block that is fewer, longer faults in huge pages, not one every 4KB.
+    if (size >= ZEROED_HUGE_MIN) {
+        uintptr_t start = ((uintptr_t) result + ZEROED_HUGE_MIN - 1) & ~(uintptr_t) (ZEROED_HUGE_MIN - 1);
+        uintptr_t end = ((uintptr_t) result + size) & ~(uintptr_t) (ZEROED_HUGE_MIN - 1);
+
+        if (end > start) {
+            madvise((void *) start, end - start, MADV_HUGEPAGE);
+        }
+    }
+#endif
+
+    return result;
+}
+
+void *allocateObjectMemory(DictuVM *vm, size_t size) {
+    size_t slotSize = heapSlotSize(size);
+    vm->bytesAllocated += slotSize;
+
+#ifdef DEBUG_TRACE_MEM
+    printf("Total bytes allocated: %zu\nNew object: %zu\n\n", vm->bytesAllocated, size);
+#endif
+
+    if (vm->heap.unsweptPages > 0) {
+        paceSweep(vm, slotSize);
+    }
+
+#ifdef DEBUG_STRESS_GC
+    collectGarbage(vm);
+#endif
+
+    collectIfDue(vm, size, slotSize);
+
+    void *object = heapAllocate(vm, size);
+
+    if (object == NULL) {
+        releaseMemory(vm);
+        object = heapAllocate(vm, size);
+
+        if (object == NULL) {
+            outOfMemory(vm, size, slotSize);
+        }
+    }
+
+    return object;
 }
 
 void grayObject(DictuVM *vm, Obj *object) {
     if (object == NULL) return;
 
+    Marker *marker = currentMarker != NULL ? currentMarker : &vm->marker;
+
     // Don't get caught in cycle.
-    if (object->isDark) return;
+    if (!(marker->parallel ? heapMarkAtomic(object) : heapMark(object))) return;
 
 #ifdef DEBUG_TRACE_GC
     printf("%p gray ", (void *)object);
@@ -49,18 +313,7 @@ void grayObject(DictuVM *vm, Obj *object) {
     printf("\n");
 #endif
 
-    object->isDark = true;
-
-    if (vm->grayCapacity < vm->grayCount + 1) {
-        vm->grayCapacity = GROW_CAPACITY(vm->grayCapacity);
-
-        // Not using reallocate() here because we don't want to trigger the
-        // GC inside a GC!
-        vm->grayStack = realloc(vm->grayStack,
-                               sizeof(Obj *) * vm->grayCapacity);
-    }
-
-    vm->grayStack[vm->grayCount++] = object;
+    markerPush(marker, object);
 }
 
 void grayValue(DictuVM *vm, Value value) {
@@ -74,7 +327,7 @@ static void grayArray(DictuVM *vm, ValueArray *array) {
     }
 }
 
-static void blackenObject(DictuVM *vm, Obj *object) {
+void blackenObject(DictuVM *vm, Obj *object) {
 #ifdef DEBUG_TRACE_GC
     printf("%p blacken ", (void *)object);
     printValue(OBJ_VAL(object));
@@ -174,13 +427,24 @@ static void blackenObject(DictuVM *vm, Obj *object) {
             break;
         }
 
+        case OBJ_STREAM: {
+            ObjStream *stream = (ObjStream *) object;
+            grayValue(vm, stream->source);
+            for (int i = 0; i < stream->stageCount; ++i) {
+                grayValue(vm, stream->stages[i].value);
+            }
+            break;
+        }
+
         case OBJ_NATIVE:
         case OBJ_STRING:
         case OBJ_FILE:
+        case OBJ_BIGINT:
             break;
     }
 }
 
+// Frees what an object owns, its slot is released by the heap.
 void freeObject(DictuVM *vm, Obj *object) {
 #ifdef DEBUG_TRACE_GC
     printf("%p free type %d\n", (void*)object, object->type);
@@ -190,12 +454,6 @@ void freeObject(DictuVM *vm, Obj *object) {
         case OBJ_MODULE: {
             ObjModule *module = (ObjModule *) object;
             freeTable(vm, &module->values);
-            FREE(vm, ObjModule, object);
-            break;
-        }
-
-        case OBJ_BOUND_METHOD: {
-            FREE(vm, ObjBoundMethod, object);
             break;
         }
 
@@ -206,21 +464,18 @@ void freeObject(DictuVM *vm, Obj *object) {
             freeTable(vm, &klass->abstractMethods);
             freeTable(vm, &klass->publicProperties);
             freeTable(vm, &klass->publicConstantProperties);
-            FREE(vm, ObjClass, object);
             break;
         }
 
         case OBJ_ENUM: {
             ObjEnum *enumObj = (ObjEnum *) object;
             freeTable(vm, &enumObj->values);
-            FREE(vm, ObjEnum, object);
             break;
         }
 
         case OBJ_CLOSURE: {
             ObjClosure *closure = (ObjClosure *) object;
             FREE_ARRAY(vm, ObjUpvalue*, closure->upvalues, closure->upvalueCount);
-            FREE(vm, ObjClosure, object);
             break;
         }
 
@@ -237,7 +492,6 @@ void freeObject(DictuVM *vm, Obj *object) {
                 }
             }
             freeChunk(vm, &function->chunk);
-            FREE(vm, ObjFunction, object);
             break;
         }
 
@@ -245,50 +499,30 @@ void freeObject(DictuVM *vm, Obj *object) {
             ObjInstance *instance = (ObjInstance *) object;
             freeTable(vm, &instance->publicFields);
             freeTable(vm, &instance->privateFields);
-            FREE(vm, ObjInstance, object);
-            break;
-        }
-
-        case OBJ_NATIVE: {
-            FREE(vm, ObjNative, object);
             break;
         }
 
         case OBJ_STRING: {
             ObjString *string = (ObjString *) object;
             FREE_ARRAY(vm, char, string->chars, string->length + 1);
-            FREE(vm, ObjString, object);
             break;
         }
 
         case OBJ_LIST: {
             ObjList *list = (ObjList *) object;
             freeValueArray(vm, &list->values);
-            FREE(vm, ObjList, list);
             break;
         }
 
         case OBJ_DICT: {
             ObjDict *dict = (ObjDict *) object;
             FREE_ARRAY(vm, DictItem, dict->entries, dict->capacityMask + 1);
-            FREE(vm, ObjDict, dict);
             break;
         }
 
         case OBJ_SET: {
             ObjSet *set = (ObjSet *) object;
             FREE_ARRAY(vm, SetItem, set->entries, set->capacityMask + 1);
-            FREE(vm, ObjSet, set);
-            break;
-        }
-
-        case OBJ_FILE: {
-            FREE(vm, ObjFile, object);
-            break;
-        }
-
-        case OBJ_UPVALUE: {
-            FREE(vm, ObjUpvalue, object);
             break;
         }
 
@@ -296,23 +530,26 @@ void freeObject(DictuVM *vm, Obj *object) {
             ObjAbstract *abstract = (ObjAbstract*) object;
             abstract->func(vm, abstract);
             freeTable(vm, &abstract->values);
-            FREE(vm, ObjAbstract, object);
             break;
         }
 
-        case OBJ_RESULT: {
-            FREE(vm, ObjResult, object);
+        case OBJ_STREAM: {
+            ObjStream *stream = (ObjStream *) object;
+            FREE_ARRAY(vm, StreamStage, stream->stages, stream->stageCount);
             break;
         }
+
+        case OBJ_BOUND_METHOD:
+        case OBJ_NATIVE:
+        case OBJ_FILE:
+        case OBJ_UPVALUE:
+        case OBJ_RESULT:
+        case OBJ_BIGINT:
+            break;
     }
 }
 
-void collectGarbage(DictuVM *vm) {
-#ifdef DEBUG_TRACE_GC
-    printf("-- gc begin\n");
-    size_t before = vm->bytesAllocated;
-#endif
-
+static void markRoots(DictuVM *vm) {
     // Mark the stack roots.
     for (Value *slot = vm->stack; slot < vm->stackTop; slot++) {
         grayValue(vm, *slot);
@@ -320,6 +557,7 @@ void collectGarbage(DictuVM *vm) {
 
     for (int i = 0; i < vm->frameCount; i++) {
         grayObject(vm, (Obj *) vm->frames[i].closure);
+        grayObject(vm, (Obj *) vm->frames[i].varargs);
     }
 
     // Mark the open upvalues.
@@ -343,41 +581,103 @@ void collectGarbage(DictuVM *vm) {
     grayTable(vm, &vm->classMethods);
     grayTable(vm, &vm->instanceMethods);
     grayTable(vm, &vm->resultMethods);
+    grayTable(vm, &vm->streamMethods);
+    grayTable(vm, &vm->bigIntMethods);
     grayCompilerRoots(vm);
     grayObject(vm, (Obj *) vm->initString);
     grayObject(vm, (Obj *) vm->annotationString);
+    grayObject(vm, (Obj *) vm->hasNextString);
+    grayObject(vm, (Obj *) vm->nextString);
     grayObject(vm, (Obj *) vm->replVar);
+    grayValue(vm, vm->callResult);
 
-    // Traverse the references.
-    while (vm->grayCount > 0) {
-        // Pop an item from the gray stack.
-        Obj *object = vm->grayStack[--vm->grayCount];
-        blackenObject(vm, object);
+    for (int i = 0; i < vm->varargsPoolCount; ++i) {
+        grayObject(vm, (Obj *) vm->varargsPool[i]);
     }
 
+    for (DictuHandle *handle = vm->handles; handle != NULL; handle = handle->next) {
+        grayValue(vm, handle->value);
+    }
+
+    grayAbstractTypes(vm);
+}
+
+// Grows the heap further between collections when they take more than
+// their share of the running time and less when they take less, the
+// square root damps the swings.
+static void adaptGrowth(DictuVM *vm, double start) {
+    double end = gcClock();
+    double cycle = end - vm->gcCycleStart;
+    vm->gcCycleStart = end;
+
+    if (vm->gcTarget <= 0 || cycle <= 0) {
+        return;
+    }
+
+    vm->heapGrowth *= sqrt((end - start) / cycle / vm->gcTarget);
+
+    if (vm->heapGrowth < GC_GROWTH_MIN) {
+        vm->heapGrowth = GC_GROWTH_MIN;
+    } else if (vm->heapGrowth > GC_GROWTH_MAX) {
+        vm->heapGrowth = GC_GROWTH_MAX;
+    }
+}
+
+// Sets the next collection for once the heap has grown by its share of
+// what survived, within the configured bounds. Returns the bytes left
+// until then.
+static size_t setThreshold(DictuVM *vm, size_t liveBytes) {
+    size_t nextGC = vm->bytesAllocated + (size_t) (liveBytes * vm->heapGrowth);
+
+    if (nextGC < vm->minHeap) {
+        nextGC = vm->minHeap;
+    }
+
+    if (vm->maxHeap > 0 && nextGC > vm->maxHeap) {
+        nextGC = vm->maxHeap;
+    }
+
+    vm->nextGC = nextGC;
+
+    return nextGC > vm->bytesAllocated ? nextGC - vm->bytesAllocated : 0;
+}
+
+void collectGarbage(DictuVM *vm) {
+    double start = gcClock();
+
+#ifdef DEBUG_TRACE_GC
+    printf("-- gc begin\n");
+    size_t before = vm->bytesAllocated;
+#endif
+
+    // Marks are cleared as pages are swept.
+    finishSweep(vm);
+    markRoots(vm);
+
+    // Traverse the references.
+    markObjects(vm);
+    processWeakReferences(vm);
+
     // Delete unused interned strings.
     tableRemoveWhite(vm, &vm->strings);
 
-    // Collect the white objects.
-    Obj **object = &vm->objects;
-    while (*object != NULL) {
-        if (!((*object)->isDark)) {
-            // This object wasn't reached, so remove it from the list and
-            // free it.
-            Obj *unreached = *object;
-            *object = unreached->next;
-            freeObject(vm, unreached);
-        } else {
-            // This object was reached, so unmark it (for the next GC) and
-            // move on to the next.
-            (*object)->isDark = false;
-            object = &(*object)->next;
-        }
+    // Collect the white objects, most of them as their pages are next
+    // allocated from.
+    size_t deadBytes = startSweep(vm);
+
+    // Adjust the heap size based on live memory. The dead bytes are still
+    // counted, sweeping takes them off the threshold as it frees them.
+    size_t liveBytes = vm->bytesAllocated > deadBytes ? vm->bytesAllocated - deadBytes : 0;
+    adaptGrowth(vm, start);
+    size_t headroom = setThreshold(vm, liveBytes);
+    setSweepPace(&vm->heap, headroom);
+
+    // Pages the next cycle will not fill are better given back.
+    if (vm->compact && vm->heap.reclaimableBytes >= GC_COMPACT_MIN &&
+        vm->heap.reclaimableBytes > headroom) {
+        vm->compactPending = true;
     }
 
-    // Adjust the heap size based on live memory.
-    vm->nextGC = vm->bytesAllocated * GC_HEAP_GROW_FACTOR;
-
 #ifdef DEBUG_TRACE_GC
     printf("-- gc collected %ld bytes (from %ld to %ld) next at %ld\n",
            before - vm->bytesAllocated, before, vm->bytesAllocated,
@@ -385,13 +685,52 @@ void collectGarbage(DictuVM *vm) {
 #endif
 }
 
-void freeObjects(DictuVM *vm) {
-    Obj *object = vm->objects;
-    while (object != NULL) {
-        Obj *next = object->next;
-        freeObject(vm, object);
-        object = next;
+void compactHeap(DictuVM *vm) {
+    double start = gcClock();
+
+#ifdef DEBUG_TRACE_GC
+    printf("-- gc compact begin\n");
+    size_t before = vm->bytesAllocated;
+    size_t pagesBefore = vm->heap.pageBytes;
+#endif
+
+    vm->compactPending = false;
+
+    finishSweep(vm);
+    markRoots(vm);
+    markObjects(vm);
+    processWeakReferences(vm);
+    tableRemoveWhite(vm, &vm->strings);
+
+    // Even with nothing worth moving the sweep gives the empty pages
+    // back.
+    int evacuated = selectEvacuation(vm);
+    evacuatePages(vm);
+
+    if (evacuated > 0) {
+        forwardReferences(vm);
     }
 
-    free(vm->grayStack);
+    releaseEvacuated(vm);
+
+    // Everything left is live now.
+    adaptGrowth(vm, start);
+    setThreshold(vm, vm->bytesAllocated);
+
+#ifdef __GLIBC__
+    // What the objects own lives in the C heap, return what it has free.
+    malloc_trim(0);
+#endif
+
+#ifdef DEBUG_TRACE_GC
+    printf("-- gc compact collected %ld bytes (from %ld to %ld) pages from %ld to %ld\n",
+           before - vm->bytesAllocated, before, vm->bytesAllocated,
+           pagesBefore, vm->heap.pageBytes);
+#endif
+}
+
+void freeObjects(DictuVM *vm) {
+    freeHeap(vm);
+    freeMarkPool(vm);
+    freeMarker(&vm->marker);
 }
@@ -4,6 +4,10 @@
 #include "object.h"
 #include "common.h"
 
+// Growth of the heap between collections until it adapts, see
+// DictuGCOptions.
+#define GC_HEAP_GROW_FACTOR 2
+
 #define ALLOCATE(vm, type, count)				\
   (type*)reallocate(vm, NULL, 0, sizeof(type) * (count))
 
@@ -27,14 +31,36 @@
 #define FREE_ARRAY(vm, type, pointer, oldCount)		\
   reallocate(vm, pointer, sizeof(type) * (oldCount), 0)
 
+// Does not return NULL unless newSize is 0. An allocation past the heap
+// limit, or one the system refuses even after a collection, unwinds to
+// the call that entered the VM.
 void *reallocate(DictuVM *vm, void *previous, size_t oldSize, size_t newSize);
 
+// reallocate() for a new block of zeroed memory. Large blocks come from
+// the system already zeroed and are not touched until used, freed with
+// reallocate() like any other.
+void *allocateZeroed(DictuVM *vm, size_t size);
+
+// Allocates the memory of an object from the heap, collecting garbage
+// first if it is due.
+void *allocateObjectMemory(DictuVM *vm, size_t size);
+
 void grayObject(DictuVM *vm, Obj *object);
 
 void grayValue(DictuVM *vm, Value value);
 
+// Grays everything a marked object references.
+void blackenObject(DictuVM *vm, Obj *object);
+
 void collectGarbage(DictuVM *vm);
 
+// Seconds since an arbitrary point, for timing collections.
+double gcClock(void);
+
+// Collects garbage and moves objects out of sparse pages, see compact.h.
+// Only called where no C code holds on to an object.
+void compactHeap(DictuVM *vm);
+
 void freeObjects(DictuVM *vm);
 
 void freeObject(DictuVM *vm, Obj *object);
@@ -6,6 +6,7 @@
 #include "natives.h"
 #include "vm.h"
 #include "optionals.h"
+#include "iterators.h"
 
 // Native functions
 static Value typeNative(DictuVM *vm, int argCount, Value *args) {
@@ -64,11 +65,6 @@ static Value inputNative(DictuVM *vm, int argCount, Value *args) {
             int oldSize = currentSize;
             currentSize = GROW_CAPACITY(currentSize);
             line = GROW_ARRAY(vm, line, char, oldSize, currentSize);
-
-            if (line == NULL) {
-                printf("Unable to allocate memory\n");
-                exit(71);
-            }
         }
     }
 
@@ -180,6 +176,100 @@ static Value generateErrorResult(DictuVM *vm, int argCount, Value *args) {
     return OBJ_VAL(newResult(vm, ERR, args[0]));
 }
 
+static Value rangeNative(DictuVM *vm, int argCount, Value *args) {
+    if (argCount < 1 || argCount > 3) {
+        runtimeError(vm, "range() takes 1, 2 or 3 arguments (%d given).", argCount);
+        return EMPTY_VAL;
+    }
+
+    for (int i = 0; i < argCount; ++i) {
+        if (!IS_NUMBER(args[i])) {
+            runtimeError(vm, "range() arguments must be numbers.");
+            return EMPTY_VAL;
+        }
+    }
+
+    double start = 0, end, step = 1;
+
+    if (argCount == 1) {
+        end = AS_NUMBER(args[0]);
+    } else {
+        start = AS_NUMBER(args[0]);
+        end = AS_NUMBER(args[1]);
+
+        if (argCount == 3) {
+            step = AS_NUMBER(args[2]);
+        }
+    }
+
+    if (step == 0) {
+        runtimeError(vm, "range() step cannot be 0.");
+        return EMPTY_VAL;
+    }
+
+    ObjList *list = newList(vm);
+    push(vm, OBJ_VAL(list));
+
+    bool integers = true;
+    for (int i = 0; i < argCount; ++i) {
+        integers = integers && IS_INT(args[i]);
+    }
+
+    for (double i = start; step > 0 ? i < end : i > end; i += step) {
+        writeValueArray(vm, &list->values, integers ? INT_VAL((int64_t) i) : NUMBER_VAL(i));
+    }
+
+    pop(vm);
+    return OBJ_VAL(list);
+}
+
+static Value streamNative(DictuVM *vm, int argCount, Value *args) {
+    if (argCount < 1 || argCount > 3) {
+        runtimeError(vm, "stream() takes 1, 2 or 3 arguments (%d given).", argCount);
+        return EMPTY_VAL;
+    }
+
+    if (argCount == 1 && !IS_NUMBER(args[0])) {
+        int size;
+        if (!iteratorStart(args[0], &size)) {
+            runtimeError(vm, "stream() argument must be a list, string, dict, set, stream or number.");
+            return EMPTY_VAL;
+        }
+
+        ObjStream *stream = newStream(vm, args[0]);
+        stream->size = size;
+        return OBJ_VAL(stream);
+    }
+
+    for (int i = 0; i < argCount; ++i) {
+        if (!IS_NUMBER(args[i])) {
+            runtimeError(vm, "stream() arguments must be numbers.");
+            return EMPTY_VAL;
+        }
+    }
+
+    // A numeric stream counts like range() without building the list.
+    ObjStream *stream = newStream(vm, NIL_VAL);
+
+    if (argCount == 1) {
+        stream->end = AS_NUMBER(args[0]);
+    } else {
+        stream->start = AS_NUMBER(args[0]);
+        stream->end = AS_NUMBER(args[1]);
+
+        if (argCount == 3) {
+            stream->step = AS_NUMBER(args[2]);
+        }
+    }
+
+    if (stream->step == 0) {
+        runtimeError(vm, "stream() step cannot be 0.");
+        return EMPTY_VAL;
+    }
+
+    return OBJ_VAL(stream);
+}
+
 // End of natives
 
 void defineAllNatives(DictuVM *vm) {
@@ -192,7 +282,9 @@ void defineAllNatives(DictuVM *vm) {
             "assert",
             "isDefined",
             "Success",
-            "Error"
+            "Error",
+            "range",
+            "stream"
     };
 
     NativeFn nativeFunctions[] = {
@@ -204,7 +296,9 @@ void defineAllNatives(DictuVM *vm) {
             assertNative,
             isDefinedNative,
             generateSuccessResult,
-            generateErrorResult
+            generateErrorResult,
+            rangeNative,
+            streamNative
     };
 
     for (uint8_t i = 0; i < sizeof(nativeNames) / sizeof(nativeNames[0]); ++i) {
@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,17 +8,15 @@
 #include "table.h"
 #include "value.h"
 #include "vm.h"
+#include "bigint.h"
 
 #define ALLOCATE_OBJ(vm, type, objectType) \
     (type*)allocateObject(vm, sizeof(type), objectType)
 
 static Obj *allocateObject(DictuVM *vm, size_t size, ObjType type) {
     Obj *object;
-    object = (Obj *) reallocate(vm, NULL, 0, size);
+    object = (Obj *) allocateObjectMemory(vm, size);
     object->type = type;
-    object->isDark = false;
-    object->next = vm->objects;
-    vm->objects = object;
 
 #ifdef DEBUG_TRACE_GC
     printf("%p allocate %zd for %d\n", (void *)object, size, type);
@@ -107,6 +106,7 @@ ObjFunction *newFunction(DictuVM *vm, ObjModule *module, FunctionType type, Acce
     function->arity = 0;
     function->arityOptional = 0;
     function->isVariadic = 0;
+    function->pooledVarargs = false;
     function->upvalueCount = 0;
     function->propertyCount = 0;
     function->propertyIndexes = NULL;
@@ -118,6 +118,7 @@ ObjFunction *newFunction(DictuVM *vm, ObjModule *module, FunctionType type, Acce
     function->type = type;
     function->accessLevel = level;
     function->module = module;
+    function->aot = NULL;
     initChunk(vm, &function->chunk);
 
     return function;
@@ -142,6 +143,10 @@ ObjInstance *newInstance(DictuVM *vm, ObjClass *klass) {
 ObjNative *newNative(DictuVM *vm, NativeFn function) {
     ObjNative *native = ALLOCATE_OBJ(vm, ObjNative, OBJ_NATIVE);
     native->function = function;
+    native->name = NULL;
+    native->minArity = 0;
+    native->maxArity = INT_MAX;
+    native->typedParams = 0;
     return native;
 }
 
@@ -188,6 +193,7 @@ ObjAbstract *newAbstract(DictuVM *vm, AbstractFreeFn func, AbstractTypeFn type)
     abstract->data = NULL;
     abstract->func = func;
     abstract->type = type;
+    abstract->abstractType = NULL;
     initTable(&abstract->values);
 
     return abstract;
@@ -253,6 +259,33 @@ ObjString *copyString(DictuVM *vm, const char *chars, int length) {
     return allocateString(vm, heapChars, length, hash);
 }
 
+ObjStream *newStream(DictuVM *vm, Value source) {
+    ObjStream *stream = ALLOCATE_OBJ(vm, ObjStream, OBJ_STREAM);
+    stream->source = source;
+    stream->cursor = 0;
+    stream->size = 0;
+    stream->start = 0;
+    stream->end = 0;
+    stream->step = 1;
+    stream->done = false;
+    stream->stageCount = 0;
+    stream->stages = NULL;
+    return stream;
+}
+
+ObjBigInt *newBigInt(DictuVM *vm, int sign, const uint32_t *limbs, int count) {
+    // Drop leading zero limbs so equal values share one representation.
+    while (count > 0 && limbs[count - 1] == 0) {
+        count--;
+    }
+
+    ObjBigInt *bigInt = (ObjBigInt *) allocateObject(vm, sizeof(ObjBigInt) + sizeof(uint32_t) * count, OBJ_BIGINT);
+    bigInt->sign = count == 0 ? 0 : sign;
+    bigInt->count = count;
+    memcpy(bigInt->limbs, limbs, sizeof(uint32_t) * count);
+    return bigInt;
+}
+
 ObjUpvalue *newUpvalue(DictuVM *vm, Value *slot) {
     ObjUpvalue *upvalue = ALLOCATE_OBJ(vm, ObjUpvalue, OBJ_UPVALUE);
     upvalue->closed = NIL_VAL;
@@ -673,6 +706,17 @@ char *objectToString(Value value) {
             return setToString(value);
         }
 
+        case OBJ_BIGINT: {
+            return bigIntToString(AS_BIGINT(value));
+        }
+
+        case OBJ_STREAM: {
+            char *streamString = malloc(sizeof(char) * 9);
+            memcpy(streamString, "<Stream>", 8);
+            streamString[8] = '\0';
+            return streamString;
+        }
+
         case OBJ_UPVALUE: {
             char *upvalueString = malloc(sizeof(char) * 8);
             memcpy(upvalueString, "upvalue", 7);
@@ -20,6 +20,7 @@
 #define AS_FUNCTION(value)      ((ObjFunction*)AS_OBJ(value))
 #define AS_INSTANCE(value)      ((ObjInstance*)AS_OBJ(value))
 #define AS_NATIVE(value)        (((ObjNative*)AS_OBJ(value))->function)
+#define AS_NATIVE_OBJ(value)    ((ObjNative*)AS_OBJ(value))
 #define AS_STRING(value)        ((ObjString*)AS_OBJ(value))
 #define AS_CSTRING(value)       (((ObjString*)AS_OBJ(value))->chars)
 #define AS_LIST(value)          ((ObjList*)AS_OBJ(value))
@@ -28,6 +29,8 @@
 #define AS_FILE(value)          ((ObjFile*)AS_OBJ(value))
 #define AS_ABSTRACT(value)      ((ObjAbstract*)AS_OBJ(value))
 #define AS_RESULT(value)        ((ObjResult*)AS_OBJ(value))
+#define AS_STREAM(value)        ((ObjStream*)AS_OBJ(value))
+#define AS_BIGINT(value)        ((ObjBigInt*)AS_OBJ(value))
 
 #define IS_MODULE(value)          isObjType(value, OBJ_MODULE)
 #define IS_BOUND_METHOD(value)    isObjType(value, OBJ_BOUND_METHOD)
@@ -46,6 +49,8 @@
 #define IS_FILE(value)            isObjType(value, OBJ_FILE)
 #define IS_ABSTRACT(value)        isObjType(value, OBJ_ABSTRACT)
 #define IS_RESULT(value)          isObjType(value, OBJ_RESULT)
+#define IS_STREAM(value)          isObjType(value, OBJ_STREAM)
+#define IS_BIGINT(value)          isObjType(value, OBJ_BIGINT)
 
 typedef enum {
     OBJ_MODULE,
@@ -63,6 +68,8 @@ typedef enum {
     OBJ_FILE,
     OBJ_ABSTRACT,
     OBJ_RESULT,
+    OBJ_STREAM,
+    OBJ_BIGINT,
     OBJ_UPVALUE
 } ObjType;
 
@@ -87,10 +94,10 @@ typedef enum {
     TYPE_TOP_LEVEL
 } FunctionType;
 
+// Objects are found through the pages of the heap rather than a list
+// and marked in the heap's bitmaps, so the header is just the type.
 struct sObj {
     ObjType type;
-    bool isDark;
-    struct sObj *next;
 };
 
 typedef struct {
@@ -100,9 +107,16 @@ typedef struct {
     Table values;
 } ObjModule;
 
+// Native code generated for a function ahead of time, see aot.h. It
+// runs the frame call() has just pushed to completion.
+typedef bool (*AotFn)(DictuVM *vm);
+
 typedef struct {
     Obj obj;
     int isVariadic;
+    // Set when the variadic list never escapes a call, so it can be
+    // taken from and returned to the VM's pool.
+    bool pooledVarargs;
     int arity;
     int arityOptional;
     int upvalueCount;
@@ -117,13 +131,36 @@ typedef struct {
     int privatePropertyCount;
     int *privatePropertyNames;
     int *privatePropertyIndexes;
+    AotFn aot;
 } ObjFunction;
 
 typedef Value (*NativeFn)(DictuVM *vm, int argCount, Value *args);
 
+#define NATIVE_MAX_PARAMS 8
+
+typedef enum {
+    NATIVE_PARAM_ANY,
+    NATIVE_PARAM_NUMBER,
+    NATIVE_PARAM_STRING,
+    NATIVE_PARAM_LIST,
+    NATIVE_PARAM_DICT,
+    NATIVE_PARAM_BOOL
+} NativeParamType;
+
 typedef struct {
     Obj obj;
     NativeFn function;
+
+    // Natives registered with a signature have their arguments checked
+    // by the VM before the call, see defineTypedNative. Natives doing
+    // their own checking accept any arity and have no typed params.
+    const char *name;
+    int minArity;
+    int maxArity;
+
+    // Params past typedParams are all NATIVE_PARAM_ANY.
+    uint8_t typedParams;
+    uint8_t params[NATIVE_MAX_PARAMS];
 } ObjNative;
 
 struct sObjString {
@@ -170,6 +207,10 @@ struct sObjFile {
     char *openType;
 };
 
+typedef struct sAbstractType AbstractType;
+typedef struct sWeakRef WeakRef;
+typedef struct sWeakDict WeakDict;
+
 typedef void (*AbstractFreeFn)(DictuVM *vm, ObjAbstract *abstract);
 typedef char* (*AbstractTypeFn)(ObjAbstract *abstract);
 
@@ -179,6 +220,9 @@ struct sObjAbstract {
     void *data;
     AbstractFreeFn func;
     AbstractTypeFn type;
+
+    // Host type descriptor, NULL for untyped abstracts.
+    AbstractType *abstractType;
 };
 
 typedef enum {
@@ -192,6 +236,58 @@ struct sObjResult {
     Value value;
 };
 
+typedef enum {
+    STREAM_MAP,
+    STREAM_FILTER,
+    STREAM_TAKE,
+    STREAM_ZIP,
+    STREAM_ENUMERATE
+} StreamStageType;
+
+typedef struct {
+    StreamStageType type;
+
+    // The function of a map or filter, or the other source of a zip.
+    Value value;
+
+    // Elements left for a take, or the next index of an enumerate.
+    int count;
+
+    // Iteration state of a zip source.
+    int cursor;
+    int size;
+} StreamStage;
+
+typedef struct {
+    Obj obj;
+
+    // A list, string, dict, set or stream. Nil for a numeric range,
+    // which counts from start to end.
+    Value source;
+    int cursor;
+    int size;
+    double start;
+    double end;
+    double step;
+
+    // Streams are single pass, once exhausted they stay exhausted.
+    bool done;
+    int stageCount;
+    StreamStage *stages;
+} ObjStream;
+
+typedef struct {
+    Obj obj;
+
+    // -1, 0 or 1. Zero has no limbs.
+    int sign;
+    int count;
+
+    // Magnitude in base 2^32, least significant limb first, with no
+    // leading zero limbs.
+    uint32_t limbs[];
+} ObjBigInt;
+
 typedef struct sUpvalue {
     Obj obj;
 
@@ -287,6 +383,10 @@ Value newResultError(DictuVM *vm, char *errorMsg);
 
 ObjUpvalue *newUpvalue(DictuVM *vm, Value *slot);
 
+ObjStream *newStream(DictuVM *vm, Value source);
+
+ObjBigInt *newBigInt(DictuVM *vm, int sign, const uint32_t *limbs, int count);
+
 char *setToString(Value value);
 char *dictToString(Value value);
 char *listToString(Value value);
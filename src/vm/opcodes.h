@@ -49,6 +49,8 @@ OPCODE(BREAK)
 OPCODE(BITWISE_AND)
 OPCODE(BITWISE_XOR)
 OPCODE(BITWISE_OR)
+OPCODE(SHIFT_LEFT)
+OPCODE(SHIFT_RIGHT)
 OPCODE(POP_REPL)
 OPCODE(NEW_LIST)
 OPCODE(SLICE)
@@ -61,3 +63,16 @@ OPCODE(IMPORT_BUILTIN_VARIABLE)
 OPCODE(IMPORT_BUILTIN)
 OPCODE(POW)
 OPCODE(MOD)
+OPCODE(FOR_PREP)
+OPCODE(FOR_LOOP)
+OPCODE(ITER_INIT)
+OPCODE(ITER_NEXT)
+OPCODE(ADD_NN)
+OPCODE(SUBTRACT_NN)
+OPCODE(MULTIPLY_NN)
+OPCODE(DIVIDE_NN)
+OPCODE(LESS_NN)
+OPCODE(GREATER_NN)
+OPCODE(LEN)
+OPCODE(MATH_UNARY)
+OPCODE(TAIL_CALL)
@@ -4,6 +4,8 @@ BuiltinModules modules[] = {
   {"Math", &createMathsModule, false},
   {"Time", &createTimeModule, false},
   {"Random", &createRandomModule, false},
+  {"BigInt", &createBigIntModule, false},
+  {"Weak", &createWeakModule, false},
   /*
     #ifndef DISABLE_UUID
     {"UUID", &createUuidModule, false},
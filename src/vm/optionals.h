@@ -5,7 +5,9 @@
 #include "math.h"
 #include "time.h"
 #include "random.h"
+#include "bigint.h"
 #include "http.h"
+#include "weak.h"
 #include "object.h"
 
 typedef Value (*BuiltinModule)(DictuVM *vm);
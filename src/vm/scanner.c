@@ -200,6 +200,8 @@ static TokenType identifierType(Scanner *scanner) {
 	return checkKeyword(scanner, 2, 0, "", TOKEN_IF);
       case 'm':
 	return checkKeyword(scanner, 2, 4, "port", TOKEN_IMPORT);
+      case 'n':
+	return checkKeyword(scanner, 2, 0, "", TOKEN_IN);
       }
     }
     break;
@@ -432,8 +434,14 @@ Token scanToken(Scanner *scanner) {
     }
     return makeToken(scanner, TOKEN_QUESTION);
   case '<':
+    if (match(scanner, '<')) {
+      return makeToken(scanner, TOKEN_LESS_LESS);
+    }
     return makeToken(scanner, match(scanner, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS);
   case '>':
+    if (match(scanner, '>')) {
+      return makeToken(scanner, TOKEN_GREATER_GREATER);
+    }
     return makeToken(scanner, match(scanner, '=') ?
 		     TOKEN_GREATER_EQUAL : TOKEN_GREATER);
   case '"':
@@ -23,8 +23,8 @@ typedef enum {
     // One or two character tokens.
     TOKEN_NOT, TOKEN_BANG_EQUAL,
     TOKEN_EQUAL, TOKEN_EQUAL_EQUAL,
-    TOKEN_GREATER, TOKEN_GREATER_EQUAL,
-    TOKEN_LESS, TOKEN_LESS_EQUAL,
+    TOKEN_GREATER, TOKEN_GREATER_EQUAL, TOKEN_GREATER_GREATER,
+    TOKEN_LESS, TOKEN_LESS_EQUAL, TOKEN_LESS_LESS,
     TOKEN_R, TOKEN_ARROW,
 
     // three or more character tokens.
@@ -39,7 +39,7 @@ typedef enum {
     TOKEN_ENUM,
     TOKEN_IF, TOKEN_AND, TOKEN_ELSE, TOKEN_OR, TOKEN_SWITCH, TOKEN_CASE, TOKEN_DEFAULT,
     TOKEN_VAR, TOKEN_CONST, TOKEN_TRUE, TOKEN_FALSE, TOKEN_NIL,
-    TOKEN_FOR, TOKEN_WHILE, TOKEN_BREAK,
+    TOKEN_FOR, TOKEN_IN, TOKEN_WHILE, TOKEN_BREAK,
     TOKEN_RETURN, TOKEN_CONTINUE,
     TOKEN_WITH, TOKEN_EOF, TOKEN_IMPORT, TOKEN_FROM,
     TOKEN_ERROR
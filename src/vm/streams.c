@@ -0,0 +1,362 @@
+#include <string.h>
+
+#include "streams.h"
+#include "memory.h"
+
+static IteratorResult pullSource(DictuVM *vm, ObjStream *stream, Value *value) {
+    if (IS_NIL(stream->source)) {
+        if (stream->step > 0 ? stream->start >= stream->end : stream->start <= stream->end) {
+            return ITERATOR_DONE;
+        }
+
+        *value = NUMBER_VAL(stream->start);
+        stream->start += stream->step;
+        return ITERATOR_VALUE;
+    }
+
+    return iteratorNext(vm, stream->source, &stream->cursor, stream->size, value);
+}
+
+// Replaces the two values on top of the stack with the list [a, b].
+static void pairTop(DictuVM *vm) {
+    ObjList *pair = newList(vm);
+    push(vm, OBJ_VAL(pair));
+    writeValueArray(vm, &pair->values, vm->stackTop[-3]);
+    writeValueArray(vm, &pair->values, vm->stackTop[-2]);
+    vm->stackTop -= 2;
+    vm->stackTop[-1] = OBJ_VAL(pair);
+}
+
+// streamNext, leaving the element on top of the stack for the caller to
+// pop once it has stored it somewhere the collector can see.
+static IteratorResult pullStream(DictuVM *vm, ObjStream *stream) {
+    while (!stream->done) {
+        Value element;
+        IteratorResult result = pullSource(vm, stream, &element);
+
+        if (result != ITERATOR_VALUE) {
+            stream->done = result == ITERATOR_DONE;
+            return result;
+        }
+
+        // The element in flight lives on the stack so it is rooted while
+        // callbacks run. On error runtimeError has already reset the stack.
+        push(vm, element);
+        bool keep = true;
+
+        for (int i = 0; keep && i < stream->stageCount; ++i) {
+            StreamStage *stage = &stream->stages[i];
+
+            switch (stage->type) {
+                case STREAM_MAP: {
+                    Value mapped = callFunction(vm, stage->value, 1, vm->stackTop - 1);
+
+                    if (IS_EMPTY(mapped)) {
+                        return ITERATOR_ERROR;
+                    }
+
+                    vm->stackTop[-1] = mapped;
+                    break;
+                }
+
+                case STREAM_FILTER: {
+                    Value test = callFunction(vm, stage->value, 1, vm->stackTop - 1);
+
+                    if (IS_EMPTY(test)) {
+                        return ITERATOR_ERROR;
+                    }
+
+                    keep = !isFalsey(test);
+                    break;
+                }
+
+                case STREAM_TAKE: {
+                    // Stop pulling from the source as soon as the last
+                    // element has been let through.
+                    if (--stage->count <= 0) {
+                        stream->done = true;
+                    }
+                    break;
+                }
+
+                case STREAM_ZIP: {
+                    Value other;
+                    result = iteratorNext(vm, stage->value, &stage->cursor, stage->size, &other);
+
+                    if (result == ITERATOR_ERROR) {
+                        return ITERATOR_ERROR;
+                    }
+
+                    if (result == ITERATOR_DONE) {
+                        pop(vm);
+                        stream->done = true;
+                        return ITERATOR_DONE;
+                    }
+
+                    push(vm, other);
+                    pairTop(vm);
+                    break;
+                }
+
+                case STREAM_ENUMERATE: {
+                    push(vm, vm->stackTop[-1]);
+                    vm->stackTop[-2] = NUMBER_VAL(stage->count++);
+                    pairTop(vm);
+                    break;
+                }
+            }
+        }
+
+        if (keep) {
+            return ITERATOR_VALUE;
+        }
+
+        pop(vm);
+    }
+
+    return ITERATOR_DONE;
+}
+
+IteratorResult streamNext(DictuVM *vm, ObjStream *stream, Value *value) {
+    IteratorResult result = pullStream(vm, stream);
+
+    if (result == ITERATOR_VALUE) {
+        *value = pop(vm);
+    }
+
+    return result;
+}
+
+// Stages are never added in place, each call returns a new stream
+// sharing the source so partially built pipelines can be reused.
+static ObjStream *extendStream(DictuVM *vm, ObjStream *stream, StreamStageType type, Value value, int count) {
+    ObjStream *extended = newStream(vm, stream->source);
+    push(vm, OBJ_VAL(extended));
+
+    extended->cursor = stream->cursor;
+    extended->size = stream->size;
+    extended->start = stream->start;
+    extended->end = stream->end;
+    extended->step = stream->step;
+    extended->done = stream->done;
+
+    // take(a).take(b) fuses into a single take(min(a, b)).
+    int stageCount = stream->stageCount;
+    if (type == STREAM_TAKE && stageCount > 0 && stream->stages[stageCount - 1].type == STREAM_TAKE) {
+        stageCount--;
+
+        if (stream->stages[stageCount].count < count) {
+            count = stream->stages[stageCount].count;
+        }
+    }
+
+    extended->stages = ALLOCATE(vm, StreamStage, stageCount + 1);
+    if (stageCount > 0) {
+        memcpy(extended->stages, stream->stages, sizeof(StreamStage) * stageCount);
+    }
+    extended->stageCount = stageCount + 1;
+
+    StreamStage *stage = &extended->stages[stageCount];
+    stage->type = type;
+    stage->value = value;
+    stage->count = count;
+    stage->cursor = 0;
+    stage->size = 0;
+
+    if (type == STREAM_TAKE && count <= 0) {
+        extended->done = true;
+    }
+
+    pop(vm);
+    return extended;
+}
+
+static Value mapStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 1) {
+        runtimeError(vm, "map() takes 1 argument (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    return OBJ_VAL(extendStream(vm, AS_STREAM(args[0]), STREAM_MAP, args[1], 0));
+}
+
+static Value filterStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 1) {
+        runtimeError(vm, "filter() takes 1 argument (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    return OBJ_VAL(extendStream(vm, AS_STREAM(args[0]), STREAM_FILTER, args[1], 0));
+}
+
+static Value takeStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 1) {
+        runtimeError(vm, "take() takes 1 argument (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    if (!IS_NUMBER(args[1])) {
+        runtimeError(vm, "take() argument must be a number");
+        return EMPTY_VAL;
+    }
+
+    return OBJ_VAL(extendStream(vm, AS_STREAM(args[0]), STREAM_TAKE, NIL_VAL, AS_NUMBER(args[1])));
+}
+
+static Value zipStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 1) {
+        runtimeError(vm, "zip() takes 1 argument (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    int size;
+    if (!iteratorStart(args[1], &size)) {
+        runtimeError(vm, "zip() argument must be a list, string, dict, set or stream");
+        return EMPTY_VAL;
+    }
+
+    ObjStream *stream = extendStream(vm, AS_STREAM(args[0]), STREAM_ZIP, args[1], 0);
+    stream->stages[stream->stageCount - 1].size = size;
+
+    return OBJ_VAL(stream);
+}
+
+static Value enumerateStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "enumerate() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    return OBJ_VAL(extendStream(vm, AS_STREAM(args[0]), STREAM_ENUMERATE, NIL_VAL, 0));
+}
+
+static Value toListStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "toList() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    ObjStream *stream = AS_STREAM(args[0]);
+    ObjList *list = newList(vm);
+    push(vm, OBJ_VAL(list));
+
+    IteratorResult result;
+    while ((result = pullStream(vm, stream)) == ITERATOR_VALUE) {
+        writeValueArray(vm, &list->values, vm->stackTop[-1]);
+        pop(vm);
+    }
+
+    if (result == ITERATOR_ERROR) {
+        return EMPTY_VAL;
+    }
+
+    pop(vm);
+    return OBJ_VAL(list);
+}
+
+static Value reduceStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 1 && argCount != 2) {
+        runtimeError(vm, "reduce() takes 1 or 2 arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    ObjStream *stream = AS_STREAM(args[0]);
+    Value function = args[1];
+    IteratorResult result;
+
+    if (argCount == 2) {
+        push(vm, args[2]);
+    } else {
+        result = pullStream(vm, stream);
+
+        if (result == ITERATOR_ERROR) {
+            return EMPTY_VAL;
+        }
+
+        if (result == ITERATOR_DONE) {
+            runtimeError(vm, "reduce() of an empty stream with no initial value");
+            return EMPTY_VAL;
+        }
+    }
+
+    // The accumulator and the current element sit on the stack as the
+    // two arguments of the reducer.
+    while ((result = pullStream(vm, stream)) == ITERATOR_VALUE) {
+        Value accumulator = callFunction(vm, function, 2, vm->stackTop - 2);
+
+        if (IS_EMPTY(accumulator)) {
+            return EMPTY_VAL;
+        }
+
+        pop(vm);
+        vm->stackTop[-1] = accumulator;
+    }
+
+    if (result == ITERATOR_ERROR) {
+        return EMPTY_VAL;
+    }
+
+    return pop(vm);
+}
+
+static Value sumStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "sum() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    ObjStream *stream = AS_STREAM(args[0]);
+    double sum = 0;
+
+    Value value;
+    IteratorResult result;
+    while ((result = streamNext(vm, stream, &value)) == ITERATOR_VALUE) {
+        if (!IS_NUMBER(value)) {
+            runtimeError(vm, "sum() can only be called on a stream of numbers");
+            return EMPTY_VAL;
+        }
+
+        sum += AS_NUMBER(value);
+    }
+
+    if (result == ITERATOR_ERROR) {
+        return EMPTY_VAL;
+    }
+
+    return NUMBER_VAL(sum);
+}
+
+static Value countStream(DictuVM *vm, int argCount, Value *args) {
+    if (argCount != 0) {
+        runtimeError(vm, "count() takes no arguments (%d given)", argCount);
+        return EMPTY_VAL;
+    }
+
+    ObjStream *stream = AS_STREAM(args[0]);
+    int count = 0;
+
+    Value value;
+    IteratorResult result;
+    while ((result = streamNext(vm, stream, &value)) == ITERATOR_VALUE) {
+        count++;
+    }
+
+    if (result == ITERATOR_ERROR) {
+        return EMPTY_VAL;
+    }
+
+    return NUMBER_VAL(count);
+}
+
+void declareStreamMethods(DictuVM *vm) {
+    defineNative(vm, &vm->streamMethods, "map", mapStream);
+    defineNative(vm, &vm->streamMethods, "filter", filterStream);
+    defineNative(vm, &vm->streamMethods, "take", takeStream);
+    defineNative(vm, &vm->streamMethods, "zip", zipStream);
+    defineNative(vm, &vm->streamMethods, "enumerate", enumerateStream);
+    defineNative(vm, &vm->streamMethods, "toList", toListStream);
+    defineNative(vm, &vm->streamMethods, "reduce", reduceStream);
+    defineNative(vm, &vm->streamMethods, "sum", sumStream);
+    defineNative(vm, &vm->streamMethods, "count", countStream);
+    defineNative(vm, &vm->streamMethods, "toBool", boolNative); // Defined in util
+}
@@ -0,0 +1,15 @@
+#ifndef oolong_streams_h
+#define oolong_streams_h
+
+#include "iterators.h"
+#include "util.h"
+
+// Pulls the next element through every stage of the stream. Callbacks
+// run re-entrantly through callFunction, so no intermediate lists are
+// built between stages. The element is not rooted once returned, the
+// caller stores it before allocating.
+IteratorResult streamNext(DictuVM *vm, ObjStream *stream, Value *value);
+
+void declareStreamMethods(DictuVM *vm);
+
+#endif //dictu_streams_h
@@ -3,21 +3,11 @@
 
 
 static Value lenString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "len() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
-    return NUMBER_VAL(string->length);
+    return INT_VAL(string->length);
 }
 
 static Value toNumberString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "toNumber() takes no arguments (%d given).", argCount);
-        return EMPTY_VAL;
-    }
-
     char *numberString = AS_CSTRING(args[0]);
     char *end;
     errno = 0;
@@ -122,26 +112,11 @@ static Value formatString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value splitString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1 && argCount != 2) {
-        runtimeError(vm, "split() takes 1 or 2 arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_STRING(args[1])) {
-        runtimeError(vm, "Argument passed to split() must be a string");
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
     char *delimiter = AS_CSTRING(args[1]);
     int maxSplit = string->length + 1;
 
     if (argCount == 2) {
-        if (!AS_NUMBER(args[1])) {
-            runtimeError(vm, "Argument passed to split() must be a number");
-            return EMPTY_VAL;
-        }
-
         if (AS_NUMBER(args[2]) >= 0) {
             maxSplit = AS_NUMBER(args[2]);
         }
@@ -214,16 +189,6 @@ static Value splitString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value containsString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "contains() takes 1 argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_STRING(args[1])) {
-        runtimeError(vm, "Argument passed to contains() must be a string");
-        return EMPTY_VAL;
-    }
-
     char *string = AS_CSTRING(args[0]);
     char *delimiter = AS_CSTRING(args[1]);
 
@@ -235,27 +200,12 @@ static Value containsString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value findString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount < 1 || argCount > 2) {
-        runtimeError(vm, "find() takes either 1 or 2 arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     int index = 1;
 
     if (argCount == 2) {
-        if (!IS_NUMBER(args[2])) {
-            runtimeError(vm, "Index passed to find() must be a number");
-            return EMPTY_VAL;
-        }
-
         index = AS_NUMBER(args[2]);
     }
 
-    if (!IS_STRING(args[1])) {
-        runtimeError(vm, "Substring passed to find() must be a string");
-        return EMPTY_VAL;
-    }
-
     char *substr = AS_CSTRING(args[1]);
     char *string = AS_CSTRING(args[0]);
 
@@ -276,16 +226,6 @@ static Value findString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value replaceString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 2) {
-        runtimeError(vm, "replace() takes 2 arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_STRING(args[1]) || !IS_STRING(args[2])) {
-        runtimeError(vm, "Arguments passed to replace() must be a strings");
-        return EMPTY_VAL;
-    }
-
     // Pop values off the stack
     Value stringValue = args[0];
     ObjString *to_replace = AS_STRING(args[1]);
@@ -343,11 +283,6 @@ static Value replaceString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value lowerString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "lower() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
     char *temp = ALLOCATE(vm, char, string->length + 1);
 
@@ -360,11 +295,6 @@ static Value lowerString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value upperString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "upper() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
     char *temp = ALLOCATE(vm, char, string->length + 1);
 
@@ -377,16 +307,6 @@ static Value upperString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value startsWithString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "startsWith() takes 1 argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_STRING(args[1])) {
-        runtimeError(vm, "Argument passed to startsWith() must be a string");
-        return EMPTY_VAL;
-    }
-
     char *string = AS_CSTRING(args[0]);
     ObjString *start = AS_STRING(args[1]);
 
@@ -394,16 +314,6 @@ static Value startsWithString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value endsWithString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "endsWith() takes 1 argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_STRING(args[1])) {
-        runtimeError(vm, "Argument passed to endsWith() must be a string");
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
     ObjString *suffix = AS_STRING(args[1]);
 
@@ -415,11 +325,6 @@ static Value endsWithString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value leftStripString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "leftStrip() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
     int i, count = 0;
     char *temp = ALLOCATE(vm, char, string->length + 1);
@@ -441,11 +346,6 @@ static Value leftStripString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value rightStripString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "rightStrip() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
     int length;
     char *temp = ALLOCATE(vm, char, string->length + 1);
@@ -467,11 +367,6 @@ static Value rightStripString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value stripString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "strip() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     Value string = leftStripString(vm, 0, args);
     push(vm, string);
     string = rightStripString(vm, 0, &string);
@@ -480,16 +375,6 @@ static Value stripString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value countString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "count() takes 1 argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_STRING(args[1])) {
-        runtimeError(vm, "Argument passed to count() must be a string");
-        return EMPTY_VAL;
-    }
-
     char *haystack = AS_CSTRING(args[0]);
     char *needle = AS_CSTRING(args[1]);
 
@@ -503,11 +388,6 @@ static Value countString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value titleString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 0) {
-        runtimeError(vm, "title() takes no arguments (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
     char *temp = ALLOCATE(vm, char, string->length + 1);
 
@@ -531,16 +411,6 @@ static Value titleString(DictuVM *vm, int argCount, Value *args) {
 }
 
 static Value repeatString(DictuVM *vm, int argCount, Value *args) {
-    if (argCount != 1) {
-        runtimeError(vm, "repeat() takes one argument (%d given)", argCount);
-        return EMPTY_VAL;
-    }
-
-    if (!IS_NUMBER(args[1])) {
-        runtimeError(vm, "repeat() count argument must be a number");
-        return EMPTY_VAL;
-    }
-
     ObjString *string = AS_STRING(args[0]);
     int count = AS_NUMBER(args[1]);
 
@@ -556,23 +426,23 @@ static Value repeatString(DictuVM *vm, int argCount, Value *args) {
 }
 
 void declareStringMethods(DictuVM *vm) {
-    defineNative(vm, &vm->stringMethods, "len", lenString);
-    defineNative(vm, &vm->stringMethods, "toNumber", toNumberString);
+    defineTypedNative(vm, &vm->stringMethods, "len", lenString, "");
+    defineTypedNative(vm, &vm->stringMethods, "toNumber", toNumberString, "");
     defineNative(vm, &vm->stringMethods, "format", formatString);
-    defineNative(vm, &vm->stringMethods, "split", splitString);
-    defineNative(vm, &vm->stringMethods, "contains", containsString);
-    defineNative(vm, &vm->stringMethods, "find", findString);
-    defineNative(vm, &vm->stringMethods, "replace", replaceString);
-    defineNative(vm, &vm->stringMethods, "lower", lowerString);
-    defineNative(vm, &vm->stringMethods, "upper", upperString);
-    defineNative(vm, &vm->stringMethods, "startsWith", startsWithString);
-    defineNative(vm, &vm->stringMethods, "endsWith", endsWithString);
-    defineNative(vm, &vm->stringMethods, "leftStrip", leftStripString);
-    defineNative(vm, &vm->stringMethods, "rightStrip", rightStripString);
-    defineNative(vm, &vm->stringMethods, "strip", stripString);
-    defineNative(vm, &vm->stringMethods, "count", countString);
+    defineTypedNative(vm, &vm->stringMethods, "split", splitString, "s|n");
+    defineTypedNative(vm, &vm->stringMethods, "contains", containsString, "s");
+    defineTypedNative(vm, &vm->stringMethods, "find", findString, "s|n");
+    defineTypedNative(vm, &vm->stringMethods, "replace", replaceString, "ss");
+    defineTypedNative(vm, &vm->stringMethods, "lower", lowerString, "");
+    defineTypedNative(vm, &vm->stringMethods, "upper", upperString, "");
+    defineTypedNative(vm, &vm->stringMethods, "startsWith", startsWithString, "s");
+    defineTypedNative(vm, &vm->stringMethods, "endsWith", endsWithString, "s");
+    defineTypedNative(vm, &vm->stringMethods, "leftStrip", leftStripString, "");
+    defineTypedNative(vm, &vm->stringMethods, "rightStrip", rightStripString, "");
+    defineTypedNative(vm, &vm->stringMethods, "strip", stripString, "");
+    defineTypedNative(vm, &vm->stringMethods, "count", countString, "s");
     defineNative(vm, &vm->stringMethods, "toBool", boolNative); // Defined in util
-    defineNative(vm, &vm->stringMethods, "title", titleString);
-    defineNative(vm, &vm->stringMethods, "repeat", repeatString);
+    defineTypedNative(vm, &vm->stringMethods, "title", titleString, "");
+    defineTypedNative(vm, &vm->stringMethods, "repeat", repeatString, "n");
 
 }
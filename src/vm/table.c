@@ -1,81 +1,124 @@
+#include <stdlib.h>
 #include <string.h>
 
+#include "heap.h"
 #include "memory.h"
 #include "table.h"
 #include "value.h"
+#include "vm.h"
 
 #define TABLE_MAX_LOAD 0.75
 
+// Load below which a collection shrinks the intern table, see
+// tableRemoveWhite.
+#define TABLE_MIN_LOAD 0.25
+
+/*
+ * Growing a table rehashes every entry into the new array, for a table
+ * of millions of keys a pause of its own. From TABLE_INCREMENTAL_MIN
+ * slots the old array is kept alongside the new one instead, and each
+ * tableSet or tableDelete moves the entries of the next
+ * TABLE_MIGRATE_STEP of its slots over. A key is in one array or the
+ * other, lookups that miss the new one try the old.
+ *
+ * The old array is recorded in a TableResize allocated in front of the
+ * new one's entries rather than in the Table, which is embedded in
+ * every instance and class.
+ *
+ * Entries are taken out of the old array with the same backward shift
+ * as tableDelete, so what is left stays a valid table and the slots
+ * before the migrated mark stay empty. The new array holds twice the
+ * slots, the old one is done long before the new one fills.
+ */
+#define TABLE_MIGRATE_STEP 8
+
 void initTable(Table *table) {
     table->count = 0;
     table->capacityMask = -1;
     table->entries = NULL;
 }
 
-void freeTable(DictuVM *vm, Table *table) {
-    FREE_ARRAY(vm, Entry, table->entries, table->capacityMask + 1);
-    initTable(table);
-}
-
-bool tableGet(Table *table, ObjString *key, Value *value) {
-    if (table->count == 0) return false;
+static size_t entriesSize(int capacity) {
+    size_t size = sizeof(Entry) * capacity;
 
-    Entry *entry;
-    uint32_t index = key->hash & table->capacityMask;
-    uint32_t psl = 0;
-
-    for (;;) {
-        entry = &table->entries[index];
-
-        if (entry->key == NULL || psl > entry->psl) {
-            return false;
-        }
+    if (capacity >= TABLE_INCREMENTAL_MIN) {
+        size += sizeof(TableResize);
+    }
 
-        if (entry->key == key) {
-            break;
-        }
+    return size;
+}
 
-        index = (index + 1) & table->capacityMask;
-        psl++;
+// The start of the block an array of entries was allocated as.
+static void *entriesBlock(Entry *entries, int capacity) {
+    if (capacity >= TABLE_INCREMENTAL_MIN) {
+        return (TableResize *) entries - 1;
     }
 
-    *value = entry->value;
-    return true;
+    return entries;
 }
 
-static void adjustCapacity(DictuVM *vm, Table *table, int capacityMask) {
-    Entry *entries = ALLOCATE(vm, Entry, capacityMask + 1);
-    for (int i = 0; i <= capacityMask; i++) {
+// Allocates an array of empty entries, a large one with a TableResize
+// in front that points at no array.
+static Entry *allocateEntries(DictuVM *vm, int capacity) {
+    if (capacity >= TABLE_INCREMENTAL_MIN) {
+        // Filling in the empty entries would touch the whole array at
+        // once. Zeroed ones have no key, and the number 0 for a value.
+        TableResize *resize = allocateZeroed(vm, entriesSize(capacity));
+        return (Entry *) (resize + 1);
+    }
+
+    Entry *entries = ALLOCATE(vm, Entry, capacity);
+    for (int i = 0; i < capacity; i++) {
         entries[i].key = NULL;
         entries[i].value = NIL_VAL;
         entries[i].psl = 0;
     }
 
-    Entry *oldEntries = table->entries;
-    int oldMask = table->capacityMask;
+    return entries;
+}
 
-    table->count = 0;
-    table->entries = entries;
-    table->capacityMask = capacityMask;
+static void freeEntries(DictuVM *vm, Entry *entries, int capacityMask) {
+    if (entries == NULL) {
+        return;
+    }
 
-    for (int i = 0; i <= oldMask; i++) {
-        Entry *entry = &oldEntries[i];
-        if (entry->key == NULL) continue;
+    reallocate(vm, entriesBlock(entries, capacityMask + 1), entriesSize(capacityMask + 1), 0);
+}
+
+void freeTable(DictuVM *vm, Table *table) {
+    TableResize *resize = tableResize(table);
 
-        tableSet(vm, table, entry->key, entry->value);
+    if (resize != NULL) {
+        freeEntries(vm, resize->entries, resize->capacityMask);
     }
 
-    FREE_ARRAY(vm, Entry, oldEntries, oldMask + 1);
+    freeEntries(vm, table->entries, table->capacityMask);
+    initTable(table);
 }
 
-bool tableSet(DictuVM *vm, Table *table, ObjString *key, Value value) {
-    if (table->count + 1 > (table->capacityMask + 1) * TABLE_MAX_LOAD) {
-        // Figure out the new table size.
-        int capacityMask = GROW_CAPACITY(table->capacityMask + 1) - 1;
-        adjustCapacity(vm, table, capacityMask);
+static inline Entry *findEntry(Entry *entries, int capacityMask, ObjString *key) {
+    uint32_t index = key->hash & capacityMask;
+    uint32_t psl = 0;
+
+    for (;;) {
+        Entry *entry = &entries[index];
+
+        if (entry->key == NULL || psl > entry->psl) {
+            return NULL;
+        }
+
+        if (entry->key == key) {
+            return entry;
+        }
+
+        index = (index + 1) & capacityMask;
+        psl++;
     }
+}
 
-    uint32_t index = key->hash & table->capacityMask;
+// Sets the value of key, returning true if it was not there before.
+static bool insertEntry(Entry *entries, int capacityMask, ObjString *key, Value value) {
+    uint32_t index = key->hash & capacityMask;
     Entry *bucket;
     bool isNewKey = false;
 
@@ -85,7 +128,7 @@ bool tableSet(DictuVM *vm, Table *table, ObjString *key, Value value) {
     entry.psl = 0;
 
     for (;;) {
-        bucket = &table->entries[index];
+        bucket = &entries[index];
 
         if (bucket->key == NULL) {
             isNewKey = true;
@@ -103,40 +146,16 @@ bool tableSet(DictuVM *vm, Table *table, ObjString *key, Value value) {
             }
         }
 
-        index = (index + 1) & table->capacityMask;
+        index = (index + 1) & capacityMask;
         entry.psl++;
     }
 
     *bucket = entry;
-    if (isNewKey) table->count++;
     return isNewKey;
 }
 
-bool tableDelete(DictuVM *vm, Table *table, ObjString *key) {
-    UNUSED(vm);
-    if (table->count == 0) return false;
-
-    int capacityMask = table->capacityMask;
-    uint32_t index = key->hash & table->capacityMask;
-    uint32_t psl = 0;
-    Entry *entry;
-
-    for (;;) {
-        entry = &table->entries[index];
-
-        if (entry->key == NULL || psl > entry->psl) {
-            return false;
-        }
-
-        if (entry->key == key) {
-            break;
-        }
-
-        index = (index + 1) & capacityMask;
-        psl++;
-    }
-
-    table->count--;
+static void removeEntry(Entry *entries, int capacityMask, Entry *entry) {
+    uint32_t index = entry - entries;
 
     for (;;) {
         Entry *nextEntry;
@@ -145,7 +164,7 @@ bool tableDelete(DictuVM *vm, Table *table, ObjString *key) {
         entry->psl = 0;
 
         index = (index + 1) & capacityMask;
-        nextEntry = &table->entries[index];
+        nextEntry = &entries[index];
 
         /*
          * Stop if we reach an empty bucket or hit a key which
@@ -159,7 +178,143 @@ bool tableDelete(DictuVM *vm, Table *table, ObjString *key) {
         *entry = *nextEntry;
         entry = nextEntry;
     }
+}
+
+// Moves the entries of the next steps slots of the old array over,
+// freeing it once the last is.
+static void migrateEntries(DictuVM *vm, Table *table, TableResize *resize, int steps) {
+    while (steps > 0 && resize->migrated <= resize->capacityMask) {
+        Entry *entry = &resize->entries[resize->migrated];
+
+        // Removing the entry shifts the next one of its run into the
+        // slot, which is looked at again.
+        if (entry->key == NULL) {
+            resize->migrated++;
+        } else {
+            insertEntry(table->entries, table->capacityMask, entry->key, entry->value);
+            removeEntry(resize->entries, resize->capacityMask, entry);
+        }
+
+        steps--;
+    }
+
+    if (resize->migrated > resize->capacityMask) {
+        freeEntries(vm, resize->entries, resize->capacityMask);
+        resize->entries = NULL;
+    }
+}
+
+void tableFinishResize(DictuVM *vm, Table *table) {
+    TableResize *resize = tableResize(table);
+
+    if (resize != NULL) {
+        migrateEntries(vm, table, resize, INT32_MAX);
+    }
+}
+
+bool tableGet(Table *table, ObjString *key, Value *value) {
+    if (table->count == 0) return false;
+
+    Entry *entry = findEntry(table->entries, table->capacityMask, key);
+
+    if (entry == NULL) {
+        TableResize *resize = tableResize(table);
+        if (resize == NULL) {
+            return false;
+        }
+
+        entry = findEntry(resize->entries, resize->capacityMask, key);
+        if (entry == NULL) {
+            return false;
+        }
+    }
 
+    *value = entry->value;
+    return true;
+}
+
+static void adjustCapacity(DictuVM *vm, Table *table, int capacityMask) {
+    Entry *entries = allocateEntries(vm, capacityMask + 1);
+    Entry *oldEntries = table->entries;
+    int oldMask = table->capacityMask;
+
+    table->entries = entries;
+    table->capacityMask = capacityMask;
+
+    if (capacityMask + 1 >= TABLE_INCREMENTAL_MIN && table->count > 0) {
+        TableResize *resize = (TableResize *) entries - 1;
+        resize->entries = oldEntries;
+        resize->capacityMask = oldMask;
+        resize->migrated = 0;
+        return;
+    }
+
+    for (int i = 0; i <= oldMask; i++) {
+        Entry *entry = &oldEntries[i];
+        if (entry->key == NULL) continue;
+
+        insertEntry(entries, capacityMask, entry->key, entry->value);
+    }
+
+    freeEntries(vm, oldEntries, oldMask);
+}
+
+bool tableSet(DictuVM *vm, Table *table, ObjString *key, Value value) {
+    if (table->count + 1 > (table->capacityMask + 1) * TABLE_MAX_LOAD) {
+        tableFinishResize(vm, table);
+
+        // Figure out the new table size.
+        int capacityMask = GROW_CAPACITY(table->capacityMask + 1) - 1;
+        adjustCapacity(vm, table, capacityMask);
+    }
+
+    TableResize *resize = tableResize(table);
+
+    if (resize != NULL) {
+        migrateEntries(vm, table, resize, TABLE_MIGRATE_STEP);
+
+        if (resize->entries != NULL) {
+            Entry *entry = findEntry(resize->entries, resize->capacityMask, key);
+
+            if (entry != NULL) {
+                entry->value = value;
+                return false;
+            }
+        }
+    }
+
+    bool isNewKey = insertEntry(table->entries, table->capacityMask, key, value);
+    if (isNewKey) table->count++;
+    return isNewKey;
+}
+
+bool tableDelete(DictuVM *vm, Table *table, ObjString *key) {
+    if (table->count == 0) return false;
+
+    TableResize *resize = tableResize(table);
+
+    if (resize != NULL) {
+        migrateEntries(vm, table, resize, TABLE_MIGRATE_STEP);
+    }
+
+    Entry *entry = findEntry(table->entries, table->capacityMask, key);
+
+    if (entry != NULL) {
+        removeEntry(table->entries, table->capacityMask, entry);
+    } else {
+        if (resize == NULL || resize->entries == NULL) {
+            return false;
+        }
+
+        entry = findEntry(resize->entries, resize->capacityMask, key);
+        if (entry == NULL) {
+            return false;
+        }
+
+        removeEntry(resize->entries, resize->capacityMask, entry);
+    }
+
+    table->count--;
     return true;
 }
 
@@ -170,22 +325,30 @@ void tableAddAll(DictuVM *vm, Table *from, Table *to) {
             tableSet(vm, to, entry->key, entry->value);
         }
     }
-}
 
-// TODO: Return entry here rather than string
-ObjString *tableFindString(Table *table, const char *chars, int length,
-                           uint32_t hash) {
-    // If the table is empty, we definitely won't find it.
-    if (table->count == 0) return NULL;
+    TableResize *resize = tableResize(from);
+    if (resize == NULL) {
+        return;
+    }
 
+    for (int i = 0; i <= resize->capacityMask; i++) {
+        Entry *entry = &resize->entries[i];
+        if (entry->key != NULL) {
+            tableSet(vm, to, entry->key, entry->value);
+        }
+    }
+}
+
+static ObjString *findString(Entry *entries, int capacityMask, const char *chars,
+                             int length, uint32_t hash) {
     // Figure out where to insert it in the table. Use open addressing and
     // basic linear probing.
 
-    uint32_t index = hash & table->capacityMask;
+    uint32_t index = hash & capacityMask;
     uint32_t psl = 0;
 
     for (;;) {
-        Entry *entry = &table->entries[index];
+        Entry *entry = &entries[index];
 
         if (entry->key == NULL || psl > entry->psl) {
             return NULL;
@@ -198,18 +361,147 @@ ObjString *tableFindString(Table *table, const char *chars, int length,
             return entry->key;
         }
 
-        index = (index + 1) & table->capacityMask;
+        index = (index + 1) & capacityMask;
         psl++;
     }
 }
 
-void tableRemoveWhite(DictuVM *vm, Table *table) {
-    for (int i = 0; i <= table->capacityMask; i++) {
+// TODO: Return entry here rather than string
+ObjString *tableFindString(Table *table, const char *chars, int length,
+                           uint32_t hash) {
+    // If the table is empty, we definitely won't find it.
+    if (table->count == 0) return NULL;
+
+    ObjString *string = findString(table->entries, table->capacityMask, chars, length, hash);
+
+    if (string == NULL) {
+        TableResize *resize = tableResize(table);
+
+        if (resize != NULL) {
+            string = findString(resize->entries, resize->capacityMask, chars, length, hash);
+        }
+    }
+
+    return string;
+}
+
+// Rebuilds a table a collection left mostly empty at a smaller size.
+// Runs inside a collection, so the entries are not allocated through
+// reallocate(), and a table that cannot be rebuilt is left as it is.
+static void shrinkTable(DictuVM *vm, Table *table) {
+    int oldCapacity = table->capacityMask + 1;
+    int capacity = oldCapacity;
+
+    while (capacity > 8 && table->count < capacity * TABLE_MIN_LOAD) {
+        capacity = SHRINK_CAPACITY(capacity);
+    }
+
+    if (capacity == oldCapacity) {
+        return;
+    }
+
+    void *block = malloc(entriesSize(capacity));
+    if (block == NULL) {
+        return;
+    }
+
+    Entry *entries = block;
+    if (capacity >= TABLE_INCREMENTAL_MIN) {
+        TableResize *resize = block;
+        resize->entries = NULL;
+        entries = (Entry *) (resize + 1);
+    }
+
+    for (int i = 0; i < capacity; i++) {
+        entries[i].key = NULL;
+        entries[i].value = NIL_VAL;
+        entries[i].psl = 0;
+    }
+
+    for (int i = 0; i < oldCapacity; i++) {
         Entry *entry = &table->entries[i];
-        if (entry->key != NULL && !entry->key->obj.isDark) {
-            tableDelete(vm, table, entry->key);
+        if (entry->key != NULL) {
+            insertEntry(entries, capacity - 1, entry->key, entry->value);
         }
     }
+
+    free(entriesBlock(table->entries, oldCapacity));
+    vm->bytesAllocated -= entriesSize(oldCapacity) - entriesSize(capacity);
+    table->entries = entries;
+    table->capacityMask = capacity - 1;
+}
+
+// Clears the entries of dead keys from one array of a table, returning
+// how many there were.
+static int removeWhiteEntries(Entry *entries, uint32_t capacityMask) {
+    int removed = 0;
+
+    // Start from an empty slot so no run of entries wraps past the
+    // start, the load factor leaves one.
+    uint32_t start = 0;
+    while (entries[start].key != NULL) {
+        start++;
+    }
+
+    // Removing every dead key in one pass. Each live entry moves back
+    // over the slots freed before it in its run, as it would through
+    // tableDelete's backward shifts, but no further than its home slot.
+    uint32_t hole = (start + 1) & capacityMask;
+
+    for (uint32_t n = 1; n <= capacityMask + 1; n++) {
+        uint32_t index = (start + n) & capacityMask;
+        Entry *entry = &entries[index];
+
+        if (entry->key == NULL) {
+            hole = (index + 1) & capacityMask;
+            continue;
+        }
+
+        if (!heapIsMarked(entry->key)) {
+            entry->key = NULL;
+            entry->value = NIL_VAL;
+            entry->psl = 0;
+            removed++;
+            continue;
+        }
+
+        uint32_t shift = (index - hole) & capacityMask;
+        if (shift > entry->psl) {
+            shift = entry->psl;
+        }
+
+        if (shift > 0) {
+            Entry *moved = &entries[(index - shift) & capacityMask];
+            *moved = *entry;
+            moved->psl -= shift;
+
+            entry->key = NULL;
+            entry->value = NIL_VAL;
+            entry->psl = 0;
+        }
+
+        hole = (index - shift + 1) & capacityMask;
+    }
+
+    return removed;
+}
+
+void tableRemoveWhite(DictuVM *vm, Table *table) {
+    if (table->count == 0) {
+        return;
+    }
+
+    table->count -= removeWhiteEntries(table->entries, table->capacityMask);
+
+    // Live entries only move back towards their home slot, never into
+    // the migrated slots before them.
+    TableResize *resize = tableResize(table);
+    if (resize != NULL) {
+        table->count -= removeWhiteEntries(resize->entries, resize->capacityMask);
+        return;
+    }
+
+    shrinkTable(vm, table);
 }
 
 void grayTable(DictuVM *vm, Table *table) {
@@ -218,4 +510,15 @@ void grayTable(DictuVM *vm, Table *table) {
         grayObject(vm, (Obj *) entry->key);
         grayValue(vm, entry->value);
     }
+
+    TableResize *resize = tableResize(table);
+    if (resize == NULL) {
+        return;
+    }
+
+    for (int i = 0; i <= resize->capacityMask; i++) {
+        Entry *entry = &resize->entries[i];
+        grayObject(vm, (Obj *) entry->key);
+        grayValue(vm, entry->value);
+    }
 }
@@ -12,12 +12,36 @@ typedef struct {
   uint32_t psl;
 } Entry;
 
+// Tables of at least this many slots grow incrementally, see table.c.
+#define TABLE_INCREMENTAL_MIN (64 * 1024)
+
+// Sits in front of the entries of an array of TABLE_INCREMENTAL_MIN
+// slots or more, pointing at the array the table is growing out of.
 typedef struct {
+  Entry *entries;
+  int capacityMask;
+
+  // Slots before this have been moved over and are empty.
+  int migrated;
+} TableResize;
+
+typedef struct {
+  // Entries in both arrays while the table grows.
   int count;
   int capacityMask;
   Entry *entries;
 } Table;
 
+// The array a table is still growing out of, NULL for most.
+static inline TableResize *tableResize(Table *table) {
+  if (table->capacityMask + 1 < TABLE_INCREMENTAL_MIN) {
+    return NULL;
+  }
+
+  TableResize *resize = (TableResize *) table->entries - 1;
+  return resize->entries == NULL ? NULL : resize;
+}
+
 void initTable(Table *table);
 
 void freeTable(DictuVM *vm, Table *table);
@@ -30,9 +54,15 @@ bool tableDelete(DictuVM *vm, Table *table, ObjString *key);
 
 void tableAddAll(DictuVM *vm, Table *from, Table *to);
 
+// Moves over every entry of a table still growing, so its entries can be
+// walked as a single array.
+void tableFinishResize(DictuVM *vm, Table *table);
+
 ObjString *tableFindString(Table *table, const char *chars, int length,
                            uint32_t hash);
 
+// Removes the keys of objects the last marking did not reach, and
+// shrinks the table once few are left.
 void tableRemoveWhite(DictuVM *vm, Table *table);
 
 void grayTable(DictuVM *vm, Table *table);
@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -121,6 +122,53 @@ void defineNative(DictuVM *vm, Table *table, const char *name, NativeFn function
     pop(vm);
 }
 
+static NativeParamType nativeParamType(char kind) {
+    switch (kind) {
+        case 'n': return NATIVE_PARAM_NUMBER;
+        case 's': return NATIVE_PARAM_STRING;
+        case 'l': return NATIVE_PARAM_LIST;
+        case 'd': return NATIVE_PARAM_DICT;
+        case 'b': return NATIVE_PARAM_BOOL;
+        default: return NATIVE_PARAM_ANY;
+    }
+}
+
+void defineTypedNative(DictuVM *vm, Table *table, const char *name, NativeFn function, const char *signature) {
+    ObjNative *native = newNative(vm, function);
+    push(vm, OBJ_VAL(native));
+    native->name = name;
+
+    // Decoded once here so calls only compare small integers.
+    int count = 0;
+    bool optional = false;
+
+    for (const char *kind = signature; *kind != '\0'; ++kind) {
+        if (*kind == '|') {
+            optional = true;
+            continue;
+        }
+
+        assert(count < NATIVE_MAX_PARAMS);
+        native->params[count++] = nativeParamType(*kind);
+
+        if (native->params[count - 1] != NATIVE_PARAM_ANY) {
+            native->typedParams = count;
+        }
+
+        if (!optional) {
+            native->minArity = count;
+        }
+    }
+
+    native->maxArity = count;
+
+    ObjString *methodName = copyString(vm, name, strlen(name));
+    push(vm, OBJ_VAL(methodName));
+    tableSet(vm, table, methodName, OBJ_VAL(native));
+    pop(vm);
+    pop(vm);
+}
+
 void defineNativeProperty(DictuVM *vm, Table *table, const char *name, Value value) {
     push(vm, value);
     ObjString *propertyName = copyString(vm, name, strlen(name));
@@ -9,6 +9,18 @@ ObjString *getDirectory(DictuVM *vm, char *source);
 
 void defineNative(DictuVM *vm, Table *table, const char *name, NativeFn function);
 
+/*
+ * Registers a native whose arguments the VM checks before calling it.
+ * The signature has one character per parameter:
+ *
+ *   n number, s string, l list, d dict, b bool, . any value
+ *
+ * and parameters following a '|' are optional, e.g. "s|n" for split().
+ * name must outlive the VM. Arguments are counted without
+ * the receiver, so methods only describe what follows it.
+ */
+void defineTypedNative(DictuVM *vm, Table *table, const char *name, NativeFn function, const char *signature);
+
 void defineNativeProperty(DictuVM *vm, Table *table, const char *name, Value value);
 
 bool isValidKey(Value value);
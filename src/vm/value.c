@@ -2,10 +2,13 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <math.h>
 
 #include "memory.h"
 #include "value.h"
 #include "vm.h"
+#include "bigint.h"
 
 #define TABLE_MAX_LOAD 0.75
 #define TABLE_MIN_LOAD 0.25
@@ -18,10 +21,13 @@ void initValueArray(ValueArray *array) {
 
 void writeValueArray(DictuVM *vm, ValueArray *array, Value value) {
     if (array->capacity < array->count + 1) {
+        // The allocation can unwind to vm->memoryError, so the array
+        // only takes the new capacity once it has the buffer for it.
         int oldCapacity = array->capacity;
-        array->capacity = GROW_CAPACITY(oldCapacity);
+        int capacity = GROW_CAPACITY(oldCapacity);
         array->values = GROW_ARRAY(vm, array->values, Value,
-                                   oldCapacity, array->capacity);
+                                   oldCapacity, capacity);
+        array->capacity = capacity;
     }
 
     array->values[array->count] = value;
@@ -52,6 +58,24 @@ static uint32_t hashObject(Obj *object) {
             return ((ObjString *) object)->hash;
         }
 
+        case OBJ_BIGINT: {
+            ObjBigInt *bigInt = (ObjBigInt *) object;
+            double number;
+
+            // valuesEqual lets a BigInt equal a number, so it has to
+            // hash like one.
+            if (bigIntToExactNumber(bigInt, &number)) {
+                return hashBits(NUMBER_VAL(number));
+            }
+
+            uint64_t hash = (uint64_t) bigInt->sign;
+            for (int i = 0; i < bigInt->count; i++) {
+                hash = hash * 31 + bigInt->limbs[i];
+            }
+
+            return hashBits(hash);
+        }
+
             // Should never get here
         default: {
 #ifdef DEBUG_PRINT_CODE
@@ -70,6 +94,11 @@ static uint32_t hashValue(Value value) {
         return hashObject(AS_OBJ(value));
     }
 
+    // Integers hash as the equal double so 1 and 1.0 are the same key.
+    if (IS_INT(value)) {
+        return hashBits(NUMBER_VAL(AS_NUMBER(value)));
+    }
+
     return hashBits(value);
 }
 
@@ -343,6 +372,12 @@ char *valueToString(Value value) {
         char *nilString = malloc(sizeof(char) * 4);
         snprintf(nilString, 4, "%s", "nil");
         return nilString;
+    } else if (IS_INT(value)) {
+        int64_t number = AS_INT(value);
+        int numberStringLength = snprintf(NULL, 0, "%" PRId64, number) + 1;
+        char *numberString = malloc(sizeof(char) * numberStringLength);
+        snprintf(numberString, numberStringLength, "%" PRId64, number);
+        return numberString;
     } else if (IS_NUMBER(value)) {
         double number = AS_NUMBER(value);
         int numberStringLength = snprintf(NULL, 0, "%.15g", number) + 1;
@@ -439,6 +474,12 @@ char *valueTypeToString(DictuVM *vm, Value value, int *length) {
             case OBJ_RESULT: {
                 CONVERT(result, 6);
             }
+            case OBJ_STREAM: {
+                CONVERT(stream, 6);
+            }
+            case OBJ_BIGINT: {
+                CONVERT(bigint, 6);
+            }
             default:
                 break;
         }
@@ -558,11 +599,67 @@ bool valuesEqual(Value a, Value b) {
                 return setComparison(a, b);
             }
 
+            case OBJ_BIGINT: {
+                ObjBigInt *bigIntA = AS_BIGINT(a);
+                ObjBigInt *bigIntB = AS_BIGINT(b);
+
+                return bigIntA->sign == bigIntB->sign && bigIntA->count == bigIntB->count &&
+                       memcmp(bigIntA->limbs, bigIntB->limbs, sizeof(uint32_t) * bigIntA->count) == 0;
+            }
+
                 // Pass through
             default:
                 break;
         }
     }
 
+    if (IS_BIGINT(a) && IS_NUMBER(b)) {
+        return bigIntEqualsNumber(AS_BIGINT(a), b);
+    } else if (IS_NUMBER(a) && IS_BIGINT(b)) {
+        return bigIntEqualsNumber(AS_BIGINT(b), a);
+    }
+
+    if (IS_INT(a) != IS_INT(b) && IS_NUMBER(a) && IS_NUMBER(b)) {
+        return AS_NUMBER(a) == AS_NUMBER(b);
+    }
+
     return a == b;
 }
+
+int64_t valueToInteger(Value value) {
+    if (IS_INT(value)) {
+        return AS_INT(value);
+    }
+
+    double number = AS_NUMBER(value);
+
+    // Out of range conversions are undefined in C, saturate instead.
+    if (number != number) {
+        return 0;
+    } else if (number >= 9223372036854775807.0) {
+        return INT64_MAX;
+    } else if (number <= -9223372036854775808.0) {
+        return INT64_MIN;
+    }
+
+    return (int64_t) number;
+}
+
+Value powNumbers(Value a, Value b) {
+    double result = pow(AS_NUMBER(a), AS_NUMBER(b));
+
+    if (IS_INT(a) && IS_INT(b) && AS_INT(b) >= 0 &&
+        result >= INT48_MIN && result <= INT48_MAX) {
+        return INT_VAL((int64_t) result);
+    }
+
+    return NUMBER_VAL(result);
+}
+
+Value modNumbers(Value a, Value b) {
+    if (IS_INT(a) && IS_INT(b) && AS_INT(b) != 0) {
+        return integerToValue(AS_INT(a) % AS_INT(b));
+    }
+
+    return NUMBER_VAL(fmod(AS_NUMBER(a), AS_NUMBER(b)));
+}
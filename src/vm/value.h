@@ -25,17 +25,29 @@ typedef struct sObjResult ObjResult;
 #define TAG_TRUE   3
 #define TAG_EMPTY  4
 
+// Integers are stored unboxed as a quiet NaN with the int tag set and a
+// 48 bit two's complement payload. Results that leave the 48 bit range
+// are promoted to doubles.
+#define TAG_INT    ((uint64_t)1 << 49)
+#define INT_MASK   ((uint64_t)0xffffffffffff)
+#define INT48_MIN  (-((int64_t)1 << 47))
+#define INT48_MAX  (((int64_t)1 << 47) - 1)
+
 typedef uint64_t Value;
 
 #define IS_BOOL(v)    (((v) | 1) == TRUE_VAL)
 #define IS_NIL(v)     ((v) == NIL_VAL)
 #define IS_EMPTY(v)   ((v) == EMPTY_VAL)
-// If the NaN bits are set, it's not a number.
-#define IS_NUMBER(v)  (((v) & QNAN) != QNAN)
+// If the NaN bits are set, it's not a double.
+#define IS_DOUBLE(v)  (((v) & QNAN) != QNAN)
+#define IS_INT(v)     (((v) & (SIGN_BIT | QNAN | TAG_INT)) == (QNAN | TAG_INT))
+#define IS_NUMBER(v)  (IS_DOUBLE(v) || IS_INT(v))
 #define IS_OBJ(v)     (((v) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
 
 #define AS_BOOL(v)    ((v) == TRUE_VAL)
 #define AS_NUMBER(v)  valueToNum(v)
+// Shift the payload to the top and back down to sign extend it.
+#define AS_INT(v)     ((int64_t)((v) << 16) >> 16)
 #define AS_OBJ(v)     ((Obj*)(uintptr_t)((v) & ~(SIGN_BIT | QNAN)))
 
 #define BOOL_VAL(boolean)   ((boolean) ? TRUE_VAL : FALSE_VAL)
@@ -44,6 +56,7 @@ typedef uint64_t Value;
 #define NIL_VAL             ((Value)(uint64_t)(QNAN | TAG_NIL))
 #define EMPTY_VAL           ((Value)(uint64_t)(QNAN | TAG_EMPTY))
 #define NUMBER_VAL(num)   numToValue(num)
+#define INT_VAL(i)        ((Value)(QNAN | TAG_INT | ((uint64_t)(i) & INT_MASK)))
 // The triple casting is necessary here to satisfy some compilers:
 // 1. (uintptr_t) Convert the pointer to a number of the right size.
 // 2. (uint64_t)  Pad it up to 64 bits in 32-bit builds.
@@ -60,6 +73,10 @@ typedef union {
 } DoubleUnion;
 
 static inline double valueToNum(Value value) {
+    if (IS_INT(value)) {
+        return (double) AS_INT(value);
+    }
+
     DoubleUnion data;
     data.bits64 = value;
     return data.num;
@@ -71,6 +88,41 @@ static inline Value numToValue(double num) {
     return data.bits64;
 }
 
+static inline Value integerToValue(int64_t integer) {
+    if (integer >= INT48_MIN && integer <= INT48_MAX) {
+        return INT_VAL(integer);
+    }
+
+    return numToValue((double) integer);
+}
+
+static inline Value multiplyIntegers(int64_t a, int64_t b) {
+    // The double product is within an ulp of the real one, so if it is
+    // in range the int64 product cannot have overflowed.
+    double product = (double) a * (double) b;
+
+    if (product >= INT48_MIN && product <= INT48_MAX) {
+        return INT_VAL(a * b);
+    }
+
+    return numToValue(product);
+}
+
+static inline Value divideIntegers(int64_t a, int64_t b) {
+    if (b != 0 && a % b == 0) {
+        return integerToValue(a / b);
+    }
+
+    return numToValue((double) a / (double) b);
+}
+
+// Truncates a number to an int64 for the bitwise operators.
+int64_t valueToInteger(Value value);
+
+Value powNumbers(Value a, Value b);
+
+Value modNumbers(Value a, Value b);
+
 typedef struct {
     int capacity;
     int count;
@@ -15,7 +15,12 @@
 #include "natives.h"
 #include "strings.h"
 #include "lists.h"
+#include "iterators.h"
+#include "streams.h"
+#include "bigint.h"
+#include "abstracts.h"
 #include "optionals.h"
+#include "aot.h"
 
 static void resetStack(DictuVM *vm) {
   vm->stackTop = vm->stack;
@@ -71,6 +76,13 @@ void runtimeError(DictuVM *vm, const char *format, ...) {
 }
 int count = 0;
 DictuVM *dictuInitVM(bool repl, int argc, char **argv) {
+  DictuGCOptions options;
+  dictuDefaultGCOptions(&options);
+
+  return dictuInitVMWithOptions(repl, argc, argv, &options);
+}
+
+DictuVM *dictuInitVMWithOptions(bool repl, int argc, char **argv, const DictuGCOptions *options) {
   DictuVM *vm = malloc(sizeof(*vm));
 
   if (vm == NULL) {
@@ -81,18 +93,36 @@ DictuVM *dictuInitVM(bool repl, int argc, char **argv) {
   memset(vm, '\0', sizeof(DictuVM));
 
   resetStack(vm);
-  vm->objects = NULL;
+  initHeap(&vm->heap);
   vm->repl = repl;
   vm->frameCapacity = 4;
   vm->frames = NULL;
   vm->initString = NULL;
   vm->replVar = NULL;
+  vm->handles = NULL;
+  vm->abstractTypes = NULL;
+  vm->weakRefs = NULL;
+  vm->weakDicts = NULL;
+  vm->callResult = NIL_VAL;
   vm->bytesAllocated = 0;
-  vm->nextGC = 1024 * 1024;
-  vm->grayCount = 0;
-  vm->grayCapacity = 0;
-  vm->grayStack = NULL;
+  vm->minHeap = options->minHeap;
+  vm->maxHeap = options->maxHeap;
+  vm->gcTarget = options->target;
+  vm->heapGrowth = GC_HEAP_GROW_FACTOR - 1;
+  vm->gcCycleStart = gcClock();
+  vm->memoryError = NULL;
+  vm->nextGC = vm->minHeap;
+  initMarker(&vm->marker);
+  vm->markThreads = options->markThreads > 0 ? options->markThreads : defaultMarkThreads();
+  vm->markPool = NULL;
+  vm->compact = options->compact;
+  vm->compactPending = false;
   vm->lastModule = NULL;
+  vm->mathModule = NULL;
+  vm->varargsPoolCount = 0;
+  vm->aotEntries = NULL;
+  vm->aotEntryCount = 0;
+  vm->aotDepth = 0;
   vm->argc = argc;
   vm->argv = argv;
   initTable(&vm->modules);
@@ -111,14 +141,20 @@ DictuVM *dictuInitVM(bool repl, int argc, char **argv) {
   initTable(&vm->classMethods);
   initTable(&vm->instanceMethods);
   initTable(&vm->resultMethods);
+  initTable(&vm->streamMethods);
+  initTable(&vm->bigIntMethods);
 
   vm->frames = ALLOCATE(vm, CallFrame, vm->frameCapacity);
   vm->initString = copyString(vm, "init", 4);
+  vm->hasNextString = copyString(vm, "hasNext", 7);
+  vm->nextString = copyString(vm, "next", 4);
   // Native functions
   defineAllNatives(vm);
   // Native methods
   declareStringMethods(vm);
   declareListMethods(vm);
+  declareStreamMethods(vm);
+  declareBigIntMethods(vm);
   
   /*
   // Native methods
@@ -168,9 +204,20 @@ void dictuFreeVM(DictuVM *vm) {
   freeTable(vm, &vm->classMethods);
   freeTable(vm, &vm->instanceMethods);
   freeTable(vm, &vm->resultMethods);
+  freeTable(vm, &vm->streamMethods);
+  freeTable(vm, &vm->bigIntMethods);
   FREE_ARRAY(vm, CallFrame, vm->frames, vm->frameCapacity);
   vm->initString = NULL;
+  vm->hasNextString = NULL;
+  vm->nextString = NULL;
   vm->replVar = NULL;
+
+  while (vm->handles != NULL) {
+    dictuReleaseHandle(vm, vm->handles);
+  }
+
+  freeAbstractTypes(vm);
+
   freeObjects(vm);
 
 #if defined(DEBUG_TRACE_MEM) || defined(DEBUG_FINAL_MEM)
@@ -199,13 +246,44 @@ Value peek(DictuVM *vm, int distance) {
     return vm->stackTop[-1 - distance];
 }
 
+static ObjList *newVarargsList(DictuVM *vm, ObjFunction *function) {
+  if (function->pooledVarargs && vm->varargsPoolCount > 0) {
+    return vm->varargsPool[--vm->varargsPoolCount];
+  }
+
+  return newList(vm);
+}
+
+// Hands the list of a returning variadic call back to the pool, the
+// compiler has made sure nothing else refers to it. The slot is only
+// trusted while it still holds the list call() created for the frame.
+static void releaseVarargsList(DictuVM *vm, CallFrame *frame) {
+  ObjList *list = frame->varargs;
+  Value value = frame->slots[frame->closure->function->arity];
+
+  if (list == NULL || !IS_LIST(value) || AS_LIST(value) != list ||
+      vm->varargsPoolCount == VARARGS_POOL_MAX) {
+    return;
+  }
+
+  if (list->values.capacity > VARARGS_POOL_CAPACITY) {
+    freeValueArray(vm, &list->values);
+  }
+
+  list->values.count = 0;
+  vm->varargsPool[vm->varargsPoolCount++] = list;
+}
+
 static bool call(DictuVM *vm, ObjClosure *closure, int argCount) {
+  ObjList *varargs = NULL;
+
   if (argCount < closure->function->arity) {
     if ((argCount + closure->function->isVariadic) == closure->function->arity) {
       // add missing variadic param ([])
-      ObjList *list = newList(vm);
+      ObjList *list = newVarargsList(vm, closure->function);
       push(vm, OBJ_VAL(list));
       argCount++;
+      varargs = list;
     } else {
       runtimeError(vm,
 		   "Function '%s' expected %d argument(s) but got %d.",
@@ -220,16 +298,17 @@ static bool call(DictuVM *vm, ObjClosure *closure, int argCount) {
     if (closure->function->isVariadic) {
       int arity = closure->function->arity + closure->function->arityOptional;
       // +1 for the variadic param itself
-      int varargs = argCount - arity + 1;
-      ObjList *list = newList(vm);
+      int count = argCount - arity + 1;
+      ObjList *list = newVarargsList(vm, closure->function);
       push(vm, OBJ_VAL(list));
-      for (int i = varargs; i > 0; i--) {
+      for (int i = count; i > 0; i--) {
         writeValueArray(vm, &list->values, peek(vm, i));
       }
       // +1 for the list pushed earlier on the stack
-      vm->stackTop -= varargs + 1;
+      vm->stackTop -= count + 1;
       push(vm, OBJ_VAL(list));
       argCount = arity;
+      varargs = list;
     } else {
       runtimeError(vm, "Function '%s' expected %d argument(s) but got %d.",
 		   closure->function->name->chars,
@@ -240,17 +319,19 @@ static bool call(DictuVM *vm, ObjClosure *closure, int argCount) {
     }
   } else if (closure->function->isVariadic) {
     // last argument is the variadic arg
-    ObjList *list = newList(vm);
+    ObjList *list = newVarargsList(vm, closure->function);
     push(vm, OBJ_VAL(list));
     writeValueArray(vm, &list->values, peek(vm, 1));
     vm->stackTop -= 2;
     push(vm, OBJ_VAL(list));
+    varargs = list;
   }
   if (vm->frameCount == vm->frameCapacity) {
     int oldCapacity = vm->frameCapacity;
-    vm->frameCapacity = GROW_CAPACITY(vm->frameCapacity);
+    int capacity = GROW_CAPACITY(oldCapacity);
     vm->frames = GROW_ARRAY(vm, vm->frames, CallFrame,
-                           oldCapacity, vm->frameCapacity);
+                           oldCapacity, capacity);
+    vm->frameCapacity = capacity;
   }
 
   CallFrame *frame = &vm->frames[vm->frameCount++];
@@ -258,10 +339,109 @@ static bool call(DictuVM *vm, ObjClosure *closure, int argCount) {
   frame->ip = closure->function->chunk.code;
 
   frame->slots = vm->stackTop - argCount - 1;
+  frame->varargs = varargs;
+
+  // Compiled functions run their frame to completion here, like a
+  // native. Past AOT_MAX_DEPTH the interpreter runs it instead so deep
+  // recursion does not exhaust the C stack.
+  if (closure->function->aot != NULL && vm->aotDepth < AOT_MAX_DEPTH) {
+    vm->aotDepth++;
+    bool result = closure->function->aot(vm);
+    vm->aotDepth--;
+    return result;
+  }
 
   return true;
 }
 
+static const char *nativeParamNames[] = {
+  [NATIVE_PARAM_ANY] = "value",
+  [NATIVE_PARAM_NUMBER] = "number",
+  [NATIVE_PARAM_STRING] = "string",
+  [NATIVE_PARAM_LIST] = "list",
+  [NATIVE_PARAM_DICT] = "dict",
+  [NATIVE_PARAM_BOOL] = "bool",
+};
+
+static inline bool nativeParamMatches(uint8_t type, Value value) {
+  switch (type) {
+    case NATIVE_PARAM_NUMBER: return IS_NUMBER(value);
+    case NATIVE_PARAM_STRING: return IS_STRING(value);
+    case NATIVE_PARAM_LIST: return IS_LIST(value);
+    case NATIVE_PARAM_DICT: return IS_DICT(value);
+    case NATIVE_PARAM_BOOL: return IS_BOOL(value);
+    default: return true;
+  }
+}
+
+// Kept out of line so the checks inlined into the call path stay small.
+static bool nativeArgumentError(DictuVM *vm, ObjNative *native, int argCount) {
+  if (argCount < native->minArity || argCount > native->maxArity) {
+    if (native->maxArity == 0) {
+      runtimeError(vm, "%s() takes no arguments (%d given)", native->name, argCount);
+    } else if (native->minArity == native->maxArity) {
+      runtimeError(vm, "%s() takes %d argument%s (%d given)", native->name,
+                   native->minArity, native->minArity == 1 ? "" : "s", argCount);
+    } else {
+      runtimeError(vm, "%s() takes %d to %d arguments (%d given)", native->name,
+                   native->minArity, native->maxArity, argCount);
+    }
+
+    return false;
+  }
+
+  Value *args = vm->stackTop - argCount;
+
+  for (int i = 0; i < argCount; ++i) {
+    if (!nativeParamMatches(native->params[i], args[i])) {
+      runtimeError(vm, "Argument %d passed to %s() must be a %s", i + 1,
+                   native->name, nativeParamNames[native->params[i]]);
+      break;
+    }
+  }
+
+  return false;
+}
+
+// Checks the arguments on top of the stack against the signature of a
+// typed native, so the natives themselves don't have to.
+static inline bool checkNativeArguments(DictuVM *vm, ObjNative *native, int argCount) {
+  if (argCount < native->minArity || argCount > native->maxArity) {
+    return nativeArgumentError(vm, native, argCount);
+  }
+
+  Value *args = vm->stackTop - argCount;
+  int typed = argCount < native->typedParams ? argCount : native->typedParams;
+
+  for (int i = 0; i < typed; ++i) {
+    if (!nativeParamMatches(native->params[i], args[i])) {
+      return nativeArgumentError(vm, native, argCount);
+    }
+  }
+
+  return true;
+}
+
+// Calls a native with its arguments on top of the stack. Methods are
+// handed the receiver as args[0]. The result is written straight into
+// the slot of the callee, or receiver, below the arguments.
+static inline bool callNative(DictuVM *vm, ObjNative *native, int argCount, bool method) {
+  Value *slot = vm->stackTop - argCount - 1;
+
+  if (!checkNativeArguments(vm, native, argCount)) {
+    return false;
+  }
+
+  Value result = native->function(vm, argCount, method ? slot : slot + 1);
+
+  if (IS_EMPTY(result))
+    return false;
+
+  *slot = result;
+  vm->stackTop = slot + 1;
+  return true;
+}
+
 static bool callValue(DictuVM *vm, Value callee, int argCount, bool unpack) {
   if (IS_OBJ(callee)) {
     HANDLE_UNPACK
@@ -305,15 +485,7 @@ static bool callValue(DictuVM *vm, Value callee, int argCount, bool unpack) {
       }
 
       case OBJ_NATIVE: {
-        NativeFn native = AS_NATIVE(callee);
-        Value result = native(vm, argCount, vm->stackTop - argCount);
-
-        if (IS_EMPTY(result))
-          return false;
-
-        vm->stackTop -= argCount + 1;
-        push(vm, result);
-        return true;
+        return callNative(vm, AS_NATIVE_OBJ(callee), argCount, false);
       }
 
       default:
@@ -330,16 +502,35 @@ static bool callValue(DictuVM *vm, Value callee, int argCount, bool unpack) {
 }
 
 static bool callNativeMethod(DictuVM *vm, Value method, int argCount) {
-  NativeFn native = AS_NATIVE(method);
+  return callNative(vm, AS_NATIVE_OBJ(method), argCount, true);
+}
 
-  Value result = native(vm, argCount, vm->stackTop - argCount - 1);
+static DictuInterpretResult run(DictuVM *vm, int frameBase);
 
-  if (IS_EMPTY(result))
+// Calls the callee sitting below argCount arguments on the stack and
+// runs it to completion, leaving the result in place of the callee.
+static bool callToCompletion(DictuVM *vm, int argCount) {
+  int frameCount = vm->frameCount;
+
+  if (!callValue(vm, peek(vm, argCount), argCount, false)) {
     return false;
+  }
 
-  vm->stackTop -= argCount + 1;
-  push(vm, result);
-  return true;
+  // Natives complete within callValue, closures need their frame run.
+  return vm->frameCount == frameCount || run(vm, frameCount) == INTERPRET_OK;
+}
+
+Value callFunction(DictuVM *vm, Value callee, int argCount, Value *args) {
+  push(vm, callee);
+  for (int i = 0; i < argCount; ++i) {
+    push(vm, args[i]);
+  }
+
+  if (!callToCompletion(vm, argCount)) {
+    return EMPTY_VAL;
+  }
+
+  return pop(vm);
 }
 
 static bool invokeFromClass(DictuVM *vm, ObjClass *klass, ObjString *name,
@@ -557,6 +748,36 @@ static bool invoke(DictuVM *vm, ObjString *name, int argCount, bool unpack) {
         return false;
       }
 
+      case OBJ_STREAM: {
+        Value value;
+        if (tableGet(&vm->streamMethods, name, &value)) {
+          return callNativeMethod(vm, value, argCount);
+        }
+
+        runtimeError(vm, "Stream has no method %s().", name->chars);
+        return false;
+      }
+
+      case OBJ_BIGINT: {
+        Value value;
+        if (tableGet(&vm->bigIntMethods, name, &value)) {
+          return callNativeMethod(vm, value, argCount);
+        }
+
+        runtimeError(vm, "BigInt has no method %s().", name->chars);
+        return false;
+      }
+
+      case OBJ_ABSTRACT: {
+        Value value;
+        if (getAbstractMethod(AS_ABSTRACT(receiver), name, &value)) {
+          return callNativeMethod(vm, value, argCount);
+        }
+
+        runtimeError(vm, "Undefined property '%s'.", name->chars);
+        return false;
+      }
+
       default:
         break;
       }
@@ -692,30 +913,116 @@ static void concatenate(DictuVM *vm) {
   push(vm, OBJ_VAL(result));
 }
 
+static inline bool forLoopContinues(ForLoopMode mode, double counter, double limit, double step) {
+  switch (mode) {
+    case FOR_RANGE:
+      return step > 0 ? counter < limit : counter > limit;
+    case FOR_LESS:
+      return counter < limit;
+    case FOR_LESS_EQUAL:
+      return counter <= limit;
+    case FOR_GREATER:
+      return counter > limit;
+    case FOR_GREATER_EQUAL:
+      return counter >= limit;
+  }
+
+  return false;
+}
+
 static void setReplVar(DictuVM *vm, Value value) {
   tableSet(vm, &vm->globals, vm->replVar, value);
 }
 
-static DictuInterpretResult run(DictuVM *vm) {
-  CallFrame *frame = &vm->frames[vm->frameCount - 1];
-  register uint8_t* ip = frame->ip;
+// The cache byte of the property access whose operand ends at ip, see
+// findField. A chunk's cache is allocated when a typed abstract first
+// reaches one of its accesses.
+static uint8_t *abstractFieldCache(DictuVM *vm, ObjAbstract *abstract, CallFrame *frame, uint8_t *ip) {
+  if (abstract->abstractType == NULL) {
+    return NULL;
+  }
+
+  Chunk *chunk = &frame->closure->function->chunk;
+
+  if (chunk->fieldCache == NULL) {
+    uint8_t *cache = ALLOCATE(vm, uint8_t, chunk->capacity);
+    memset(cache, 0, chunk->capacity);
+    chunk->fieldCache = cache;
+  }
+
+  return &chunk->fieldCache[ip - 1 - chunk->code];
+}
+
+static DictuInterpretResult run(DictuVM *vm, int frameBase) {
+  CallFrame *frame;
+  register uint8_t* ip;
+  register Value *sp;
+  Value *slots;
+  Value *constants;
+
+// The stack top is kept in sp while the loop runs. It is written back to
+// vm->stackTop before anything out of line that reads the stack or may
+// collect garbage (calls, allocation, runtime errors) and reloaded after
+// anything that moves it.
+#ifdef TOS_CACHE
+// The top value itself lives in tos and sp points at its home slot, so
+// the stack below it is always in memory. SPILL_TOS writes the top back
+// for handlers that read stack slots by address, FILL_TOS reloads it
+// after they write them.
+#define SAVE_SP() (*sp = tos, vm->stackTop = sp + 1)
+#define LOAD_SP() (sp = vm->stackTop - 1, tos = *sp)
+
+#define PUSH(value) (*sp++ = tos, tos = (value))
+#define POP() (popped = tos, tos = *--sp, popped)
+#define PEEK(distance) ((distance) == 0 ? tos : sp[-(distance)])
+#define TOP tos
+#define DROP(count) (sp -= (count), tos = *sp)
+#define STACK_END() (sp + 1)
+#define SPILL_TOS() (*sp = tos)
+#define FILL_TOS() (tos = *sp)
+
+  register Value tos;
+  Value popped;
+#else
+#define SAVE_SP() (vm->stackTop = sp)
+#define LOAD_SP() (sp = vm->stackTop)
+
+#define PUSH(value) (*sp++ = (value))
+#define POP() (*--sp)
+#define PEEK(distance) (sp[-1 - (distance)])
+#define TOP (sp[-1])
+#define DROP(count) (sp -= (count))
+#define STACK_END() (sp)
+#define SPILL_TOS() ((void) 0)
+#define FILL_TOS() ((void) 0)
+#endif
+
+#define LOAD_FRAME()							\
+  do {									\
+    frame = &vm->frames[vm->frameCount - 1];				\
+    ip = frame->ip;							\
+    slots = frame->slots;						\
+    constants = frame->closure->function->chunk.constants.values;	\
+  } while (false)
+
+  LOAD_FRAME();
+  LOAD_SP();
 
 #define READ_BYTE() (*ip++)
 #define READ_SHORT()				\
   (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
 
-#define READ_CONSTANT()						\
-  (frame->closure->function->chunk.constants.values[READ_BYTE()])
+#define READ_CONSTANT() (constants[READ_BYTE()])
 
 #define READ_STRING() AS_STRING(READ_CONSTANT())
 
 #define UNSUPPORTED_OPERAND_TYPE_ERROR(op)				\
+  STORE_FRAME;								\
   int firstValLength = 0;						\
   int secondValLength = 0;						\
-  char *firstVal = valueTypeToString(vm, peek(vm, 1), &firstValLength);	\
-  char *secondVal = valueTypeToString(vm, peek(vm, 0), &secondValLength); \
+  char *firstVal = valueTypeToString(vm, PEEK(1), &firstValLength);	\
+  char *secondVal = valueTypeToString(vm, PEEK(0), &secondValLength); \
 									\
-  STORE_FRAME;								\
   runtimeError(vm, "Unsupported operand types for "#op": '%s', '%s'", firstVal, secondVal); \
   FREE_ARRAY(vm, char, firstVal, firstValLength + 1);			\
   FREE_ARRAY(vm, char, secondVal, secondValLength + 1);			\
@@ -723,27 +1030,70 @@ static DictuInterpretResult run(DictuVM *vm) {
 
 #define BINARY_OP(valueType, op, type)				\
   do {								\
-    if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(peek(vm, 1))) {	\
+    if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {	\
       UNSUPPORTED_OPERAND_TYPE_ERROR(op)			\
 	}							\
 								\
-    type b = AS_NUMBER(pop(vm));				\
-    type a = AS_NUMBER(peek(vm, 0));				\
-    vm->stackTop[-1] = valueType(a op b);			\
+    type b = AS_NUMBER(POP());				\
+    type a = AS_NUMBER(PEEK(0));				\
+    TOP = valueType(a op b);			\
+  } while (false)
+
+// Two small ints take the integer path, anything else falls through
+// to the double arithmetic below it.
+#define INT_BINARY_OP(valueType, op)					\
+  do {									\
+    if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) {			\
+      int64_t b = AS_INT(POP());					\
+      TOP = valueType(AS_INT(TOP) op b);	\
+      DISPATCH();							\
+    }									\
+  } while (false)
+
+#define INTEGER_OP(op)							\
+  do {									\
+    if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {		\
+      UNSUPPORTED_OPERAND_TYPE_ERROR(op)				\
+	}								\
+									\
+    int64_t b = valueToInteger(POP());				\
+    int64_t a = valueToInteger(PEEK(0));				\
+    TOP = integerToValue(a op b);				\
+  } while (false)
+
+// Operands the compiler proved numeric, no type check needed.
+#define NUMERIC_OP(valueType, op)					\
+  do {									\
+    double b = AS_NUMBER(POP());					\
+    TOP = valueType(AS_NUMBER(TOP) op b);	\
+  } while (false)
+
+// Arithmetic with a BigInt on either side is handed to the BigInt
+// module, which replaces both operands with the result.
+#define BIGINT_OP(opcode)						\
+  do {									\
+    if (IS_BIGINT(PEEK(0)) || IS_BIGINT(PEEK(1))) {		\
+      STORE_FRAME;							\
+      if (!bigIntOperator(vm, OP_##opcode)) {				\
+        return INTERPRET_RUNTIME_ERROR;					\
+      }									\
+      LOAD_SP();							\
+      DISPATCH();							\
+    }									\
   } while (false)
 
 #define BINARY_OP_FUNCTION(valueType, op, func, type)		\
   do {								\
-    if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(peek(vm, 1))) {	\
+    if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {	\
       UNSUPPORTED_OPERAND_TYPE_ERROR(op)			\
 	}							\
 								\
-    type b = AS_NUMBER(pop(vm));				\
-    type a = AS_NUMBER(peek(vm, 0));				\
-    vm->stackTop[-1] = valueType(func(a, b));			\
+    type b = AS_NUMBER(POP());				\
+    type a = AS_NUMBER(PEEK(0));				\
+    TOP = valueType(func(a, b));			\
   } while (false)
 
-#define STORE_FRAME frame->ip = ip
+#define STORE_FRAME (frame->ip = ip, SAVE_SP())
 
 #define RUNTIME_ERROR(...)			\
   do {						\
@@ -752,11 +1102,23 @@ static DictuInterpretResult run(DictuVM *vm) {
     return INTERPRET_RUNTIME_ERROR;		\
   } while (0)
 
+// A back edge of the outermost run() is the one place nothing but the
+// VM's own state refers to objects, so compaction waits for it.
+#define COMPACT_SAFEPOINT()						\
+  do {									\
+    if (vm->compactPending && frameBase == 0 && vm->aotDepth == 0) {	\
+      STORE_FRAME;							\
+      compactHeap(vm);							\
+      LOAD_FRAME();							\
+      LOAD_SP();							\
+    }									\
+  } while (false)
+
 #define RUNTIME_ERROR_TYPE(error, distance)				\
   do {									\
     STORE_FRAME;							\
     int valLength = 0;							\
-    char *val = valueTypeToString(vm, peek(vm, distance), &valLength);	\
+    char *val = valueTypeToString(vm, PEEK(distance), &valLength);	\
     runtimeError(vm, error, val);					\
     FREE_ARRAY(vm, char, val, valLength + 1);				\
     return INTERPRET_RUNTIME_ERROR;					\
@@ -778,7 +1140,8 @@ static DictuInterpretResult run(DictuVM *vm) {
     do									\
       {									\
 	printf("          ");						\
-	for (Value *stackValue = vm->stack; stackValue < vm->stackTop; stackValue++) { \
+	SPILL_TOS();							\
+	for (Value *stackValue = vm->stack; stackValue < STACK_END(); stackValue++) { \
 	  printf("[ ");							\
 	  printValue(*stackValue);					\
 	  printf(" ]");							\
@@ -815,51 +1178,53 @@ static DictuInterpretResult run(DictuVM *vm) {
     {
     CASE_CODE(CONSTANT): {
         Value constant = READ_CONSTANT();
-        push(vm, constant);
+        PUSH(constant);
         DISPATCH();
       }
 
     CASE_CODE(NIL):
-      push(vm, NIL_VAL);
+      PUSH(NIL_VAL);
       DISPATCH();
 
     CASE_CODE(EMPTY):
-      push(vm, EMPTY_VAL);
+      PUSH(EMPTY_VAL);
       DISPATCH();
 
     CASE_CODE(TRUE):
-      push(vm, BOOL_VAL(true));
+      PUSH(BOOL_VAL(true));
       DISPATCH();
 
     CASE_CODE(FALSE):
-      push(vm, BOOL_VAL(false));
+      PUSH(BOOL_VAL(false));
       DISPATCH();
 
     CASE_CODE(POP_REPL): {
-        Value v = peek(vm, 0);
+        Value v = PEEK(0);
         if (!IS_NIL(v)) {
+          SAVE_SP();
           setReplVar(vm, v);
           printValue(v);
           printf("\n");
         }
-        pop(vm);
+        DROP(1);
         DISPATCH();
       }
 
     CASE_CODE(POP): {
-        pop(vm);
+        DROP(1);
         DISPATCH();
       }
 
     CASE_CODE(GET_LOCAL): {
         uint8_t slot = READ_BYTE();
-        push(vm, frame->slots[slot]);
+        SPILL_TOS();
+        PUSH(slots[slot]);
         DISPATCH();
       }
 
     CASE_CODE(SET_LOCAL): {
         uint8_t slot = READ_BYTE();
-        frame->slots[slot] = peek(vm, 0);
+        slots[slot] = PEEK(0);
         DISPATCH();
       }
 
@@ -869,7 +1234,7 @@ static DictuInterpretResult run(DictuVM *vm) {
         if (!tableGet(&vm->globals, name, &value)) {
           RUNTIME_ERROR("Undefined variable '%s'.", name->chars);
         }
-        push(vm, value);
+        PUSH(value);
         DISPATCH();
       }
 
@@ -880,20 +1245,22 @@ static DictuInterpretResult run(DictuVM *vm) {
                       name, &value)) {
           RUNTIME_ERROR("Undefined variable '%s'.", name->chars);
         }
-        push(vm, value);
+        PUSH(value);
         DISPATCH();
       }
 
     CASE_CODE(DEFINE_MODULE): {
         ObjString *name = READ_STRING();
-        tableSet(vm, &frame->closure->function->module->values, name, peek(vm, 0));
-        pop(vm);
+        SAVE_SP();
+        tableSet(vm, &frame->closure->function->module->values, name, PEEK(0));
+        DROP(1);
         DISPATCH();
       }
 
     CASE_CODE(SET_MODULE): {
         ObjString *name = READ_STRING();
-        if (tableSet(vm, &frame->closure->function->module->values, name, peek(vm, 0))) {
+        SAVE_SP();
+        if (tableSet(vm, &frame->closure->function->module->values, name, PEEK(0))) {
           tableDelete(vm, &frame->closure->function->module->values, name);
           RUNTIME_ERROR("Undefined variable '%s'.", name->chars);
         }
@@ -902,7 +1269,7 @@ static DictuInterpretResult run(DictuVM *vm) {
     CASE_CODE(DEFINE_OPTIONAL): {
         int arity = READ_BYTE();
         int arityOptional = READ_BYTE();
-        int argCount = vm->stackTop - frame->slots - arityOptional - 1;
+        int argCount = STACK_END() - slots - arityOptional - 1;
 
         // Temp array while we shuffle the stack.
         // Can not have more than 255 args to a function, so
@@ -911,13 +1278,13 @@ static DictuInterpretResult run(DictuVM *vm) {
         int index;
 
         for (index = 0; index < arityOptional + argCount; index++) {
-          values[index] = pop(vm);
+          values[index] = POP();
         }
 
         --index;
 
         for (int i = 0; i < argCount; i++) {
-          push(vm, values[index - i]);
+          PUSH(values[index - i]);
         }
 
         // Calculate how many "default" values are required
@@ -925,25 +1292,43 @@ static DictuInterpretResult run(DictuVM *vm) {
 
         // Push any "default" values back onto the stack
         for (int i = remaining; i > 0; i--) {
-          push(vm, values[i - 1]);
+          PUSH(values[i - 1]);
         }
 
         DISPATCH();
       }
     CASE_CODE(GET_PROPERTY_NO_POP): {
-        if (!IS_INSTANCE(peek(vm, 0))) {
+        if (IS_ABSTRACT(PEEK(0))) {
+          ObjAbstract *abstract = AS_ABSTRACT(PEEK(0));
+          ObjString *name = READ_STRING();
+          Value value;
+
+          SAVE_SP();
+          uint8_t *cache = abstractFieldCache(vm, abstract, frame, ip);
+          if (!getAbstractField(vm, abstract, name, cache, &value) &&
+              !tableGet(&abstract->values, name, &value)) {
+            RUNTIME_ERROR("Abstract has no property: '%s'.", name->chars);
+          }
+
+          PUSH(value);
+          DISPATCH();
+        }
+
+        if (!IS_INSTANCE(PEEK(0))) {
           RUNTIME_ERROR("Only instances have properties.");
         }
 
-        ObjInstance *instance = AS_INSTANCE(peek(vm, 0));
+        ObjInstance *instance = AS_INSTANCE(PEEK(0));
         ObjString *name = READ_STRING();
         Value value;
         if (tableGet(&instance->publicFields, name, &value)) {
-          push(vm, value);
+          PUSH(value);
           DISPATCH();
         }
 
+        SAVE_SP();
         if (bindMethod(vm, instance->klass, name)) {
+          LOAD_SP();
           DISPATCH();
         }
 
@@ -952,12 +1337,12 @@ static DictuInterpretResult run(DictuVM *vm) {
 
         while (klass != NULL) {
           if (tableGet(&klass->publicConstantProperties, name, &value)) {
-            push(vm, value);
+            PUSH(value);
             DISPATCH();
           }
 
           if (tableGet(&klass->publicProperties, name, &value)) {
-            push(vm, value);
+            PUSH(value);
             DISPATCH();
           }
 
@@ -972,17 +1357,17 @@ static DictuInterpretResult run(DictuVM *vm) {
       }
     CASE_CODE(GET_UPVALUE): {
         uint8_t slot = READ_BYTE();
-        push(vm, *frame->closure->upvalues[slot]->value);
+        PUSH(*frame->closure->upvalues[slot]->value);
         DISPATCH();
       }
 
     CASE_CODE(SET_UPVALUE): {
         uint8_t slot = READ_BYTE();
-        *frame->closure->upvalues[slot]->value = peek(vm, 0);
+        *frame->closure->upvalues[slot]->value = PEEK(0);
         DISPATCH();
       }
     CASE_CODE(GET_PROPERTY):{
-        Value receiver = peek(vm, 0);
+        Value receiver = PEEK(0);
 
         if (!IS_OBJ(receiver)) {
           RUNTIME_ERROR_TYPE("'%s' type has no properties", 0);
@@ -994,12 +1379,13 @@ static DictuInterpretResult run(DictuVM *vm) {
           ObjString *name = READ_STRING();
           Value value;
           if (tableGet(&instance->publicFields, name, &value)) {
-            pop(vm); // Instance.
-            push(vm, value);
+            TOP = value; // Replaces the instance.
             DISPATCH();
           }
 
+          SAVE_SP();
           if (bindMethod(vm, instance->klass, name)) {
+            LOAD_SP();
             DISPATCH();
           }
 
@@ -1008,14 +1394,12 @@ static DictuInterpretResult run(DictuVM *vm) {
 
           while (klass != NULL) {
             if (tableGet(&klass->publicConstantProperties, name, &value)) {
-              pop(vm); // Instance.
-              push(vm, value);
+              TOP = value; // Replaces the instance.
               DISPATCH();
             }
 
             if (tableGet(&klass->publicProperties, name, &value)) {
-              pop(vm); // Instance.
-              push(vm, value);
+              TOP = value; // Replaces the instance.
               DISPATCH();
             }
 
@@ -1033,8 +1417,7 @@ static DictuInterpretResult run(DictuVM *vm) {
           ObjString *name = READ_STRING();
           Value value;
           if (tableGet(&module->values, name, &value)) {
-            pop(vm); // Module.
-            push(vm, value);
+            TOP = value; // Replaces the module.
             DISPATCH();
           }
 
@@ -1050,14 +1433,12 @@ static DictuInterpretResult run(DictuVM *vm) {
           Value value;
           while (klass != NULL) {
             if (tableGet(&klass->publicConstantProperties, name, &value)) {
-              pop(vm); // Class.
-              push(vm, value);
+              TOP = value; // Replaces the class.
               DISPATCH();
             }
 
             if (tableGet(&klass->publicProperties, name, &value)) {
-              pop(vm); // Class.
-              push(vm, value);
+              TOP = value; // Replaces the class.
               DISPATCH();
             }
 
@@ -1067,6 +1448,23 @@ static DictuInterpretResult run(DictuVM *vm) {
 
           RUNTIME_ERROR("'%s' class has no property: '%s'.", klassStore->name->chars, name->chars);
         }
+
+        case OBJ_ABSTRACT: {
+          ObjAbstract *abstract = AS_ABSTRACT(receiver);
+          ObjString *name = READ_STRING();
+          Value value;
+
+          // Host fields are read straight out of the wrapped struct.
+          SAVE_SP();
+          uint8_t *cache = abstractFieldCache(vm, abstract, frame, ip);
+          if (getAbstractField(vm, abstract, name, cache, &value) ||
+              tableGet(&abstract->values, name, &value)) {
+            TOP = value;
+            DISPATCH();
+          }
+
+          RUNTIME_ERROR("Abstract has no property: '%s'.", name->chars);
+        }
         default: {
           RUNTIME_ERROR_TYPE("'%s' type has no properties", 0);
         }
@@ -1074,26 +1472,71 @@ static DictuInterpretResult run(DictuVM *vm) {
       }
     
     CASE_CODE(SET_PROPERTY): {
-        if (IS_INSTANCE(peek(vm, 1))) {
-          ObjInstance *instance = AS_INSTANCE(peek(vm, 1));
-          tableSet(vm, &instance->publicFields, READ_STRING(), peek(vm, 0));
-          pop(vm);
-          pop(vm);
-          push(vm, NIL_VAL);
+        if (IS_INSTANCE(PEEK(1))) {
+          ObjInstance *instance = AS_INSTANCE(PEEK(1));
+          SAVE_SP();
+          tableSet(vm, &instance->publicFields, READ_STRING(), PEEK(0));
+          DROP(2);
+          PUSH(NIL_VAL);
           DISPATCH();
-        } else if (IS_CLASS(peek(vm, 1))) {
+        } else if (IS_CLASS(PEEK(1))) {
           ObjString *key = READ_STRING();
-          ObjClass *klass = AS_CLASS(peek(vm, 1));
+          ObjClass *klass = AS_CLASS(PEEK(1));
 
           Value _;
           if (tableGet(&klass->publicConstantProperties, key, &_)) {
             RUNTIME_ERROR("Cannot assign to class constant '%s.%s'.", klass->name->chars, key->chars);
           }
 
-          tableSet(vm, &klass->publicProperties, key, peek(vm, 0));
-          pop(vm);
-          pop(vm);
-          push(vm, NIL_VAL);
+          SAVE_SP();
+          tableSet(vm, &klass->publicProperties, key, PEEK(0));
+          DROP(2);
+          PUSH(NIL_VAL);
+          DISPATCH();
+        } else if (IS_ABSTRACT(PEEK(1))) {
+          ObjString *key = READ_STRING();
+
+          SAVE_SP();
+          uint8_t *cache = abstractFieldCache(vm, AS_ABSTRACT(PEEK(1)), frame, ip);
+
+          switch (setAbstractField(AS_ABSTRACT(PEEK(1)), key, cache, PEEK(0))) {
+            case ABSTRACT_SET_OK:
+              break;
+
+            case ABSTRACT_SET_NO_FIELD: {
+              // Properties the host put in the values table can be
+              // reassigned, so compound assignment works on them too.
+              ObjAbstract *abstract = AS_ABSTRACT(PEEK(1));
+              Value current;
+
+              if (!tableGet(&abstract->values, key, &current)) {
+                RUNTIME_ERROR("Abstract has no property: '%s'.", key->chars);
+              }
+
+              SAVE_SP();
+              tableSet(vm, &abstract->values, key, PEEK(0));
+              break;
+            }
+
+            case ABSTRACT_SET_READ_ONLY:
+              RUNTIME_ERROR("Cannot assign to read only property '%s'.", key->chars);
+
+            case ABSTRACT_SET_OUT_OF_RANGE:
+              RUNTIME_ERROR("Value is out of range for property '%s'.", key->chars);
+
+            case ABSTRACT_SET_WRONG_TYPE: {
+              STORE_FRAME;
+              int valLength = 0;
+              char *val = valueTypeToString(vm, PEEK(0), &valLength);
+
+              runtimeError(vm, "Cannot assign type '%s' to property '%s'.", val, key->chars);
+              FREE_ARRAY(vm, char, val, valLength + 1);
+              return INTERPRET_RUNTIME_ERROR;
+            }
+          }
+
+          DROP(2);
+          PUSH(NIL_VAL);
           DISPATCH();
         }
 
@@ -1101,55 +1544,69 @@ static DictuInterpretResult run(DictuVM *vm) {
       }
     CASE_CODE(SET_CLASS_VAR): {
         // No type check required as this opcode is only ever emitted when parsing a class
-        ObjClass *klass = AS_CLASS(peek(vm, 1));
+        ObjClass *klass = AS_CLASS(PEEK(1));
         ObjString *key = READ_STRING();
         bool constant = READ_BYTE();
 
+        SAVE_SP();
         if (constant) {
-          tableSet(vm, &klass->publicConstantProperties, key, peek(vm, 0));
+          tableSet(vm, &klass->publicConstantProperties, key, PEEK(0));
         } else {
-          tableSet(vm, &klass->publicProperties, key, peek(vm, 0));
+          tableSet(vm, &klass->publicProperties, key, PEEK(0));
         }
-        pop(vm);
+        DROP(1);
         DISPATCH();
       }
     CASE_CODE(GET_SUPER): {
         ObjString *name = READ_STRING();
-        ObjClass *superclass = AS_CLASS(pop(vm));
+        ObjClass *superclass = AS_CLASS(POP());
 
+        SAVE_SP();
         if (!bindMethod(vm, superclass, name)) {
           RUNTIME_ERROR("Undefined property '%s'.", name->chars);
         }
+        LOAD_SP();
         DISPATCH();
       }
     CASE_CODE(EQUAL): {
-        Value b = pop(vm);
-        Value a = pop(vm);
-        push(vm, BOOL_VAL(valuesEqual(a, b)));
+        Value b = POP();
+        Value a = POP();
+        PUSH(BOOL_VAL(valuesEqual(a, b)));
         DISPATCH();
       }
 
     CASE_CODE(GREATER):
+      INT_BINARY_OP(BOOL_VAL, >);
+      BIGINT_OP(GREATER);
       BINARY_OP(BOOL_VAL, >, double);
       DISPATCH();
 
     CASE_CODE(LESS):
+      INT_BINARY_OP(BOOL_VAL, <);
+      BIGINT_OP(LESS);
       BINARY_OP(BOOL_VAL, <, double);
       DISPATCH();
 
     CASE_CODE(ADD): {
-        if (IS_STRING(peek(vm, 0)) && IS_STRING(peek(vm, 1))) {
-          concatenate(vm);
-        } else if (IS_NUMBER(peek(vm, 0)) && IS_NUMBER(peek(vm, 1))) {
-          double b = AS_NUMBER(pop(vm));
-          double a = AS_NUMBER(pop(vm));
-          push(vm, NUMBER_VAL(a + b));
-        } else if (IS_LIST(peek(vm, 0)) && IS_LIST(peek(vm, 1))) {
-          ObjList *listOne = AS_LIST(peek(vm, 1));
-          ObjList *listTwo = AS_LIST(peek(vm, 0));
+        INT_BINARY_OP(integerToValue, +);
+        BIGINT_OP(ADD);
 
+        if (IS_STRING(PEEK(0)) && IS_STRING(PEEK(1))) {
+          SAVE_SP();
+          concatenate(vm);
+          LOAD_SP();
+        } else if (IS_NUMBER(PEEK(0)) && IS_NUMBER(PEEK(1))) {
+          double b = AS_NUMBER(POP());
+          double a = AS_NUMBER(POP());
+          PUSH(NUMBER_VAL(a + b));
+        } else if (IS_LIST(PEEK(0)) && IS_LIST(PEEK(1))) {
+          ObjList *listOne = AS_LIST(PEEK(1));
+          ObjList *listTwo = AS_LIST(PEEK(0));
+
+          SAVE_SP();
           ObjList *finalList = newList(vm);
-          push(vm, OBJ_VAL(finalList));
+          PUSH(OBJ_VAL(finalList));
+          SAVE_SP();
 
           for (int i = 0; i < listOne->values.count; ++i) {
             writeValueArray(vm, &finalList->values, listOne->values.values[i]);
@@ -1159,12 +1616,8 @@ static DictuInterpretResult run(DictuVM *vm) {
             writeValueArray(vm, &finalList->values, listTwo->values.values[i]);
           }
 
-          pop(vm);
-
-          pop(vm);
-          pop(vm);
-
-          push(vm, OBJ_VAL(finalList));
+          DROP(2);
+          TOP = OBJ_VAL(finalList);
         } else {
           UNSUPPORTED_OPERAND_TYPE_ERROR(+);
         }
@@ -1172,50 +1625,167 @@ static DictuInterpretResult run(DictuVM *vm) {
       }
 
     CASE_CODE(SUBTRACT): {
+        INT_BINARY_OP(integerToValue, -);
+        BIGINT_OP(SUBTRACT);
         BINARY_OP(NUMBER_VAL, -, double);
         DISPATCH();
       }
 
     CASE_CODE(MULTIPLY):
+      if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) {
+        int64_t b = AS_INT(POP());
+        TOP = multiplyIntegers(AS_INT(TOP), b);
+        DISPATCH();
+      }
+
+      BIGINT_OP(MULTIPLY);
       BINARY_OP(NUMBER_VAL, *, double);
       DISPATCH();
 
     CASE_CODE(DIVIDE):
+      if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) {
+        int64_t b = AS_INT(POP());
+        TOP = divideIntegers(AS_INT(TOP), b);
+        DISPATCH();
+      }
+
+      BIGINT_OP(DIVIDE);
       BINARY_OP(NUMBER_VAL, /, double);
       DISPATCH();
 
+    // The compiler emits the _NN forms only where both operands are
+    // known to be numbers, so the type checks above are skipped.
+    CASE_CODE(ADD_NN):
+      INT_BINARY_OP(integerToValue, +);
+      NUMERIC_OP(NUMBER_VAL, +);
+      DISPATCH();
+
+    CASE_CODE(SUBTRACT_NN):
+      INT_BINARY_OP(integerToValue, -);
+      NUMERIC_OP(NUMBER_VAL, -);
+      DISPATCH();
+
+    CASE_CODE(MULTIPLY_NN):
+      if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) {
+        int64_t b = AS_INT(POP());
+        TOP = multiplyIntegers(AS_INT(TOP), b);
+        DISPATCH();
+      }
+
+      NUMERIC_OP(NUMBER_VAL, *);
+      DISPATCH();
+
+    CASE_CODE(DIVIDE_NN):
+      if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) {
+        int64_t b = AS_INT(POP());
+        TOP = divideIntegers(AS_INT(TOP), b);
+        DISPATCH();
+      }
+
+      NUMERIC_OP(NUMBER_VAL, /);
+      DISPATCH();
+
+    CASE_CODE(LESS_NN):
+      INT_BINARY_OP(BOOL_VAL, <);
+      NUMERIC_OP(BOOL_VAL, <);
+      DISPATCH();
+
+    CASE_CODE(GREATER_NN):
+      INT_BINARY_OP(BOOL_VAL, >);
+      NUMERIC_OP(BOOL_VAL, >);
+      DISPATCH();
+
     CASE_CODE(POW): {
-        BINARY_OP_FUNCTION(NUMBER_VAL, **, powf, double);
+        BIGINT_OP(POW);
+
+        if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+          UNSUPPORTED_OPERAND_TYPE_ERROR(**);
+        }
+
+        Value b = POP();
+        TOP = powNumbers(TOP, b);
         DISPATCH();
       }
 
     CASE_CODE(MOD): {
-        BINARY_OP_FUNCTION(NUMBER_VAL, **, fmod, double);
+        BIGINT_OP(MOD);
+
+        if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+          UNSUPPORTED_OPERAND_TYPE_ERROR(%);
+        }
+
+        Value b = POP();
+        TOP = modNumbers(TOP, b);
         DISPATCH();
       }
       
     CASE_CODE(BITWISE_AND):
-      BINARY_OP(NUMBER_VAL, &, int);
+      INTEGER_OP(&);
       DISPATCH();
 
     CASE_CODE(BITWISE_XOR):
-      BINARY_OP(NUMBER_VAL, ^, int);
+      INTEGER_OP(^);
       DISPATCH();
 
     CASE_CODE(BITWISE_OR):
-      BINARY_OP(NUMBER_VAL, |, int);
+      INTEGER_OP(|);
       DISPATCH();
 
+    CASE_CODE(SHIFT_LEFT): {
+        if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+          UNSUPPORTED_OPERAND_TYPE_ERROR(<<);
+        }
+
+        int64_t b = valueToInteger(POP());
+        int64_t a = valueToInteger(PEEK(0));
+
+        if (b < 0) {
+          RUNTIME_ERROR("Negative shift count.");
+        }
+
+        // Shift unsigned, shifting a negative int64 left is undefined.
+        TOP = integerToValue(b > 63 ? 0 : (int64_t) ((uint64_t) a << b));
+        DISPATCH();
+      }
+
+    CASE_CODE(SHIFT_RIGHT): {
+        if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) {
+          UNSUPPORTED_OPERAND_TYPE_ERROR(>>);
+        }
+
+        int64_t b = valueToInteger(POP());
+        int64_t a = valueToInteger(PEEK(0));
+
+        if (b < 0) {
+          RUNTIME_ERROR("Negative shift count.");
+        }
+
+        TOP = integerToValue(a >> (b > 63 ? 63 : b));
+        DISPATCH();
+      }
+
     CASE_CODE(NOT):
-      push(vm, BOOL_VAL(isFalsey(pop(vm))));
+      TOP = BOOL_VAL(isFalsey(TOP));
       DISPATCH();
 
     CASE_CODE(NEGATE):
-      if (!IS_NUMBER(peek(vm, 0))) {
+      if (IS_INT(PEEK(0))) {
+        TOP = integerToValue(-AS_INT(TOP));
+        DISPATCH();
+      }
+
+      if (IS_BIGINT(PEEK(0))) {
+        SAVE_SP();
+        bigIntNegate(vm);
+        LOAD_SP();
+        DISPATCH();
+      }
+
+      if (!IS_NUMBER(PEEK(0))) {
         RUNTIME_ERROR_TYPE("Unsupported operand type for unary -: '%s'", 0);
       }
 
-      push(vm, NUMBER_VAL(-AS_NUMBER(pop(vm))));
+      TOP = NUMBER_VAL(-AS_NUMBER(TOP));
       DISPATCH();
 
     CASE_CODE(JUMP): {
@@ -1225,17 +1795,18 @@ static DictuInterpretResult run(DictuVM *vm) {
       }
     CASE_CODE(JUMP_IF_FALSE): {
         uint16_t offset = READ_SHORT();
-        if (isFalsey(peek(vm, 0))) ip += offset;
+        if (isFalsey(PEEK(0))) ip += offset;
         DISPATCH();
       }
     CASE_CODE(JUMP_IF_NIL): {
         uint16_t offset = READ_SHORT();
-        if (IS_NIL(peek(vm, 0))) ip += offset;
+        if (IS_NIL(PEEK(0))) ip += offset;
         DISPATCH();
       }
     CASE_CODE(LOOP): {
         uint16_t offset = READ_SHORT();
         ip -= offset;
+        COMPACT_SAFEPOINT();
         DISPATCH();
       }
 
@@ -1243,6 +1814,163 @@ static DictuInterpretResult run(DictuVM *vm) {
         DISPATCH();
       }
 
+    CASE_CODE(ITER_INIT): {
+        Value iterable = PEEK(0);
+        int size = 0;
+
+        if (IS_INSTANCE(iterable)) {
+          ObjClass *klass = AS_INSTANCE(iterable)->klass;
+          Value method;
+
+          if (!tableGet(&klass->publicMethods, vm->hasNextString, &method) ||
+              !tableGet(&klass->publicMethods, vm->nextString, &method)) {
+            RUNTIME_ERROR("Instance of '%s' is not iterable, it must define hasNext() and next().", klass->name->chars);
+          }
+        } else if (!iteratorStart(iterable, &size)) {
+          RUNTIME_ERROR_TYPE("Type '%s' is not iterable.", 0);
+        }
+
+        PUSH(NUMBER_VAL(0)); // Cursor.
+        PUSH(NUMBER_VAL(size));
+        DISPATCH();
+      }
+
+    CASE_CODE(ITER_NEXT): {
+        uint8_t *start = ip - 1;
+        uint8_t slot = READ_BYTE();
+        uint16_t offset = READ_SHORT();
+        SPILL_TOS();
+        Value iterable = slots[slot];
+
+        if (IS_INSTANCE(iterable)) {
+          // User iterables run hasNext() and next() as ordinary calls.
+          // The cursor records which of them has just returned and the
+          // instruction is re-executed once each call completes.
+          ObjString *method;
+
+          switch ((int) AS_NUMBER(slots[slot + 1])) {
+            case 0:
+              slots[slot + 1] = NUMBER_VAL(1);
+              method = vm->hasNextString;
+              break;
+
+            case 1:
+              if (isFalsey(POP())) {
+                slots[slot + 1] = NUMBER_VAL(0);
+                ip += offset;
+                FILL_TOS();
+                DISPATCH();
+              }
+
+              slots[slot + 1] = NUMBER_VAL(2);
+              method = vm->nextString;
+              break;
+
+            default:
+              slots[slot + 3] = POP();
+              slots[slot + 1] = NUMBER_VAL(0);
+              FILL_TOS();
+              DISPATCH();
+          }
+
+          frame->ip = start;
+          PUSH(iterable);
+          SAVE_SP();
+          if (!invoke(vm, method, 0, false)) {
+            return INTERPRET_RUNTIME_ERROR;
+          }
+          LOAD_SP();
+          LOAD_FRAME();
+          DISPATCH();
+        }
+
+        STORE_FRAME;
+        int cursor = AS_NUMBER(slots[slot + 1]);
+
+        IteratorResult next = iteratorNext(vm, iterable, &cursor, AS_NUMBER(slots[slot + 2]), &slots[slot + 3]);
+
+        // Streams call back into the VM, which may grow the frames array.
+        frame = &vm->frames[vm->frameCount - 1];
+        LOAD_SP();
+
+        switch (next) {
+          case ITERATOR_VALUE:
+            slots[slot + 1] = NUMBER_VAL(cursor);
+            break;
+
+          case ITERATOR_DONE:
+            ip += offset;
+            break;
+
+          case ITERATOR_ERROR:
+            return INTERPRET_RUNTIME_ERROR;
+        }
+
+        FILL_TOS();
+        DISPATCH();
+      }
+
+    CASE_CODE(FOR_PREP): {
+        uint8_t counter = READ_BYTE();
+        uint8_t limit = READ_BYTE();
+        uint8_t step = READ_BYTE();
+        ForLoopMode mode = READ_BYTE();
+        uint16_t offset = READ_SHORT();
+        SPILL_TOS();
+
+        if (!IS_NUMBER(slots[counter]) || !IS_NUMBER(slots[limit]) || !IS_NUMBER(slots[step])) {
+          RUNTIME_ERROR("For loop counter, limit and step must be numbers.");
+        }
+
+        if (mode == FOR_RANGE && AS_NUMBER(slots[step]) == 0) {
+          RUNTIME_ERROR("range() step cannot be 0.");
+        }
+
+        if (!forLoopContinues(mode, AS_NUMBER(slots[counter]), AS_NUMBER(slots[limit]), AS_NUMBER(slots[step]))) {
+          ip += offset;
+        }
+
+        DISPATCH();
+      }
+
+    CASE_CODE(FOR_LOOP): {
+        uint8_t counter = READ_BYTE();
+        uint8_t limit = READ_BYTE();
+        uint8_t step = READ_BYTE();
+        ForLoopMode mode = READ_BYTE();
+        uint16_t offset = READ_SHORT();
+        SPILL_TOS();
+
+        if (IS_INT(slots[counter]) && IS_INT(slots[limit]) && IS_INT(slots[step])) {
+          int64_t value = AS_INT(slots[counter]) + AS_INT(slots[step]);
+          slots[counter] = integerToValue(value);
+
+          if (forLoopContinues(mode, value, AS_INT(slots[limit]), AS_INT(slots[step]))) {
+            ip -= offset;
+            COMPACT_SAFEPOINT();
+          }
+
+          FILL_TOS();
+          DISPATCH();
+        }
+
+        // The body may have reassigned the counter or the limit.
+        if (!IS_NUMBER(slots[counter]) || !IS_NUMBER(slots[limit])) {
+          RUNTIME_ERROR("For loop counter, limit and step must be numbers.");
+        }
+
+        double value = AS_NUMBER(slots[counter]) + AS_NUMBER(slots[step]);
+        slots[counter] = NUMBER_VAL(value);
+
+        if (forLoopContinues(mode, value, AS_NUMBER(slots[limit]), AS_NUMBER(slots[step]))) {
+          ip -= offset;
+          COMPACT_SAFEPOINT();
+        }
+
+        FILL_TOS();
+        DISPATCH();
+      }
+
     CASE_CODE(IMPORT): {
         ObjString *fileName = READ_STRING();
         Value moduleVal;
@@ -1252,17 +1980,19 @@ static DictuInterpretResult run(DictuVM *vm) {
           RUNTIME_ERROR("Could not open file \"%s\".", fileName->chars);
         }
 
+        SAVE_SP();
         ObjString *pathObj = copyString(vm, path, strlen(path));
-        push(vm, OBJ_VAL(pathObj));
+        PUSH(OBJ_VAL(pathObj));
 
         // If we have imported this file already, skip.
         if (tableGet(&vm->modules, pathObj, &moduleVal)) {
-          pop(vm);
+          DROP(1);
           vm->lastModule = AS_MODULE(moduleVal);
-          push(vm, NIL_VAL);
+          PUSH(NIL_VAL);
           DISPATCH();
         }
 
+        SAVE_SP();
         char *source = readFile(vm, path);
 
         if (source == NULL) {
@@ -1272,23 +2002,25 @@ static DictuInterpretResult run(DictuVM *vm) {
         ObjModule *module = newModule(vm, pathObj);
         module->path = dirname(vm, path, strlen(path));
         vm->lastModule = module;
-        pop(vm);
-        push(vm, OBJ_VAL(module));
+        DROP(1);
+        PUSH(OBJ_VAL(module));
         ObjFunction *function = compile(vm, module, source);
-        pop(vm);
+        DROP(1);
+        SAVE_SP();
 
         FREE_ARRAY(vm, char, source, strlen(source) + 1);
 
         if (function == NULL) return INTERPRET_COMPILE_ERROR;
-        push(vm, OBJ_VAL(function));
+        PUSH(OBJ_VAL(function));
+        SAVE_SP();
         ObjClosure *closure = newClosure(vm, function);
-        pop(vm);
-        push(vm, OBJ_VAL(closure));
+        DROP(1);
+        PUSH(OBJ_VAL(closure));
 
-        frame->ip = ip;
+        STORE_FRAME;
         call(vm, closure, 0);
-        frame = &vm->frames[vm->frameCount - 1];
-        ip = frame->ip;
+        LOAD_SP();
+        LOAD_FRAME();
 
         DISPATCH();
       }
@@ -1300,23 +2032,24 @@ static DictuInterpretResult run(DictuVM *vm) {
         // If we have imported this module already, skip.
         if (tableGet(&vm->modules, fileName, &moduleVal)) {
           vm->lastModule = AS_MODULE(moduleVal);
-          push(vm, moduleVal);
+          PUSH(moduleVal);
           DISPATCH();
         }
 
+        SAVE_SP();
         Value module = importBuiltinModule(vm, index);
 
         if (IS_EMPTY(module)) {
           return INTERPRET_COMPILE_ERROR;
         }
 
-        push(vm, module);
+        PUSH(module);
 
         if (IS_CLOSURE(module)) {
-          frame->ip = ip;
+          STORE_FRAME;
           call(vm, AS_CLOSURE(module), 0);
-          frame = &vm->frames[vm->frameCount - 1];
-          ip = frame->ip;
+          LOAD_SP();
+          LOAD_FRAME();
 
           tableGet(&vm->modules, fileName, &module);
           vm->lastModule = AS_MODULE(module);
@@ -1346,14 +2079,14 @@ static DictuInterpretResult run(DictuVM *vm) {
             RUNTIME_ERROR("%s can't be found in module %s", variable->chars, module->name->chars);
           }
 
-          push(vm, moduleVariable);
+          PUSH(moduleVariable);
         }
 
         DISPATCH();
       }
 
     CASE_CODE(IMPORT_VARIABLE): {
-        push(vm, OBJ_VAL(vm->lastModule));
+        PUSH(OBJ_VAL(vm->lastModule));
         DISPATCH();
       }
 
@@ -1368,7 +2101,7 @@ static DictuInterpretResult run(DictuVM *vm) {
             RUNTIME_ERROR("%s can't be found in module %s", variable->chars, vm->lastModule->name->chars);
           }
 
-          push(vm, moduleVariable);
+          PUSH(moduleVariable);
         }
 
         DISPATCH();
@@ -1381,26 +2114,28 @@ static DictuInterpretResult run(DictuVM *vm) {
 
     CASE_CODE(NEW_LIST): {
         int count = READ_BYTE();
+        SAVE_SP();
         ObjList *list = newList(vm);
-        push(vm, OBJ_VAL(list));
+        PUSH(OBJ_VAL(list));
+        SAVE_SP();
 
         for (int i = count; i > 0; i--) {
-          writeValueArray(vm, &list->values, peek(vm, i));
+          writeValueArray(vm, &list->values, PEEK(i));
         }
 
-        vm->stackTop -= count + 1;
-        push(vm, OBJ_VAL(list));
+        DROP(count + 1);
+        PUSH(OBJ_VAL(list));
         DISPATCH();
       }
 
     CASE_CODE(UNPACK_LIST): {
         int varCount = READ_BYTE();
 
-        if (!IS_LIST(peek(vm, 0))) {
+        if (!IS_LIST(PEEK(0))) {
           RUNTIME_ERROR("Attempting to unpack a value which is not a list.");
         }
 
-        ObjList *list = AS_LIST(pop(vm));
+        ObjList *list = AS_LIST(POP());
 
         if (varCount != list->values.count) {
           if (varCount < list->values.count) {
@@ -1411,15 +2146,15 @@ static DictuInterpretResult run(DictuVM *vm) {
         }
 
         for (int i = 0; i < list->values.count; ++i) {
-          push(vm, list->values.values[i]);
+          PUSH(list->values.values[i]);
         }
 
         DISPATCH();
       }
     
     CASE_CODE(SUBSCRIPT): {
-        Value indexValue = peek(vm, 0);
-        Value subscriptValue = peek(vm, 1);
+        Value indexValue = PEEK(0);
+        Value subscriptValue = PEEK(1);
 
         if (!IS_OBJ(subscriptValue)) {
           RUNTIME_ERROR_TYPE("'%s' is not subscriptable", 1);
@@ -1439,9 +2174,8 @@ static DictuInterpretResult run(DictuVM *vm) {
             index = list->values.count + index;
 
           if (index >= 0 && index < list->values.count) {
-            pop(vm);
-            pop(vm);
-            push(vm, list->values.values[index]);
+            DROP(2);
+            PUSH(list->values.values[index]);
             DISPATCH();
           }
 
@@ -1457,9 +2191,10 @@ static DictuInterpretResult run(DictuVM *vm) {
             index = string->length + index;
 
           if (index >= 0 && index < string->length) {
-            pop(vm);
-            pop(vm);
-            push(vm, OBJ_VAL(copyString(vm, &string->chars[index], 1)));
+            SAVE_SP();
+            Value character = OBJ_VAL(copyString(vm, &string->chars[index], 1));
+            DROP(1);
+            TOP = character;
             DISPATCH();
           }
 
@@ -1473,10 +2208,9 @@ static DictuInterpretResult run(DictuVM *vm) {
           }
 
           Value v;
-          pop(vm);
-          pop(vm);
+          DROP(2);
           if (dictGet(dict, indexValue, &v)) {
-            push(vm, v);
+            PUSH(v);
             DISPATCH();
           }
 
@@ -1491,9 +2225,9 @@ static DictuInterpretResult run(DictuVM *vm) {
         
       
       CASE_CODE(SUBSCRIPT_ASSIGN): {
-          Value assignValue = peek(vm, 0);
-          Value indexValue = peek(vm, 1);
-          Value subscriptValue = peek(vm, 2);
+          Value assignValue = PEEK(0);
+          Value indexValue = PEEK(1);
+          Value subscriptValue = PEEK(2);
 
           if (!IS_OBJ(subscriptValue)) {
             RUNTIME_ERROR_TYPE("'%s' does not support item assignment", 2);
@@ -1513,10 +2247,8 @@ static DictuInterpretResult run(DictuVM *vm) {
 
             if (index >= 0 && index < list->values.count) {
               list->values.values[index] = assignValue;
-              pop(vm);
-              pop(vm);
-              pop(vm);
-              push(vm, NIL_VAL);
+              DROP(3);
+              PUSH(NIL_VAL);
               DISPATCH();
             }
 
@@ -1529,9 +2261,9 @@ static DictuInterpretResult run(DictuVM *vm) {
           }
         }
     CASE_CODE(SUBSCRIPT_PUSH): {
-        Value value = peek(vm, 0);
-        Value indexValue = peek(vm, 1);
-        Value subscriptValue = peek(vm, 2);
+        Value value = PEEK(0);
+        Value indexValue = PEEK(1);
+        Value subscriptValue = PEEK(2);
 
         if (!IS_OBJ(subscriptValue)) {
           RUNTIME_ERROR_TYPE("'%s' does not support item assignment", 2);
@@ -1551,8 +2283,8 @@ static DictuInterpretResult run(DictuVM *vm) {
             index = list->values.count + index;
 
           if (index >= 0 && index < list->values.count) {
-            vm->stackTop[-1] = list->values.values[index];
-            push(vm, value);
+            TOP = list->values.values[index];
+            PUSH(value);
             DISPATCH();
           }
 
@@ -1566,9 +2298,9 @@ static DictuInterpretResult run(DictuVM *vm) {
         DISPATCH();
       }
     CASE_CODE(SLICE): {
-        Value sliceEndIndex = peek(vm, 0);
-        Value sliceStartIndex = peek(vm, 1);
-        Value objectValue = peek(vm, 2);
+        Value sliceEndIndex = PEEK(0);
+        Value sliceStartIndex = PEEK(1);
+        Value objectValue = PEEK(2);
 
         if (!IS_OBJ(objectValue)) {
           RUNTIME_ERROR("Can only slice on lists and strings.");
@@ -1592,10 +2324,12 @@ static DictuInterpretResult run(DictuVM *vm) {
           }
         }
 
+        SAVE_SP();
         switch (getObjType(objectValue)) {
         case OBJ_LIST: {
           ObjList *createdList = newList(vm);
-          push(vm, OBJ_VAL(createdList));
+          PUSH(OBJ_VAL(createdList));
+          SAVE_SP();
           ObjList *list = AS_LIST(objectValue);
 
           if (IS_EMPTY(sliceEndIndex)) {
@@ -1614,7 +2348,7 @@ static DictuInterpretResult run(DictuVM *vm) {
             writeValueArray(vm, &createdList->values, list->values.values[i]);
           }
 
-          pop(vm);
+          DROP(1);
           returnVal = OBJ_VAL(createdList);
 
           break;
@@ -1649,11 +2383,9 @@ static DictuInterpretResult run(DictuVM *vm) {
         }
         }
 
-        pop(vm);
-        pop(vm);
-        pop(vm);
+        DROP(3);
 
-        push(vm, returnVal);
+        PUSH(returnVal);
         DISPATCH();
       }
 
@@ -1661,12 +2393,55 @@ static DictuInterpretResult run(DictuVM *vm) {
         int argCount = READ_BYTE();
         bool unpack = READ_BYTE();
 
-        frame->ip = ip;
-        if (!callValue(vm, peek(vm, argCount), argCount, unpack)) {
+        STORE_FRAME;
+        if (!callValue(vm, PEEK(argCount), argCount, unpack)) {
           return INTERPRET_RUNTIME_ERROR;
         }
-        frame = &vm->frames[vm->frameCount - 1];
-        ip = frame->ip;
+        LOAD_SP();
+        LOAD_FRAME();
+        DISPATCH();
+      }
+
+    CASE_CODE(TAIL_CALL): {
+        int argCount = READ_BYTE();
+        bool unpack = READ_BYTE();
+
+        int frameCount = vm->frameCount;
+
+        STORE_FRAME;
+        if (!callValue(vm, PEEK(argCount), argCount, unpack)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        LOAD_SP();
+
+        // Anything other than a closure has already completed and the
+        // following OP_RETURN hands back its result.
+        if (vm->frameCount == frameCount) {
+          LOAD_FRAME();
+          DISPATCH();
+        }
+
+        // The new frame replaces the returning one, sliding the callee
+        // and its arguments down over the old slots.
+        frame = &vm->frames[vm->frameCount - 2];
+        CallFrame *callee = &vm->frames[vm->frameCount - 1];
+        int count = vm->stackTop - callee->slots;
+
+        closeUpvalues(vm, frame->slots);
+
+        if (frame->closure->function->pooledVarargs) {
+          releaseVarargsList(vm, frame);
+        }
+
+        memmove(frame->slots, callee->slots, sizeof(Value) * count);
+        frame->closure = callee->closure;
+        frame->ip = callee->ip;
+        frame->varargs = callee->varargs;
+        vm->stackTop = frame->slots + count;
+        vm->frameCount--;
+
+        LOAD_SP();
+        LOAD_FRAME();
         DISPATCH();
       }
 
@@ -1675,12 +2450,56 @@ static DictuInterpretResult run(DictuVM *vm) {
         ObjString *method = READ_STRING();
         bool unpack = READ_BYTE();
 
-        frame->ip = ip;
+        STORE_FRAME;
         if (!invoke(vm, method, argCount, unpack)) {
           return INTERPRET_RUNTIME_ERROR;
         }
-        frame = &vm->frames[vm->frameCount - 1];
-        ip = frame->ip;
+        LOAD_SP();
+        LOAD_FRAME();
+        DISPATCH();
+      }
+
+    CASE_CODE(LEN): {
+        ObjString *method = READ_STRING();
+        Value receiver = PEEK(0);
+
+        if (IS_LIST(receiver)) {
+          TOP = INT_VAL(AS_LIST(receiver)->values.count);
+          DISPATCH();
+        }
+
+        if (IS_STRING(receiver)) {
+          TOP = INT_VAL(AS_STRING(receiver)->length);
+          DISPATCH();
+        }
+
+        STORE_FRAME;
+        if (!invoke(vm, method, 0, false)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        LOAD_SP();
+        LOAD_FRAME();
+        DISPATCH();
+      }
+
+    CASE_CODE(MATH_UNARY): {
+        MathFunction function = READ_BYTE();
+        ObjString *method = READ_STRING();
+
+        // Only the builtin module with a number argument, anything else
+        // is called the ordinary way.
+        if (IS_OBJ(PEEK(1)) && AS_OBJ(PEEK(1)) == (Obj *) vm->mathModule && IS_NUMBER(PEEK(0))) {
+          double value = AS_NUMBER(POP());
+          TOP = NUMBER_VAL(mathUnary(function, value));
+          DISPATCH();
+        }
+
+        STORE_FRAME;
+        if (!invoke(vm, method, 1, false)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        LOAD_SP();
+        LOAD_FRAME();
         DISPATCH();
       }
 
@@ -1689,12 +2508,12 @@ static DictuInterpretResult run(DictuVM *vm) {
         ObjString *method = READ_STRING();
         bool unpack = READ_BYTE();
 
-        frame->ip = ip;
+        STORE_FRAME;
         if (!invokeInternal(vm, method, argCount, unpack)) {
           return INTERPRET_RUNTIME_ERROR;
         }
-        frame = &vm->frames[vm->frameCount - 1];
-        ip = frame->ip;
+        LOAD_SP();
+        LOAD_FRAME();
         DISPATCH();
       }
 
@@ -1703,13 +2522,13 @@ static DictuInterpretResult run(DictuVM *vm) {
         ObjString *method = READ_STRING();
         bool unpack = READ_BYTE();
 
-        frame->ip = ip;
-        ObjClass *superclass = AS_CLASS(pop(vm));
+        ObjClass *superclass = AS_CLASS(POP());
+        STORE_FRAME;
         if (!invokeFromClass(vm, superclass, method, argCount, unpack)) {
           return INTERPRET_RUNTIME_ERROR;
         }
-        frame = &vm->frames[vm->frameCount - 1];
-        ip = frame->ip;
+        LOAD_SP();
+        LOAD_FRAME();
         DISPATCH();
       }
 
@@ -1718,8 +2537,10 @@ static DictuInterpretResult run(DictuVM *vm) {
 
         // Create the closure and push it on the stack before creating
         // upvalues so that it doesn't get collected.
+        SAVE_SP();
         ObjClosure *closure = newClosure(vm, function);
-        push(vm, OBJ_VAL(closure));
+        PUSH(OBJ_VAL(closure));
+        SAVE_SP();
 
         // Capture upvalues.
         for (int i = 0; i < closure->upvalueCount; i++) {
@@ -1728,7 +2549,7 @@ static DictuInterpretResult run(DictuVM *vm) {
           if (isLocal) {
             // Make an new upvalue to close over the parent's local
             // variable.
-            closure->upvalues[i] = captureUpvalue(vm, frame->slots + index);
+            closure->upvalues[i] = captureUpvalue(vm, slots + index);
           } else {
             // Use the same upvalue as the current call frame.
             closure->upvalues[i] = frame->closure->upvalues[index];
@@ -1739,42 +2560,48 @@ static DictuInterpretResult run(DictuVM *vm) {
       }
 
     CASE_CODE(CLOSE_UPVALUE): {
-        closeUpvalues(vm, vm->stackTop - 1);
-        pop(vm);
+        SPILL_TOS();
+        closeUpvalues(vm, STACK_END() - 1);
+        DROP(1);
         DISPATCH();
       }
 
     CASE_CODE(RETURN): {
-        Value result = pop(vm);
+        Value result = POP();
 
         // Close any upvalues still in scope.
-        closeUpvalues(vm, frame->slots);
+        closeUpvalues(vm, slots);
+
+        if (frame->closure->function->pooledVarargs) {
+          releaseVarargsList(vm, frame);
+        }
 
         vm->frameCount--;
+        DROP(STACK_END() - slots - 1);
+        TOP = result;
 
-        if (vm->frameCount == 0) {
-          pop(vm);
+        // Leave the result on the stack for whoever entered this run.
+        if (vm->frameCount == frameBase) {
+          SAVE_SP();
           return INTERPRET_OK;
         }
 
-        vm->stackTop = frame->slots;
-        push(vm, result);
-
-        frame = &vm->frames[vm->frameCount - 1];
-        ip = frame->ip;
+        LOAD_FRAME();
         DISPATCH();
       }
 
     CASE_CODE(CLASS): {
         ClassType type = READ_BYTE();
+        SAVE_SP();
         createClass(vm, READ_STRING(), NULL, type);
+        LOAD_SP();
         DISPATCH();
       }
       
     CASE_CODE(SUBCLASS): {
         ClassType type = READ_BYTE();
 
-        Value superclass = peek(vm, 0);
+        Value superclass = PEEK(0);
         if (!IS_CLASS(superclass)) {
           RUNTIME_ERROR("Superclass must be a class.");
         }
@@ -1783,13 +2610,16 @@ static DictuInterpretResult run(DictuVM *vm) {
           RUNTIME_ERROR("Superclass can not be a trait.");
         }
 
+        SAVE_SP();
         createClass(vm, READ_STRING(), AS_CLASS(superclass), type);
+        LOAD_SP();
         DISPATCH();
       }
     CASE_CODE(END_CLASS): {
-        ObjClass *klass = AS_CLASS(peek(vm, 0));
+        ObjClass *klass = AS_CLASS(PEEK(0));
 
         // If super class is abstract, ensure we have defined all abstract methods
+        tableFinishResize(vm, &klass->abstractMethods);
         for (int i = 0; i < klass->abstractMethods.capacityMask + 1; i++) {
           if (klass->abstractMethods.entries[i].key == NULL) {
             continue;
@@ -1804,7 +2634,9 @@ static DictuInterpretResult run(DictuVM *vm) {
       }
 
     CASE_CODE(METHOD):
+      SAVE_SP();
       defineMethod(vm, READ_STRING());
+      LOAD_SP();
       DISPATCH();
     }
 
@@ -1813,17 +2645,148 @@ static DictuInterpretResult run(DictuVM *vm) {
 #undef READ_CONSTANT
 #undef READ_STRING
 #undef BINARY_OP
+#undef INT_BINARY_OP
+#undef BIGINT_OP
+#undef NUMERIC_OP
+#undef INTEGER_OP
 #undef BINARY_OP_FUNCTION
 #undef STORE_FRAME
 #undef RUNTIME_ERROR
+#undef SAVE_SP
+#undef LOAD_SP
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef TOP
+#undef DROP
+#undef STACK_END
+#undef SPILL_TOS
+#undef FILL_TOS
+#undef LOAD_FRAME
 
     return INTERPRET_RUNTIME_ERROR;
     
 }
 
 
-DictuInterpretResult dictuInterpret(DictuVM *vm, char *moduleName, char *source) {
-  
+// Runs the frame a call may have pushed until it returns.
+static bool finishCall(DictuVM *vm, int frameCount) {
+  return vm->frameCount == frameCount || run(vm, frameCount) == INTERPRET_OK;
+}
+
+bool aotCall(DictuVM *vm, int argCount, bool unpack) {
+  int frameCount = vm->frameCount;
+  return callValue(vm, peek(vm, argCount), argCount, unpack) && finishCall(vm, frameCount);
+}
+
+bool aotInvoke(DictuVM *vm, ObjString *name, int argCount, bool unpack) {
+  int frameCount = vm->frameCount;
+  return invoke(vm, name, argCount, unpack) && finishCall(vm, frameCount);
+}
+
+bool aotInvokeInternal(DictuVM *vm, ObjString *name, int argCount, bool unpack) {
+  int frameCount = vm->frameCount;
+  return invokeInternal(vm, name, argCount, unpack) && finishCall(vm, frameCount);
+}
+
+bool aotSuper(DictuVM *vm, ObjString *name, int argCount, bool unpack) {
+  ObjClass *superclass = AS_CLASS(pop(vm));
+  int frameCount = vm->frameCount;
+  return invokeFromClass(vm, superclass, name, argCount, unpack) && finishCall(vm, frameCount);
+}
+
+bool aotResume(DictuVM *vm) {
+  return run(vm, vm->frameCount - 1) == INTERPRET_OK;
+}
+
+bool aotReturn(DictuVM *vm) {
+  CallFrame *frame = &vm->frames[vm->frameCount - 1];
+  Value result = pop(vm);
+
+  closeUpvalues(vm, frame->slots);
+
+  if (frame->closure->function->pooledVarargs) {
+    releaseVarargsList(vm, frame);
+  }
+
+  vm->frameCount--;
+  vm->stackTop = frame->slots;
+  push(vm, result);
+  return true;
+}
+
+bool aotImportBuiltin(DictuVM *vm, int index, ObjString *fileName) {
+  Value module;
+
+  if (tableGet(&vm->modules, fileName, &module)) {
+    vm->lastModule = AS_MODULE(module);
+    push(vm, module);
+    return true;
+  }
+
+  module = importBuiltinModule(vm, index);
+
+  if (IS_EMPTY(module)) {
+    return false;
+  }
+
+  push(vm, module);
+
+  if (IS_CLOSURE(module)) {
+    int frameCount = vm->frameCount;
+    call(vm, AS_CLOSURE(module), 0);
+
+    tableGet(&vm->modules, fileName, &module);
+    vm->lastModule = AS_MODULE(module);
+    return finishCall(vm, frameCount);
+  }
+
+  return true;
+}
+
+void aotClass(DictuVM *vm, ObjString *name, ObjClass *superclass, ClassType type) {
+  createClass(vm, name, superclass, type);
+}
+
+void aotMethod(DictuVM *vm, ObjString *name) {
+  defineMethod(vm, name);
+}
+
+void aotConcatenate(DictuVM *vm) {
+  concatenate(vm);
+}
+
+void aotCloseUpvalues(DictuVM *vm, Value *last) {
+  closeUpvalues(vm, last);
+}
+
+void aotClosure(DictuVM *vm, ObjFunction *function, uint8_t *captures) {
+  CallFrame *frame = &vm->frames[vm->frameCount - 1];
+  ObjClosure *closure = newClosure(vm, function);
+  push(vm, OBJ_VAL(closure));
+
+  for (int i = 0; i < closure->upvalueCount; i++) {
+    uint8_t isLocal = *captures++;
+    uint8_t index = *captures++;
+    if (isLocal) {
+      closure->upvalues[i] = captureUpvalue(vm, frame->slots + index);
+    } else {
+      closure->upvalues[i] = frame->closure->upvalues[index];
+    }
+  }
+}
+
+// Called once an allocation has unwound to the call that entered the VM,
+// the frames it left are dropped like those of a runtime error.
+static DictuInterpretResult unwindOutOfMemory(DictuVM *vm, jmp_buf *enclosing, int aotDepth) {
+  vm->memoryError = enclosing;
+  vm->aotDepth = aotDepth;
+  resetStack(vm);
+
+  return INTERPRET_RUNTIME_ERROR;
+}
+
+static DictuInterpretResult interpret(DictuVM *vm, char *moduleName, char *source) {
   ObjString *name = copyString(vm, moduleName, strlen(moduleName));
   push(vm, OBJ_VAL(name));
   ObjModule *module = newModule(vm, name);
@@ -1839,8 +2802,176 @@ DictuInterpretResult dictuInterpret(DictuVM *vm, char *moduleName, char *source)
   ObjClosure *closure = newClosure(vm, function);
   pop(vm);
   push(vm, OBJ_VAL(closure));
-  callValue(vm, OBJ_VAL(closure), 0, false);
-  DictuInterpretResult result = run(vm);
+
+  // A compiled script has already run to completion within the call.
+  DictuInterpretResult result = INTERPRET_RUNTIME_ERROR;
+  if (callValue(vm, OBJ_VAL(closure), 0, false)) {
+    result = vm->frameCount == 0 ? INTERPRET_OK : run(vm, 0);
+  }
+
+  if (result == INTERPRET_OK) {
+    pop(vm);
+  }
   
   return result;
 }
+
+DictuInterpretResult dictuInterpret(DictuVM *vm, char *moduleName, char *source) {
+  jmp_buf *enclosing = vm->memoryError;
+  int aotDepth = vm->aotDepth;
+  jmp_buf memoryError;
+
+  if (setjmp(memoryError) != 0) {
+    return unwindOutOfMemory(vm, enclosing, aotDepth);
+  }
+
+  vm->memoryError = &memoryError;
+  DictuInterpretResult result = interpret(vm, moduleName, source);
+  vm->memoryError = enclosing;
+
+  return result;
+}
+
+static DictuHandle *newHandle(DictuVM *vm, Value value) {
+  push(vm, value);
+  DictuHandle *handle = ALLOCATE(vm, DictuHandle, 1);
+  pop(vm);
+
+  handle->value = value;
+  handle->prev = NULL;
+  handle->next = vm->handles;
+
+  if (vm->handles != NULL) {
+    vm->handles->prev = handle;
+  }
+
+  vm->handles = handle;
+  return handle;
+}
+
+DictuHandle *dictuGetVariable(DictuVM *vm, const char *moduleName, const char *name) {
+  Value module;
+  Value value;
+
+  ObjString *string = copyString(vm, moduleName, strlen(moduleName));
+  if (!tableGet(&vm->modules, string, &module)) {
+    return NULL;
+  }
+
+  string = copyString(vm, name, strlen(name));
+  if (tableGet(&AS_MODULE(module)->values, string, &value) ||
+      tableGet(&vm->globals, string, &value)) {
+    return newHandle(vm, value);
+  }
+
+  return NULL;
+}
+
+void dictuReleaseHandle(DictuVM *vm, DictuHandle *handle) {
+  if (handle->prev != NULL) {
+    handle->prev->next = handle->next;
+  } else {
+    vm->handles = handle->next;
+  }
+
+  if (handle->next != NULL) {
+    handle->next->prev = handle->prev;
+  }
+
+  FREE(vm, DictuHandle, handle);
+}
+
+// The embedding API pushes straight onto the VM stack, which has no
+// room to grow, so each push reports whether the value fit.
+static bool pushEmbedded(DictuVM *vm, Value value) {
+  if (vm->stackTop == vm->stack + STACK_MAX) {
+    return false;
+  }
+
+  push(vm, value);
+  return true;
+}
+
+bool dictuPushHandle(DictuVM *vm, DictuHandle *handle) {
+  return pushEmbedded(vm, handle->value);
+}
+
+bool dictuPushNil(DictuVM *vm) {
+  return pushEmbedded(vm, NIL_VAL);
+}
+
+bool dictuPushBool(DictuVM *vm, bool value) {
+  return pushEmbedded(vm, BOOL_VAL(value));
+}
+
+bool dictuPushNumber(DictuVM *vm, double value) {
+  return pushEmbedded(vm, NUMBER_VAL(value));
+}
+
+bool dictuPushString(DictuVM *vm, const char *chars, int length) {
+  if (vm->stackTop == vm->stack + STACK_MAX) {
+    return false;
+  }
+
+  push(vm, OBJ_VAL(copyString(vm, chars, length)));
+  return true;
+}
+
+DictuInterpretResult dictuCall(DictuVM *vm, int argCount) {
+  jmp_buf *enclosing = vm->memoryError;
+  int aotDepth = vm->aotDepth;
+  jmp_buf memoryError;
+
+  vm->callResult = NIL_VAL;
+
+  if (setjmp(memoryError) != 0) {
+    return unwindOutOfMemory(vm, enclosing, aotDepth);
+  }
+
+  vm->memoryError = &memoryError;
+  bool completed = callToCompletion(vm, argCount);
+  vm->memoryError = enclosing;
+
+  if (!completed) {
+    return INTERPRET_RUNTIME_ERROR;
+  }
+
+  vm->callResult = pop(vm);
+  return INTERPRET_OK;
+}
+
+DictuType dictuResultType(DictuVM *vm) {
+  Value result = vm->callResult;
+
+  if (IS_BOOL(result)) return DICTU_TYPE_BOOL;
+  if (IS_NUMBER(result)) return DICTU_TYPE_NUMBER;
+  if (IS_STRING(result)) return DICTU_TYPE_STRING;
+  if (IS_OBJ(result)) return DICTU_TYPE_OBJECT;
+
+  return DICTU_TYPE_NIL;
+}
+
+bool dictuResultBool(DictuVM *vm) {
+  return !isFalsey(vm->callResult);
+}
+
+double dictuResultNumber(DictuVM *vm) {
+  return IS_NUMBER(vm->callResult) ? AS_NUMBER(vm->callResult) : 0;
+}
+
+const char *dictuResultString(DictuVM *vm, int *length) {
+  if (!IS_STRING(vm->callResult)) {
+    return NULL;
+  }
+
+  ObjString *string = AS_STRING(vm->callResult);
+  if (length != NULL) {
+    *length = string->length;
+  }
+
+  return string->chars;
+}
+
+DictuHandle *dictuResultHandle(DictuVM *vm) {
+  return newHandle(vm, vm->callResult);
+}
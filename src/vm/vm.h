@@ -1,20 +1,42 @@
 #ifndef oolong_vm_h
 #define oolong_vm_h
 
+#include <setjmp.h>
+
 #include "object.h"
 #include "table.h"
 #include "value.h"
 #include "compiler.h"
+#include "heap.h"
+#include "mark.h"
 
 // TODO: Work out the maximum stack size at compilation time
 #define STACK_MAX (64 * UINT8_COUNT)
 
+// Lists kept for variadic calls whose list never escapes, and the
+// largest capacity a list may keep while in the pool.
+#define VARARGS_POOL_MAX 16
+#define VARARGS_POOL_CAPACITY 64
+
+// Nested calls into ahead of time compiled functions, each of which
+// runs on the C stack. Deeper calls are left to the interpreter.
+#define AOT_MAX_DEPTH 1000
+
+typedef struct sAotEntry AotEntry;
+
 typedef struct {
   ObjClosure *closure;
   uint8_t *ip;
   Value *slots;
+  ObjList *varargs;
 } CallFrame;
 
+struct sDictuHandle {
+  Value value;
+  DictuHandle *prev;
+  DictuHandle *next;
+};
+
 struct _vm {
   Compiler *compiler;
   Value stack[STACK_MAX];
@@ -24,6 +46,16 @@ struct _vm {
   int frameCount;
   int frameCapacity;
   ObjModule *lastModule;
+
+  // The builtin Math module once imported, intrinsics check against it.
+  ObjModule *mathModule;
+  ObjList *varargsPool[VARARGS_POOL_MAX];
+  int varargsPoolCount;
+
+  // Compiled functions linked in at compile time, see aot.h.
+  const AotEntry *aotEntries;
+  int aotEntryCount;
+  int aotDepth;
   Table modules;
   Table globals;
   Table constants;
@@ -39,16 +71,49 @@ struct _vm {
   Table classMethods;
   Table instanceMethods;
   Table resultMethods;
+  Table streamMethods;
+  Table bigIntMethods;
   ObjString *initString;
   ObjString *annotationString;
+  ObjString *hasNextString;
+  ObjString *nextString;
   ObjString *replVar;
   ObjUpvalue *openUpvalues;
+  DictuHandle *handles;
+  AbstractType *abstractTypes;
+
+  // Every weak reference and weak-key dict, see weak.h.
+  WeakRef *weakRefs;
+  WeakDict *weakDicts;
+  Value callResult;
   size_t bytesAllocated;
   size_t nextGC;
-  Obj *objects;
-  int grayCount;
-  int grayCapacity;
-  Obj **grayStack;
+
+  // Heap sizing, see DictuGCOptions. Between collections the heap grows
+  // by heapGrowth times what survived, adjusted towards gcTarget.
+  size_t minHeap;
+  size_t maxHeap;
+  double gcTarget;
+  double heapGrowth;
+
+  // When the last collection ended, the running time since is what
+  // the next one is measured against.
+  double gcCycleStart;
+
+  // Where an allocation the heap cannot make unwinds to, set while
+  // dictuInterpret or dictuCall runs.
+  jmp_buf *memoryError;
+  Heap heap;
+  Marker marker;
+
+  // Threads marking a large heap, see mark.h.
+  int markThreads;
+  MarkPool *markPool;
+
+  // Whether sparse pages are compacted, and whether the last collection
+  // asked for it. See compact.h.
+  bool compact;
+  bool compactPending;
   int argc;
   char **argv;
 };
@@ -66,6 +131,10 @@ Value pop(DictuVM *vm);
 
 bool isFalsey(Value value);
 
+// Calls a function, closure, class or native from native code and
+// returns its result, or EMPTY_VAL if a runtime error was raised.
+Value callFunction(DictuVM *vm, Value callee, int argCount, Value *args);
+
 ObjClosure *compileModuleToClosure(DictuVM *vm, char *name, char *source);
 
 
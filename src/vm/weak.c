@@ -0,0 +1,508 @@
+#include "weak.h"
+#include "abstracts.h"
+#include "heap.h"
+#include "memory.h"
+#include "mark.h"
+
+#define TABLE_MAX_LOAD 0.75
+
+struct sWeakRef {
+    ObjAbstract *owner;
+
+    // NULL once the object is collected.
+    Obj *target;
+    WeakRef *prev;
+    WeakRef *next;
+};
+
+typedef struct {
+    Obj *key;
+    Value value;
+
+    // Set while the entries are put back in place, see rehashEntries.
+    bool stale;
+} WeakEntry;
+
+// Open addressing with linear probing, entries are moved around
+// wholesale when keys are dropped or moved by the collector.
+struct sWeakDict {
+    ObjAbstract *owner;
+    int count;
+    int capacityMask;
+    WeakEntry *entries;
+    WeakDict *prev;
+    WeakDict *next;
+};
+
+static inline uint32_t hashKey(Obj *key) {
+    uint64_t bits = (uintptr_t) key >> 3;
+    return (uint32_t) ((bits * 0x9E3779B97F4A7C15u) >> 32);
+}
+
+static WeakEntry *findEntry(WeakDict *dict, Obj *key) {
+    if (dict->count == 0) return NULL;
+
+    uint32_t index = hashKey(key) & dict->capacityMask;
+
+    for (;;) {
+        WeakEntry *entry = &dict->entries[index];
+
+        if (entry->key == key) {
+            return entry;
+        }
+
+        if (entry->key == NULL) {
+            return NULL;
+        }
+
+        index = (index + 1) & dict->capacityMask;
+    }
+}
+
+static WeakEntry *emptyEntry(WeakEntry *entries, int capacityMask, Obj *key) {
+    uint32_t index = hashKey(key) & capacityMask;
+
+    while (entries[index].key != NULL) {
+        index = (index + 1) & capacityMask;
+    }
+
+    return &entries[index];
+}
+
+// Closes the gap left by an entry by moving back the ones after it
+// that would no longer be found past it.
+static void removeEntry(WeakDict *dict, WeakEntry *entry) {
+    uint32_t capacityMask = dict->capacityMask;
+    uint32_t hole = entry - dict->entries;
+    uint32_t index = hole;
+
+    for (;;) {
+        index = (index + 1) & capacityMask;
+        WeakEntry *next = &dict->entries[index];
+
+        if (next->key == NULL) {
+            break;
+        }
+
+        // Moved back only if the hole is on its path from its home slot.
+        uint32_t home = hashKey(next->key) & capacityMask;
+        if (((index - home) & capacityMask) >= ((index - hole) & capacityMask)) {
+            dict->entries[hole] = *next;
+            hole = index;
+        }
+    }
+
+    dict->entries[hole].key = NULL;
+    dict->entries[hole].value = NIL_VAL;
+    dict->count--;
+}
+
+/*
+ * Puts every entry back where a lookup from its home slot finds it,
+ * after the collector dropped or moved keys. Runs inside a collection,
+ * so it works in place: each entry is placed at the first slot from its
+ * home that is empty or holds an entry not yet placed, which is then
+ * taken out and placed in turn. Placed entries never move again, and
+ * only ever probed past other placed ones.
+ */
+static void rehashEntries(WeakDict *dict) {
+    WeakEntry *entries = dict->entries;
+    int capacityMask = dict->capacityMask;
+
+    for (int i = 0; i <= capacityMask; i++) {
+        entries[i].stale = entries[i].key != NULL;
+    }
+
+    for (int i = 0; i <= capacityMask; i++) {
+        if (!entries[i].stale) {
+            continue;
+        }
+
+        WeakEntry entry = entries[i];
+        entries[i].key = NULL;
+        entries[i].value = NIL_VAL;
+        entries[i].stale = false;
+
+        for (;;) {
+            uint32_t index = hashKey(entry.key) & capacityMask;
+            while (entries[index].key != NULL && !entries[index].stale) {
+                index = (index + 1) & capacityMask;
+            }
+
+            WeakEntry displaced = entries[index];
+            entry.stale = false;
+            entries[index] = entry;
+
+            if (displaced.key == NULL) {
+                break;
+            }
+
+            entry = displaced;
+        }
+    }
+}
+
+static void adjustCapacity(DictuVM *vm, WeakDict *dict, int capacityMask) {
+    // Allocated before anything changes, a collection may run.
+    WeakEntry *entries = ALLOCATE(vm, WeakEntry, capacityMask + 1);
+    for (int i = 0; i <= capacityMask; i++) {
+        entries[i].key = NULL;
+        entries[i].value = NIL_VAL;
+        entries[i].stale = false;
+    }
+
+    WeakEntry *oldEntries = dict->entries;
+    int oldMask = dict->capacityMask;
+
+    for (int i = 0; i <= oldMask; i++) {
+        if (oldEntries[i].key != NULL) {
+            *emptyEntry(entries, capacityMask, oldEntries[i].key) = oldEntries[i];
+        }
+    }
+
+    dict->entries = entries;
+    dict->capacityMask = capacityMask;
+    FREE_ARRAY(vm, WeakEntry, oldEntries, oldMask + 1);
+}
+
+static AbstractType *weakType(DictuVM *vm, const AbstractTypeDescriptor *descriptor) {
+    for (AbstractType *type = vm->abstractTypes; type != NULL; type = type->next) {
+        if (type->descriptor == descriptor) {
+            return type;
+        }
+    }
+
+    return defineAbstractType(vm, descriptor);
+}
+
+static Value weakRefGet(DictuVM *vm, int argCount, Value *args) {
+    UNUSED(vm); UNUSED(argCount);
+
+    WeakRef *ref = AS_ABSTRACT(args[0])->data;
+
+    if (ref->target == NULL) {
+        return NIL_VAL;
+    }
+
+    return OBJ_VAL(ref->target);
+}
+
+static Value weakRefAlive(DictuVM *vm, int argCount, Value *args) {
+    UNUSED(vm); UNUSED(argCount);
+
+    WeakRef *ref = AS_ABSTRACT(args[0])->data;
+    return BOOL_VAL(ref->target != NULL);
+}
+
+static const AbstractMethod weakRefMethods[] = {
+    {"get", weakRefGet, ""},
+    {"alive", weakRefAlive, ""},
+};
+
+static const AbstractTypeDescriptor weakRefType = {
+    "WeakRef", NULL, 0, weakRefMethods, sizeof(weakRefMethods) / sizeof(weakRefMethods[0])
+};
+
+static void freeWeakRef(DictuVM *vm, ObjAbstract *abstract) {
+    WeakRef *ref = abstract->data;
+
+    if (ref->prev != NULL) {
+        ref->prev->next = ref->next;
+    } else {
+        vm->weakRefs = ref->next;
+    }
+
+    if (ref->next != NULL) {
+        ref->next->prev = ref->prev;
+    }
+
+    FREE(vm, WeakRef, ref);
+}
+
+static Value refNative(DictuVM *vm, int argCount, Value *args) {
+    UNUSED(argCount);
+
+    if (!IS_OBJ(args[0])) {
+        runtimeError(vm, "ref() argument must be an object");
+        return EMPTY_VAL;
+    }
+
+    AbstractType *type = weakType(vm, &weakRefType);
+    WeakRef *ref = ALLOCATE(vm, WeakRef, 1);
+    ref->target = AS_OBJ(args[0]);
+
+    // Only linked in once the abstract owns it, a collection while
+    // allocating would look at the owner.
+    ObjAbstract *abstract = newTypedAbstract(vm, type, ref, freeWeakRef);
+    ref->owner = abstract;
+    ref->prev = NULL;
+    ref->next = vm->weakRefs;
+
+    if (vm->weakRefs != NULL) {
+        vm->weakRefs->prev = ref;
+    }
+
+    vm->weakRefs = ref;
+
+    return OBJ_VAL(abstract);
+}
+
+// Checks a key passed to a method of a weak-key dict.
+static bool checkKey(DictuVM *vm, const char *method, Value key) {
+    if (!IS_OBJ(key)) {
+        runtimeError(vm, "Key passed to %s() must be an object", method);
+        return false;
+    }
+
+    return true;
+}
+
+static Value weakDictGet(DictuVM *vm, int argCount, Value *args) {
+    if (!checkKey(vm, "get", args[1])) {
+        return EMPTY_VAL;
+    }
+
+    WeakDict *dict = AS_ABSTRACT(args[0])->data;
+    WeakEntry *entry = findEntry(dict, AS_OBJ(args[1]));
+
+    if (entry != NULL) {
+        return entry->value;
+    }
+
+    return argCount == 2 ? args[2] : NIL_VAL;
+}
+
+static Value weakDictSet(DictuVM *vm, int argCount, Value *args) {
+    UNUSED(argCount);
+
+    if (!checkKey(vm, "set", args[1])) {
+        return EMPTY_VAL;
+    }
+
+    WeakDict *dict = AS_ABSTRACT(args[0])->data;
+    Obj *key = AS_OBJ(args[1]);
+    WeakEntry *entry = findEntry(dict, key);
+
+    if (entry != NULL) {
+        entry->value = args[2];
+        return NIL_VAL;
+    }
+
+    if (dict->count + 1 > (dict->capacityMask + 1) * TABLE_MAX_LOAD) {
+        int capacityMask = GROW_CAPACITY(dict->capacityMask + 1) - 1;
+        adjustCapacity(vm, dict, capacityMask);
+    }
+
+    entry = emptyEntry(dict->entries, dict->capacityMask, key);
+    entry->key = key;
+    entry->value = args[2];
+    dict->count++;
+
+    return NIL_VAL;
+}
+
+static Value weakDictExists(DictuVM *vm, int argCount, Value *args) {
+    UNUSED(argCount);
+
+    if (!checkKey(vm, "exists", args[1])) {
+        return EMPTY_VAL;
+    }
+
+    WeakDict *dict = AS_ABSTRACT(args[0])->data;
+    return BOOL_VAL(findEntry(dict, AS_OBJ(args[1])) != NULL);
+}
+
+static Value weakDictRemove(DictuVM *vm, int argCount, Value *args) {
+    UNUSED(argCount);
+
+    if (!checkKey(vm, "remove", args[1])) {
+        return EMPTY_VAL;
+    }
+
+    WeakDict *dict = AS_ABSTRACT(args[0])->data;
+    WeakEntry *entry = findEntry(dict, AS_OBJ(args[1]));
+
+    if (entry == NULL) {
+        runtimeError(vm, "Key passed to remove() does not exist within the dictionary");
+        return EMPTY_VAL;
+    }
+
+    removeEntry(dict, entry);
+    return NIL_VAL;
+}
+
+static Value weakDictLen(DictuVM *vm, int argCount, Value *args) {
+    UNUSED(vm); UNUSED(argCount);
+
+    WeakDict *dict = AS_ABSTRACT(args[0])->data;
+    return INT_VAL(dict->count);
+}
+
+static const AbstractMethod weakDictMethods[] = {
+    {"get", weakDictGet, ".|."},
+    {"set", weakDictSet, ".."},
+    {"exists", weakDictExists, "."},
+    {"remove", weakDictRemove, "."},
+    {"len", weakDictLen, ""},
+};
+
+static const AbstractTypeDescriptor weakDictType = {
+    "WeakKeyDict", NULL, 0, weakDictMethods, sizeof(weakDictMethods) / sizeof(weakDictMethods[0])
+};
+
+static void freeWeakDict(DictuVM *vm, ObjAbstract *abstract) {
+    WeakDict *dict = abstract->data;
+
+    if (dict->prev != NULL) {
+        dict->prev->next = dict->next;
+    } else {
+        vm->weakDicts = dict->next;
+    }
+
+    if (dict->next != NULL) {
+        dict->next->prev = dict->prev;
+    }
+
+    FREE_ARRAY(vm, WeakEntry, dict->entries, dict->capacityMask + 1);
+    FREE(vm, WeakDict, dict);
+}
+
+static Value keyDictNative(DictuVM *vm, int argCount, Value *args) {
+    UNUSED(argCount); UNUSED(args);
+
+    AbstractType *type = weakType(vm, &weakDictType);
+    WeakDict *dict = ALLOCATE(vm, WeakDict, 1);
+    dict->count = 0;
+    dict->capacityMask = -1;
+    dict->entries = NULL;
+
+    ObjAbstract *abstract = newTypedAbstract(vm, type, dict, freeWeakDict);
+    dict->owner = abstract;
+    dict->prev = NULL;
+    dict->next = vm->weakDicts;
+
+    if (vm->weakDicts != NULL) {
+        vm->weakDicts->prev = dict;
+    }
+
+    vm->weakDicts = dict;
+
+    return OBJ_VAL(abstract);
+}
+
+void processWeakReferences(DictuVM *vm) {
+    // Marking a value may reach the keys of other entries, so the dicts
+    // are gone over again until a pass marks nothing. Dicts that are
+    // themselves unreachable keep nothing alive.
+    bool marked;
+
+    do {
+        marked = false;
+
+        for (WeakDict *dict = vm->weakDicts; dict != NULL; dict = dict->next) {
+            if (!heapIsMarked(dict->owner)) {
+                continue;
+            }
+
+            for (int i = 0; i <= dict->capacityMask; i++) {
+                WeakEntry *entry = &dict->entries[i];
+
+                if (entry->key == NULL || !heapIsMarked(entry->key) ||
+                    !IS_OBJ(entry->value) || heapIsMarked(AS_OBJ(entry->value))) {
+                    continue;
+                }
+
+                grayValue(vm, entry->value);
+                marked = true;
+            }
+        }
+
+        if (marked) {
+            markObjects(vm);
+        }
+    } while (marked);
+
+    for (WeakRef *ref = vm->weakRefs; ref != NULL; ref = ref->next) {
+        if (ref->target != NULL && !heapIsMarked(ref->target)) {
+            ref->target = NULL;
+        }
+    }
+
+    // The entries of dicts that are unreachable go when they are freed.
+    for (WeakDict *dict = vm->weakDicts; dict != NULL; dict = dict->next) {
+        if (!heapIsMarked(dict->owner)) {
+            continue;
+        }
+
+        int removed = 0;
+
+        for (int i = 0; i <= dict->capacityMask; i++) {
+            WeakEntry *entry = &dict->entries[i];
+
+            if (entry->key != NULL && !heapIsMarked(entry->key)) {
+                entry->key = NULL;
+                entry->value = NIL_VAL;
+                removed++;
+            }
+        }
+
+        if (removed > 0) {
+            dict->count -= removed;
+            rehashEntries(dict);
+        }
+    }
+}
+
+void forwardWeakReferences(DictuVM *vm) {
+    for (WeakRef *ref = vm->weakRefs; ref != NULL; ref = ref->next) {
+        ref->owner = heapForward(ref->owner);
+
+        if (ref->target != NULL) {
+            ref->target = heapForward(ref->target);
+        }
+    }
+
+    // Keys are hashed by address, the ones that moved are in the wrong
+    // slots now.
+    for (WeakDict *dict = vm->weakDicts; dict != NULL; dict = dict->next) {
+        dict->owner = heapForward(dict->owner);
+
+        if (dict->count == 0) {
+            continue;
+        }
+
+        for (int i = 0; i <= dict->capacityMask; i++) {
+            WeakEntry *entry = &dict->entries[i];
+
+            if (entry->key == NULL) {
+                continue;
+            }
+
+            entry->key = heapForward(entry->key);
+
+            if (IS_OBJ(entry->value)) {
+                entry->value = OBJ_VAL(heapForward(AS_OBJ(entry->value)));
+            }
+        }
+
+        rehashEntries(dict);
+    }
+}
+
+Value createWeakModule(DictuVM *vm) {
+    ObjString *name = copyString(vm, "Weak", 4);
+    push(vm, OBJ_VAL(name));
+    ObjModule *module = newModule(vm, name);
+    push(vm, OBJ_VAL(module));
+
+    /**
+     * Define Weak methods
+     */
+    defineTypedNative(vm, &module->values, "ref", refNative, ".");
+    defineTypedNative(vm, &module->values, "keyDict", keyDictNative, "");
+
+    pop(vm);
+    pop(vm);
+
+    return OBJ_VAL(module);
+}
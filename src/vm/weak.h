@@ -0,0 +1,28 @@
+#ifndef oolong_weak_h
+#define oolong_weak_h
+
+#include "optionals.h"
+#include "vm.h"
+
+/*
+ * Weak references for caches. Weak.ref(object) holds an object without
+ * keeping it alive, Weak.keyDict() maps objects to values and keeps
+ * each value alive only for as long as its key is reachable some other
+ * way, an ephemeron. Keys are compared by identity.
+ *
+ * Neither is traced by marking. The VM keeps every one of them on a
+ * list, and once marking is done processWeakReferences marks what the
+ * live keys map to and clears the references to anything left white,
+ * as tableRemoveWhite does for the interned strings.
+ */
+
+Value createWeakModule(DictuVM *vm);
+
+// Marks the values of the weak-key dicts whose keys are reachable, then
+// clears the references to objects marking did not reach.
+void processWeakReferences(DictuVM *vm);
+
+// Rewrites the weak references to objects a compaction moved.
+void forwardWeakReferences(DictuVM *vm);
+
+#endif